@@ -1,17 +1,25 @@
 #pragma once
+#include <atomic>
 #include <functional>
 #include <optional>
 #include <algorithm>
 #include <memory>
+#include <new>
 #include "functional_type.h"
 
 #include "semver.h"
 #include "il2cpp_types.h"
+#include "il2cpp_context.h"
 #include "binding_template_helpers.h"
+#include "il2cpp_hook_options.h"
+#include "il2cpp_pure_cache.h"
+#include "il2cpp_hook_pool.h"
+#include "il2cpp_telemetry.h"
+#include "il2cpp_zones.h"
 
 #include <cstddef>
 
-const static semver BindingVersion = { 2, 1, 0 };
+const static semver BindingVersion = { 3, 1, 0 };
 class il2cpp_context;
 using u8 = unsigned char;
 
@@ -25,9 +33,11 @@ struct MethodInvocationStorage {
 	}
 
 	~MethodInvocationStorage() {
-		free(mReturnData);
-		free(mArgs);
-		free(mArgOffset);
+		if (mOwnsBuffers) {
+			free(mReturnData);
+			free(mArgs);
+			free(mArgOffset);
+		}
 	}
 
 	template<typename Ret, typename... Args>
@@ -56,6 +66,27 @@ struct MethodInvocationStorage {
 		setArgs(std::index_sequence_for<Args...>{}, std::move(args));
 	}
 
+	//Same as initialize, but uses caller provided buffers (see InlineInvocationStorage) instead of the heap
+	template<typename Ret, typename... Args>
+	void initializeInPlace(u8 *argBuffer, uint32_t *offsetBuffer, u8 *returnBuffer, std::tuple<Args*...> &&args) {
+		mOwnsBuffers = false;
+		if constexpr (!std::is_same_v<Ret, void>) {
+			mReturnData = returnBuffer;
+		}
+
+		if constexpr (sizeof...(Args) > 0) {
+			mArgs = argBuffer;
+			mNumArgs = sizeof...(Args);
+
+			uint32_t offset = 0;
+			uint32_t idx = 0;
+			((offsetBuffer[idx++] = offset, offset += sizeof(Args)), ...);
+			mArgOffset = offsetBuffer;
+		}
+
+		setArgs(std::index_sequence_for<Args...>{}, std::move(args));
+	}
+
 	template<typename T>
 	struct ReturnSpecialize {
 		static const T& getReturn(const MethodInvocationStorage& st) {
@@ -94,11 +125,96 @@ struct MethodInvocationStorage {
 	uint8_t* mArgs = nullptr;
 	uint32_t *mArgOffset = nullptr;
 	uint32_t mNumArgs = 0;
+	bool mOwnsBuffers = true;
 };
 ENFORCE_TYPE_OFFSET(MethodInvocationStorage, mReturnData, 0);
 ENFORCE_TYPE_OFFSET(MethodInvocationStorage, mArgs, 8);
 ENFORCE_TYPE_OFFSET(MethodInvocationStorage, mArgOffset, 16);
 ENFORCE_TYPE_OFFSET(MethodInvocationStorage, mNumArgs, 24);
+ENFORCE_TYPE_OFFSET(MethodInvocationStorage, mOwnsBuffers, 28);
+
+//Argument/return storage that lives on the stack of the invoker, for paths that must not touch the heap
+template<typename Ret, typename... Args>
+struct InlineInvocationStorage {
+	static constexpr size_t ArgSize = (size_t(0) + ... + sizeof(Args));
+	static constexpr size_t ReturnSize = std::is_same_v<Ret, void> ? 1 : sizeof(std::conditional_t<std::is_same_v<Ret, void>, u8, Ret>);
+
+	explicit InlineInvocationStorage(Args&... args) {
+		storage.initializeInPlace<Ret, Args...>(argBuffer, offsetBuffer, returnBuffer, std::tuple<Args*...>(&args...));
+	}
+
+	alignas(16) u8 argBuffer[ArgSize > 0 ? ArgSize : 1];
+	alignas(16) u8 returnBuffer[ReturnSize] = {};
+	uint32_t offsetBuffer[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+	MethodInvocationStorage storage;
+};
+
+//Whether a node runs for a call, as decided before the call's storage is built
+enum class NodeVerdict : uint8_t {
+	Skip = 0,
+	Run = 1,
+
+	//Observer nodes only need the raw arguments and the result, so a call where nothing else runs still takes the
+	//invoker's direct route. Added in binding 3.1, only returned by nodes that set MethodHookNode::observe
+	Observe = 2,
+};
+
+//Verdicts from the invoker's pre-dispatch walk over the chain, handed to the nodes through MethodInvocationContext so
+//a sampled node's gate is only consumed once per call. Nodes without a verdict decide for themselves
+struct NodeVerdicts {
+	static const uint32_t MaxNodes = 16;
+
+	uint32_t count = 0;
+	const void *nodeData[MaxNodes];
+	NodeVerdict verdict[MaxNodes];
+
+	bool add(const void *data, NodeVerdict v) {
+		if (count == MaxNodes) {
+			return false;
+		}
+
+		nodeData[count] = data;
+		verdict[count] = v;
+		++count;
+		return true;
+	}
+
+	const NodeVerdict *find(const void *data) const {
+		for (uint32_t i = 0; i < count; ++i) {
+			if (nodeData[i] == data) {
+				return &verdict[i];
+			}
+		}
+		return nullptr;
+	}
+
+	bool has(NodeVerdict v) const {
+		for (uint32_t i = 0; i < count; ++i) {
+			if (verdict[i] == v) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//Set once any hook in this mod is bound with a precheck, so mods without one never walk their chains
+	static bool anyBound() {
+		return boundFlag().load(std::memory_order_relaxed);
+	}
+
+	static void markBound() {
+		boundFlag().store(true, std::memory_order_relaxed);
+	}
+
+private:
+	static std::atomic<bool> &boundFlag() {
+		static std::atomic<bool> bound{ false };
+		return bound;
+	}
+};
+ENFORCE_TYPE_OFFSET(NodeVerdicts, count, 0);
+ENFORCE_TYPE_OFFSET(NodeVerdicts, nodeData, 8);
+ENFORCE_TYPE_OFFSET(NodeVerdicts, verdict, 136);
 
 class MethodInvocationContext {
 public:
@@ -106,6 +222,17 @@ public:
 		: mCtx(&ctx), mStorage(std::move(storage)) {
 	}
 
+	//Borrows storage owned by the caller, e.g. an InlineInvocationStorage on the invoker's stack
+	MethodInvocationContext(const il2cpp_context &ctx, MethodInvocationStorage &storage)
+		: mCtx(&ctx), mStorage(&storage), mBorrowedStorage(true) {
+	}
+
+	~MethodInvocationContext() {
+		if (mBorrowedStorage) {
+			mStorage.release();
+		}
+	}
+
 	const il2cpp_context &getGlobalContext() const {
 		return *mCtx;
 	}
@@ -130,6 +257,10 @@ public:
 		return mStorage->setArg(idx, std::move(value));
 	}
 
+	const MethodInvocationStorage &getStorage() const {
+		return *mStorage;
+	}
+
 	void stopExecution() const {
 		mStopExecution = true;
 	}
@@ -138,15 +269,28 @@ public:
 		return mStopExecution;
 	}
 
+	void setVerdicts(const NodeVerdicts *verdicts) {
+		mVerdicts = verdicts;
+	}
+
+	//The invoker's verdict for a node, nullptr if the node has to decide for itself
+	const NodeVerdict *findVerdict(const void *nodeData) const {
+		return mVerdicts ? mVerdicts->find(nodeData) : nullptr;
+	}
+
 private:
 	const il2cpp_context *mCtx;
 	std::unique_ptr<MethodInvocationStorage> mStorage;
 	mutable bool mStopExecution = false;
+	bool mBorrowedStorage = false;
+	const NodeVerdicts *mVerdicts = nullptr;
 
 	void _enforceSize() {
 		ENFORCE_TYPE_OFFSET(MethodInvocationContext, mCtx, 0);
 		ENFORCE_TYPE_OFFSET(MethodInvocationContext, mStorage, 8);
 		ENFORCE_TYPE_OFFSET(MethodInvocationContext, mStopExecution, 16);
+		ENFORCE_TYPE_OFFSET(MethodInvocationContext, mBorrowedStorage, 17);
+		ENFORCE_TYPE_OFFSET(MethodInvocationContext, mVerdicts, 24);
 	}
 };
 
@@ -155,35 +299,158 @@ struct MethodHookNode {
 	InvokeTime invokeTime = InvokeTime::Before;
 	int priority = 0;
 	void *data;
+
+	//Decides from the raw native arguments whether the node runs for a call (its HookFilter and HookSampling gate).
+	//Called by the invoker before any storage is built; `args` points at each argument. nullptr if the node runs for every call
+	NodeVerdict(*precheck)(const MethodHookNode *node, const void *ths, const void *const *args) = nullptr;
+
+	//Set on observer nodes (binding 3.1+). Called after the original with the same raw arguments and a pointer to the
+	//result (nullptr for void methods), for calls where the node's precheck returned NodeVerdict::Observe and nothing
+	//else ran. Only read after such a verdict, so nodes from older bindings never have it touched
+	void(*observe)(const MethodHookNode *node, const void *ths, const void *const *args, const void *ret) = nullptr;
+
+	//Zone name for dispatches routed through this node's call, interned when the node is bound. Only read by the
+	//invokers of the binding that allocated the node, so the loader and other mods never see it
+	const char *zoneName = nullptr;
 };
 ENFORCE_TYPE_OFFSET(MethodHookNode, next, 0);
 ENFORCE_TYPE_OFFSET(MethodHookNode, invokeTime, 8);
 ENFORCE_TYPE_OFFSET(MethodHookNode, priority, 12);
 ENFORCE_TYPE_OFFSET(MethodHookNode, data, 16);
+ENFORCE_TYPE_OFFSET(MethodHookNode, precheck, 24);
+ENFORCE_TYPE_OFFSET(MethodHookNode, observe, 32);
+ENFORCE_TYPE_OFFSET(MethodHookNode, zoneName, 40);
 
 template<bool isThisCall, typename FnRet, typename... Args>
 struct MethodHook {
 	using Fn = ThisCallSpecializeTypes<isThisCall>::Fn<FnRet, Args...>;
 	using Ret = typename ReturnTypeSpecialization<FnRet>::type;
 
+	//`this` (nullptr for static methods), a pointer to the result (nullptr for void methods) and the arguments
+	using Observer = std::function<void(void *ths, const void *ret, Args...)>;
+
 	struct Node {
 		Fn fn;
+		HookGate gate;
+		HookFilter filter;
+		TelemetryHook telemetry;
+
+		//Set instead of fn on observer nodes
+		Observer observer;
 	};
 	ENFORCE_TYPE_OFFSET(Node, fn, 0);
 
-	static MethodHookNode *getNewNode(Fn &&fn, InvokeTime invokeTime, int priority = 0) {
-		Node *nodeData = new Node();
+	//The chain node and its data share one pool slot. Node holds std::functions, so it lives in raw storage to keep
+	//PooledNode standard layout: that's what lets offsetof find the PooledNode again from the Node
+	struct PooledNode {
+		MethodHookNode hookNode;
+		alignas(Node) uint8_t data[sizeof(Node)];
+
+		PooledNode() {
+			new (data) Node();
+		}
+
+		~PooledNode() {
+			node()->~Node();
+		}
+
+		Node *node() {
+			return std::launder(reinterpret_cast<Node *>(data));
+		}
+
+		static PooledNode *of(Node *node) {
+			return reinterpret_cast<PooledNode *>(reinterpret_cast<uint8_t *>(node) - offsetof(PooledNode, data));
+		}
+	};
+	static_assert(std::is_standard_layout_v<PooledNode>, "PooledNode must be standard layout for offsetof");
+	ENFORCE_TYPE_OFFSET(PooledNode, hookNode, 0);
+
+	static MethodHookNode *getNewNode(Fn &&fn, InvokeTime invokeTime, int priority = 0, const HookOptions &options = {}) {
+		HookHandle handle;
+		PooledNode *pooled = HookNodePool::global().allocate<PooledNode>(handle);
+
+		Node *nodeData = pooled->node();
 		nodeData->fn = std::move(fn);
+		nodeData->gate.configure(options.sampling);
 
-		MethodHookNode *node = new MethodHookNode();
+		MethodHookNode *node = &pooled->hookNode;
+		node->next = nullptr;
 		node->priority = priority;
 		node->invokeTime = invokeTime;
 		node->data = nodeData;
 
+		if (options.filter.isActive()) {
+			nodeData->filter = options.filter;
+		}
+
+		if (options.filter.isActive() || options.sampling.isActive()) {
+			node->precheck = &precheck;
+			NodeVerdicts::markBound();
+		}
+
+		return node;
+	}
+
+	//Observer nodes always run After, and always have a precheck so the invoker's walk can hand them NodeVerdict::Observe
+	static MethodHookNode *getNewObserverNode(Observer &&observer, int priority, const HookOptions &options) {
+		MethodHookNode *node = getNewNode(Fn(), InvokeTime::After, priority, options);
+		static_cast<Node *>(node->data)->observer = std::move(observer);
+		node->precheck = &precheckObserver;
+		node->observe = &observeNode;
+		NodeVerdicts::markBound();
 		return node;
 	}
 
+	static NodeVerdict precheckObserver(const MethodHookNode *hookNode, const void *ths, const void *const *args) {
+		return precheck(hookNode, ths, args) == NodeVerdict::Run ? NodeVerdict::Observe : NodeVerdict::Skip;
+	}
+
+	static void observeNode(const MethodHookNode *hookNode, const void *ths, const void *const *args, const void *ret) {
+		Node *node = static_cast<Node *>(hookNode->data);
+		TelemetryScope telemetry(node->telemetry);
+		_observe(node, ths, args, ret, std::index_sequence_for<Args...>{});
+	}
+
+	static NodeVerdict precheck(const MethodHookNode *hookNode, const void *ths, const void *const *args) {
+		Node *node = static_cast<Node *>(hookNode->data);
+		if (node->filter.isActive() && !node->filter.matches(ths, args)) {
+			return NodeVerdict::Skip;
+		}
+
+		//Sampled/rate limited hooks are rejected before any argument is read out of the storage
+		return node->gate.allow() ? NodeVerdict::Run : NodeVerdict::Skip;
+	}
+
 private:
+	//For nodes the invoker's walk didn't reach, e.g. past another node that runs for every call
+	template<size_t... I>
+	static bool _precheckFromStorage(const MethodInvocationContext &ctx, const std::optional<ThisPtr> &ths, MethodHookNode *hookNode, std::index_sequence<I...>) {
+		const MethodInvocationStorage &storage = ctx.getStorage();
+		const void *args[] = { &storage.getArg<Args>(I)..., nullptr };
+		return hookNode->precheck(hookNode, ths ? ths->ptr : nullptr, args) != NodeVerdict::Skip;
+	}
+
+	template<size_t... I>
+	static void _observe(Node *node, const void *ths, const void *const *args, const void *ret, std::index_sequence<I...>) {
+		node->observer(const_cast<void *>(ths), ret, *static_cast<const std::remove_reference_t<Args> *>(args[I])...);
+	}
+
+	//An observer reached by a chain that runs anyway reads the arguments and the result back out of the storage
+	template<size_t... I>
+	static void _observeFromStorage(const MethodInvocationContext &ctx, const std::optional<ThisPtr> &ths, Node *node, std::index_sequence<I...>) {
+		const MethodInvocationStorage &storage = ctx.getStorage();
+		const void *args[] = { &storage.getArg<Args>(I)..., nullptr };
+		const void *thsPtr = ths ? ths->ptr : nullptr;
+
+		if constexpr (std::is_same_v<Ret, void>) {
+			_observe(node, thsPtr, args, nullptr, std::index_sequence<I...>{});
+		}
+		else {
+			Ret ret = ctx.getReturn<Ret>();
+			_observe(node, thsPtr, args, &ret, std::index_sequence<I...>{});
+		}
+	}
+
 	template<size_t... I>
 	static void _invokeNodeFunction(MethodInvocationContext &ctx, std::optional<ThisPtr> ths, Node *node, std::index_sequence<I...>) {
 		if constexpr (isThisCall) {
@@ -238,12 +505,59 @@ private:
 public:
 	static void invokeNodeFunction(MethodInvocationContext &ctx, std::optional<ThisPtr> ths, void *nodeData) {
 		Node *node = static_cast<Node *>(nodeData);
+
+		if (const NodeVerdict *verdict = ctx.findVerdict(nodeData)) {
+			if (*verdict == NodeVerdict::Skip) {
+				return;
+			}
+		}
+		else {
+			PooledNode *pooled = PooledNode::of(node);
+			if (pooled->hookNode.precheck != nullptr && !_precheckFromStorage(ctx, ths, &pooled->hookNode, std::index_sequence_for<Args...>{})) {
+				return;
+			}
+		}
+
+		TelemetryScope telemetry(node->telemetry);
+		if (node->observer) {
+			_observeFromStorage(ctx, ths, node, std::index_sequence_for<Args...>{});
+			return;
+		}
 		_invokeNodeFunction(ctx, ths, node, std::index_sequence_for<Args...>{});
 	}
 
+	//Same as invokeNodeFunction with everything passed by pointer, so generated code can call it with plain register arguments
+	static void invokeNodeFunctionIndirect(MethodInvocationContext &ctx, const std::optional<ThisPtr> &ths, void *nodeData) {
+		invokeNodeFunction(ctx, ths, nodeData);
+	}
+
 	static void invokeOriginalFunction(MethodInvocationContext &ctx, void *ths, void *originalFn) {
 		_invokeOriginalFunction(ctx, ths, originalFn, std::index_sequence_for<Args...>{});
 	}
+
+	//Used in place of invokeOriginalFunction for static methods bound with HookOptions::pure. Only calls that reach
+	//the loader's invokeOriginalFunction are memoized: calls no hook runs for (FunctionChainInvoker::callPrechecked, and
+	//SingleHookInvoker's Skip and Observe routes) call the original directly and neither read nor fill the cache
+	static void invokeOriginalFunctionMemoized(MethodInvocationContext &ctx, void *ths, void *originalFn) {
+		if constexpr (!isThisCall && PureCallCache::canCache<Ret, Args...>()) {
+			const MethodInvocationStorage &storage = ctx.getStorage();
+			PureCallCache::Key key(originalFn, storage.mArgs, (uint32_t)(0 + ... + sizeof(Args)));
+
+			Ret value;
+			if (PureCallCache::global().lookup(key, &value, sizeof(Ret))) {
+				ctx.setReturn(std::move(value));
+				return;
+			}
+
+			_invokeOriginalFunction(ctx, ths, originalFn, std::index_sequence_for<Args...>{});
+
+			value = ctx.getReturn<Ret>();
+			PureCallCache::global().store(key, &value, sizeof(Ret));
+		}
+		else {
+			_invokeOriginalFunction(ctx, ths, originalFn, std::index_sequence_for<Args...>{});
+		}
+	}
 };
 
 struct FunctionChainInvoker {
@@ -252,45 +566,172 @@ struct FunctionChainInvoker {
 		return ctx;
 	}
 
+	//The caller holds a HookReclaimer::DispatchGuard for the whole call, the prechecks already walked the chain
 	template<bool isThisCall, typename Ret, typename... Args>
-	static __declspec(noinline) Ret invoke(std::optional<void *> ths, std::tuple<Args*...> &&argBuffer) {
+	static __declspec(noinline) Ret invoke(std::optional<void *> ths, std::tuple<Args*...> &&argBuffer, const NodeVerdicts &verdicts) {
+		ZoneScope zone([]() { return activeZoneName(); });
+
 		auto methodStorage = std::make_unique<MethodInvocationStorage>();
 		methodStorage->initialize<Ret, Args...>(std::move(argBuffer));
 
 		MethodInvocationContext methodCtx(*getContext(), std::move(methodStorage));
+		methodCtx.setVerdicts(&verdicts);
 
-		getContext()->getBinding().InvokeFunctionChain(methodCtx, ths);
+		dispatchChain(methodCtx, ths);
 
 		return methodCtx.getReturn<Ret>();
 	}
+
+	//0 when the loader can't report the active call
+	static uint64_t activeHookId();
+
+	//The routed call's node is this binding's own, since its invokeFn is what's running
+	static const char *activeZoneName();
+
+	//Runs the active method's compiled chain if HookChainJit built one, otherwise the loader's chain
+	static void dispatchChain(MethodInvocationContext &methodCtx, std::optional<void *> ths);
+
+	//Walks the active method's chain in dispatch order, recording each node's precheck verdict, and stops at the first
+	//node that runs. Returns the method's original if no node runs for this call, nullptr if the chain has to run
+	static void *precheckChain(const void *ths, const void *const *args, NodeVerdicts &verdicts);
+
+	template<bool isThisCall, typename Ret, typename... Args>
+	static Ret callOriginal(void *originalFn, void *ths, Args&... args) {
+		if constexpr (isThisCall) {
+			return reinterpret_cast<Ret(__thiscall *)(void *, Args...)>(originalFn)(ths, args...);
+		}
+		else {
+			return reinterpret_cast<Ret(*)(Args...)>(originalFn)(args...);
+		}
+	}
+
+	//Calls the original, then hands a pointer to its result (nullptr for void) to `observe`
+	template<bool isThisCall, typename Ret, typename Observe, typename... Args>
+	static Ret callObserved(void *originalFn, void *ths, Observe &&observe, Args&... args) {
+		if constexpr (std::is_same_v<Ret, void>) {
+			callOriginal<isThisCall, Ret, Args...>(originalFn, ths, args...);
+			observe(nullptr);
+		}
+		else {
+			Ret ret = callOriginal<isThisCall, Ret, Args...>(originalFn, ths, args...);
+			observe(&ret);
+			return ret;
+		}
+	}
+
+	//Calls observe on every node of the active chain whose verdict was NodeVerdict::Observe
+	static void observeChain(const void *ths, const void *const *args, const void *ret, const NodeVerdicts &verdicts);
+
+	//The direct route for a call no node runs for: the original, then any observers. Bypasses PureCallCache
+	template<bool isThisCall, typename Ret, typename... Args>
+	static Ret callPrechecked(void *originalFn, void *ths, const void *const *argPtrs, const NodeVerdicts &verdicts, Args&... args) {
+		if (!verdicts.has(NodeVerdict::Observe)) {
+			return callOriginal<isThisCall, Ret, Args...>(originalFn, ths, args...);
+		}
+		return callObserved<isThisCall, Ret>(originalFn, ths, [ths, argPtrs, &verdicts](const void *ret) {
+			observeChain(ths, argPtrs, ret, verdicts);
+		}, args...);
+	}
 };
 
 template<bool isThisCall, typename Ret, typename... Args>
 __declspec(noinline) Ret __thiscall invokeMemberFunction(void *ths, Args... args) {
+	HookReclaimer::DispatchGuard dispatchGuard;
+
+	NodeVerdicts verdicts;
+	if (NodeVerdicts::anyBound()) {
+		const void *argPtrs[] = { &args..., nullptr };
+		if (void *originalFn = FunctionChainInvoker::precheckChain(ths, argPtrs, verdicts)) {
+			return FunctionChainInvoker::callPrechecked<isThisCall, Ret, Args...>(originalFn, ths, argPtrs, verdicts, args...);
+		}
+	}
+
 	auto argTuple = std::tuple<Args*...>(&args...);
-	return FunctionChainInvoker::invoke<isThisCall, Ret, Args...>(ths, std::move(argTuple));
+	return FunctionChainInvoker::invoke<isThisCall, Ret, Args...>(ths, std::move(argTuple), verdicts);
 }
 
 template<bool isThisCall, typename Ret, typename... Args>
 static __declspec(noinline) Ret invokeStaticFunction(Args... args) {
+	HookReclaimer::DispatchGuard dispatchGuard;
+
+	NodeVerdicts verdicts;
+	if (NodeVerdicts::anyBound()) {
+		const void *argPtrs[] = { &args..., nullptr };
+		if (void *originalFn = FunctionChainInvoker::precheckChain(nullptr, argPtrs, verdicts)) {
+			return FunctionChainInvoker::callPrechecked<isThisCall, Ret, Args...>(originalFn, nullptr, argPtrs, verdicts, args...);
+		}
+	}
+
 	auto argTuple = std::tuple<Args*...>(&args...);
-	return FunctionChainInvoker::invoke<isThisCall, Ret, Args...>(std::nullopt, std::move(argTuple));
+	return FunctionChainInvoker::invoke<isThisCall, Ret, Args...>(std::nullopt, std::move(argTuple), verdicts);
 }
 
+template<bool isThisCall, typename Ret, typename... Args>
+Ret __thiscall invokeSingleMemberFunction(void *ths, Args... args);
+
+template<bool isThisCall, typename Ret, typename... Args>
+Ret invokeSingleStaticFunction(Args... args);
+
 class il2cpp_binding {
+	friend class ModInitScheduler;
+
 public:
+	//One hooked method, as registered with the loader.
+	//When a method's chain holds exactly one node, the loader may route calls to that node's own HookCall::invokeSingleFn
+	//instead of invokeFn, with GetActiveHookCall returning that HookCall for the duration of the call. It runs the node
+	//and the original directly, skipping InvokeFunctionChain and any heap allocation. When a chain is empty (or every
+	//node has been unbound) the loader should route calls straight to originalFn.
 	struct HookCall {
+		//Set by the loader in AddHookCall
 		void *originalFn = nullptr;
 		void *invokeFn = nullptr;
 		MethodHookNode *node = nullptr;
 		il2cppapi::Class *klass = nullptr;
 
-		uint64_t id;
+		//Assigned by the loader in AddHookCall
+		uint64_t id = 0;
 		void *uniqueFn = nullptr;
 
 		void(*invokeNodeFunction)(MethodInvocationContext &ctx, std::optional<ThisPtr> ths, void *node) = nullptr;
 		void(*invokeOriginalFunction)(MethodInvocationContext &ctx, void *ths, void *originalFn) = nullptr;
 		semver hookVersion = BindingVersion;
+
+		void *invokeSingleFn = nullptr;
+
+		//Native stub built by HookChainJit for the current chain, or nullptr to use InvokeFunctionChain.
+		//Published and read atomically, since the loader may rebuild it while other threads dispatch
+		void *compiledChain = nullptr;
+		void(*invokeNodeFunctionIndirect)(MethodInvocationContext &ctx, const std::optional<ThisPtr> &ths, void *node) = nullptr;
+
+		//First node of the method's chain in dispatch order, read atomically like compiledChain. The invokers walk
+		//it to evaluate prechecks (filters, sampling) and observers before any storage is built. The loader's side:
+		//- Dispatch order is descending priority, the same order InvokeFunctionChain runs. Every node's `next` is
+		//  linked (nullptr after the last) before the head is published with a release store.
+		//- It is republished on every HookCall the loader may route through, i.e. whatever GetActiveHookCall returns,
+		//  on every AddHookCall and RemoveHookCall, before the call returns.
+		//- A removed node may still be walked by a dispatch that loaded the old head. Nodes are retired by their
+		//  mod through HookReclaimer after RemoveHookCall returns, so the loader only has to unlink, never free.
+		//- nullptr if the loader doesn't track it, or while any node in the chain comes from a binding before 3.0,
+		//  whose nodes have no precheck (2.7 nodes hold a HookFilter * in its slot). Every call then runs the chain
+		//  and nodes evaluate their own prechecks.
+		//The loader copies the whole HookCall, so it has to be built against a header (3.0+) that has this field
+		MethodHookNode *chainHead = nullptr;
+
+		using CompiledChainFn = void(*)(MethodInvocationContext *ctx, const std::optional<ThisPtr> *ths, void *rawThs);
+
+		CompiledChainFn loadCompiledChain() const {
+			static_assert(sizeof(std::atomic<void *>) == sizeof(void *), "compiledChain is accessed as an atomic");
+			return reinterpret_cast<CompiledChainFn>(reinterpret_cast<const std::atomic<void *> *>(&compiledChain)->load(std::memory_order_acquire));
+		}
+
+		void *exchangeCompiledChain(void *chain) {
+			return reinterpret_cast<std::atomic<void *> *>(&compiledChain)->exchange(chain, std::memory_order_acq_rel);
+		}
+
+		const MethodHookNode *loadChainHead() const {
+			static_assert(sizeof(std::atomic<MethodHookNode *>) == sizeof(MethodHookNode *), "chainHead is accessed as an atomic");
+			return reinterpret_cast<const std::atomic<MethodHookNode *> *>(&chainHead)->load(std::memory_order_acquire);
+		}
 	};
 	ENFORCE_TYPE_OFFSET(HookCall, originalFn, 0);
 	ENFORCE_TYPE_OFFSET(HookCall, invokeFn, 8);
@@ -301,23 +742,38 @@ public:
 	ENFORCE_TYPE_OFFSET(HookCall, invokeNodeFunction, 48);
 	ENFORCE_TYPE_OFFSET(HookCall, invokeOriginalFunction, 56);
 	ENFORCE_TYPE_OFFSET(HookCall, hookVersion, 64);
+	ENFORCE_TYPE_OFFSET(HookCall, invokeSingleFn, 80);
+	ENFORCE_TYPE_OFFSET(HookCall, compiledChain, 88);
+	ENFORCE_TYPE_OFFSET(HookCall, invokeNodeFunctionIndirect, 96);
+	ENFORCE_TYPE_OFFSET(HookCall, chainHead, 104);
+	static_assert(std::is_trivially_copyable_v<HookCall>, "AddHookCall writes back into the HookCall it is handed, see AddHookCall");
 
 	//Explicit 
 	template<typename Ret, typename... Args>
-	void bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, std::function<Ret(const MethodInvocationContext& ctx, ThisPtr ths, Args...)> &&callback) {
+	HookHandle bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, const HookOptions &options, std::function<Ret(const MethodInvocationContext& ctx, ThisPtr ths, Args...)> &&callback) {
 		static_assert(is_valid_return_type<Ret>::value, "Invalid function signature! Your function must either return `void`, or `std::optional<T>`");
-		_bindClassFunction(namespaceName, className, methodName, invokeTime, priority, std::move(callback));
+		return _bindClassFunction(namespaceName, className, methodName, invokeTime, priority, options, std::move(callback));
 	}
 
 	template<typename Ret, typename... Args>
-	void bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, std::function<Ret(const MethodInvocationContext& ctx, Args...)> &&callback) {
+	HookHandle bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, const HookOptions &options, std::function<Ret(const MethodInvocationContext& ctx, Args...)> &&callback) {
 		static_assert(is_valid_return_type<Ret>::value, "Invalid function signature! Your function must either return `void`, or `std::optional<T>`");
-		_bindStaticFunction(namespaceName, className, methodName, invokeTime, priority, std::move(callback));
+		return _bindStaticFunction(namespaceName, className, methodName, invokeTime, priority, options, std::move(callback));
+	}
+
+	template<typename Ret, typename... Args>
+	HookHandle bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, std::function<Ret(const MethodInvocationContext& ctx, ThisPtr ths, Args...)> &&callback) {
+		return bindClassFunction(namespaceName, className, methodName, invokeTime, priority, HookOptions{}, std::move(callback));
+	}
+
+	template<typename Ret, typename... Args>
+	HookHandle bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, std::function<Ret(const MethodInvocationContext& ctx, Args...)> &&callback) {
+		return bindStaticFunction(namespaceName, className, methodName, invokeTime, priority, HookOptions{}, std::move(callback));
 	}
 
 	//Passthrough + function signature check
 	template<typename Fn>
-	void bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, Fn &&callback) {
+	HookHandle bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, const HookOptions &options, Fn &&callback) {
 		functional_type_t<Fn> fn = [callback = std::move(callback)](auto&&... args)
 		{
 			return callback(std::forward<decltype(args)>(args)...);
@@ -328,11 +784,11 @@ public:
 		static_assert(TypeCheck::hasThisPtr, "Invalid function signature! Make sure your function's second parameter is `ThisPtr ths`");
 		static_assert(TypeCheck::hasValidReturn, "Invalid function signature! Your function must either return `void`, or `std::optional<T>`");
 
-		_bindClassFunction(namespaceName, className, methodName, invokeTime, priority, std::move(fn));
+		return _bindClassFunction(namespaceName, className, methodName, invokeTime, priority, options, std::move(fn));
 	}
 
 	template<typename Fn>
-	void bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, Fn &&callback) {
+	HookHandle bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, const HookOptions &options, Fn &&callback) {
 		functional_type_t<Fn> fn = [callback = std::move(callback)](auto&&... args)
 		{
 			return callback(std::forward<decltype(args)>(args)...);
@@ -342,18 +798,75 @@ public:
 		static_assert(TypeCheck::hasContext, "Invalid function signature! Make sure your function starts with `const MethodInvocationContext& ctx`");
 		static_assert(TypeCheck::hasValidReturn, "Invalid function signature! Your function must either return `void`, or `std::optional<T>`");
 
-		_bindStaticFunction(namespaceName, className, methodName, invokeTime, priority, std::move(fn));
+		return _bindStaticFunction(namespaceName, className, methodName, invokeTime, priority, options, std::move(fn));
+	}
+
+	template<typename Fn>
+	HookHandle bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, Fn &&fn) {
+		return bindClassFunction(namespaceName, className, methodName, invokeTime, priority, HookOptions{}, std::move(fn));
+	}
+
+	template<typename Fn>
+	HookHandle bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, Fn &&fn) {
+		return bindStaticFunction(namespaceName, className, methodName, invokeTime, priority, HookOptions{}, std::move(fn));
 	}
 
 	//Default priority binding, where priority = 0
 	template<typename Fn>
-	void bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, Fn &&fn) {
-		bindClassFunction(namespaceName, className, methodName, invokeTime, 0, std::move(fn));
+	HookHandle bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, Fn &&fn) {
+		return bindClassFunction(namespaceName, className, methodName, invokeTime, 0, std::move(fn));
 	}
 
 	template<typename Fn>
-	void bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, Fn &&fn) {
-		bindStaticFunction(namespaceName, className, methodName, invokeTime, 0, std::move(fn));
+	HookHandle bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, Fn &&fn) {
+		return bindStaticFunction(namespaceName, className, methodName, invokeTime, 0, std::move(fn));
+	}
+
+	//Read-only observer, called after the original with `this`, a pointer to the result (nullptr for void methods) and the
+	//arguments. When nothing else runs for a call, the invoker calls the original directly and hands the observer the raw
+	//values without building the call's storage. options.filter and options.sampling apply, options.pure doesn't
+	template<typename Ret, typename... Args>
+	HookHandle observeClassFunction(const char *namespaceName, const char *className, const char *methodName, int priority, const HookOptions &options, std::function<void(void *ths, const void *ret, Args...)> &&observer) {
+		return _observeFunction<true, Ret, Args...>(namespaceName, className, methodName, priority, options, std::move(observer));
+	}
+
+	template<typename Ret, typename... Args>
+	HookHandle observeStaticFunction(const char *namespaceName, const char *className, const char *methodName, int priority, const HookOptions &options, std::function<void(void *ths, const void *ret, Args...)> &&observer) {
+		return _observeFunction<false, Ret, Args...>(namespaceName, className, methodName, priority, options, std::move(observer));
+	}
+
+	//Removes a hook from its chain. The node's memory is reclaimed once no chain dispatch can still be running it,
+	//so this is safe to call from inside a hook. Returns false if the handle was already unbound
+	bool unbind(HookHandle handle) {
+		PureCallCache::global().untrack(handle);
+		void *slot = HookNodePool::global().retire(handle);
+		if (slot == nullptr) {
+			return false;
+		}
+
+		RemoveHookCall(*this, static_cast<MethodHookNode *>(slot));
+		HookReclaimer::global().retire(handle.index);
+		HookReclaimer::global().collect();
+		return true;
+	}
+
+	//Zero initialized block of process lifetime memory, shared between every mod that asks for the same name
+	void *getSharedData(const char *name, size_t size) {
+		return GetSharedData(*this, name, size);
+	}
+
+	//Joins the process wide dispatch epoch, so anything retired through HookReclaimer waits for every mod's dispatches
+	void attachHookEpoch() {
+		if (HookReclaimer::sharedState() == nullptr) {
+			HookReclaimer::sharedRetired() = static_cast<HookSharedRetireList *>(getSharedData("HookSharedRetireList", sizeof(HookSharedRetireList)));
+			HookReclaimer::sharedState() = static_cast<HookEpochState *>(getSharedData("HookEpochState", sizeof(HookEpochState)));
+		}
+	}
+
+	//The HookCall the current thread is dispatching, valid while inside an invoker. nullptr if the loader left the
+	//entry empty; callers fall back to the loader's chain then
+	const HookCall *getActiveHookCall() const {
+		return GetActiveHookCall != nullptr ? GetActiveHookCall(*this) : nullptr;
 	}
 
 	////////////
@@ -361,7 +874,13 @@ public:
 	void(*InvokeFunctionChain)(MethodInvocationContext &ctx, std::optional<void *> ths);
 protected:
 	const il2cpp_context& (*GetIL2CPPContext)(const il2cpp_binding &bnd);
+	//Copies `call` into the method's chain. Before returning, the loader writes the id it assigned and the method's
+	//originalFn back into the caller's `call`, which stays valid to read them: HookCall is trivially copyable, so the
+	//rvalue reference only hands the call over and nothing is moved out of it
 	void(*AddHookCall)(il2cpp_binding &bnd, const char *namespaceName, const char *className, const char *methodName, size_t numArgs, HookCall &&call);
+	void(*RemoveHookCall)(il2cpp_binding &bnd, MethodHookNode *node);
+	void*(*GetSharedData)(il2cpp_binding &bnd, const char *name, size_t size);
+	const HookCall*(*GetActiveHookCall)(const il2cpp_binding &bnd);
 	////////////
 
 
@@ -370,47 +889,274 @@ private:
 		ENFORCE_TYPE_OFFSET(il2cpp_binding, InvokeFunctionChain, 0);
 		ENFORCE_TYPE_OFFSET(il2cpp_binding, GetIL2CPPContext, 8);
 		ENFORCE_TYPE_OFFSET(il2cpp_binding, AddHookCall, 16);
+		ENFORCE_TYPE_OFFSET(il2cpp_binding, RemoveHookCall, 24);
+		ENFORCE_TYPE_OFFSET(il2cpp_binding, GetSharedData, 32);
+		ENFORCE_TYPE_OFFSET(il2cpp_binding, GetActiveHookCall, 40);
 	}
 
 private:
 	template<typename Ret, typename... Args>
-	void _bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, std::function<Ret(const MethodInvocationContext& ctx, ThisPtr ths, Args...)> &&callback) {
-		MethodHookNode *node = MethodHook<true, Ret, Args...>::getNewNode(std::move(callback), invokeTime, priority);
-		_bindFunction<true, Ret, Args...>(namespaceName, className, methodName, node);
+	HookHandle _bindClassFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, const HookOptions &options, std::function<Ret(const MethodInvocationContext& ctx, ThisPtr ths, Args...)> &&callback) {
+		if (options.filter.isActive() && !options.filter.validate<true, Args...>(className, methodName)) {
+			return HookHandle();
+		}
+
+		MethodHookNode *node = MethodHook<true, Ret, Args...>::getNewNode(std::move(callback), invokeTime, priority, options);
+		return _bindFunction<true, Ret, Args...>(namespaceName, className, methodName, node, options);
 	}
 
 	template<typename Ret, typename... Args>
-	void _bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, std::function<Ret(const MethodInvocationContext& ctx, Args...)> &&callback) {
-		MethodHookNode *node = MethodHook<false, Ret, Args...>::getNewNode(std::move(callback), invokeTime, priority);
-		_bindFunction<false, Ret, Args...>(namespaceName, className, methodName, node);
+	HookHandle _bindStaticFunction(const char *namespaceName, const char *className, const char *methodName, InvokeTime invokeTime, int priority, const HookOptions &options, std::function<Ret(const MethodInvocationContext& ctx, Args...)> &&callback) {
+		if (options.filter.isActive() && !options.filter.validate<false, Args...>(className, methodName)) {
+			return HookHandle();
+		}
+
+		MethodHookNode *node = MethodHook<false, Ret, Args...>::getNewNode(std::move(callback), invokeTime, priority, options);
+		return _bindFunction<false, Ret, Args...>(namespaceName, className, methodName, node, options);
+	}
+
+	template<bool isThisCall, typename Ret, typename... Args>
+	HookHandle _observeFunction(const char *namespaceName, const char *className, const char *methodName, int priority, const HookOptions &options, std::function<void(void *ths, const void *ret, Args...)> &&observer) {
+		if (options.filter.isActive() && !options.filter.validate<isThisCall, Args...>(className, methodName)) {
+			return HookHandle();
+		}
+
+		using FnRet = std::conditional_t<std::is_void_v<Ret>, void, std::optional<Ret>>;
+		HookOptions observeOptions = options;
+		observeOptions.pure = false;
+
+		MethodHookNode *node = MethodHook<isThisCall, FnRet, Args...>::getNewObserverNode(std::move(observer), priority, observeOptions);
+		return _bindFunction<isThisCall, FnRet, Args...>(namespaceName, className, methodName, node, observeOptions);
 	}
 
 	template<bool isThisCall, typename Ret, typename... Args>
-	void _bindFunction(const char *namespaceName, const char *className, const char *methodName, MethodHookNode *node) {
+	HookHandle _bindFunction(const char *namespaceName, const char *className, const char *methodName, MethodHookNode *node, const HookOptions &options) {
 		using MethodHookType = typename MethodHook<isThisCall, Ret, Args...>;
 		FunctionChainInvoker::getContext() = &GetIL2CPPContext(*this);
+		attachHookEpoch();
+
+		HookHandle handle = HookNodePool::global().handleOf(node);
 
 		HookCall call;
 		call.node = node;
 		call.invokeNodeFunction = &MethodHookType::invokeNodeFunction;
 		call.invokeOriginalFunction = &MethodHookType::invokeOriginalFunction;
+		call.invokeNodeFunctionIndirect = &MethodHookType::invokeNodeFunctionIndirect;
+
+		bool pure = false;
+		if (options.pure) {
+			if constexpr (isThisCall) {
+				//Keying on `this` would hand a new object the results of a collected one at the same address
+				printf("WARNING: %s::%s is bound as pure, but only static methods are memoized. It will not be memoized\n", className, methodName);
+			}
+			else if constexpr (PureCallCache::canCache<typename ReturnTypeSpecialization<Ret>::type, Args...>()) {
+				call.invokeOriginalFunction = &MethodHookType::invokeOriginalFunctionMemoized;
+				pure = true;
+			}
+			else {
+				printf("WARNING: %s::%s is bound as pure, but its signature can't be cached (pointer, reference or managed arguments, or an unsupported return type). It will not be memoized\n", className, methodName);
+			}
+		}
+
+		char purityName[256];
+		snprintf(purityName, sizeof(purityName), "PureMethod:%s.%s::%s/%zu", namespaceName, className, methodName, sizeof...(Args));
+		PureMethodState *purity = static_cast<PureMethodState *>(getSharedData(purityName, sizeof(PureMethodState)));
+		if (!PureCallCache::claim(*purity, pure)) {
+			printf("ERROR: %s::%s is already hooked %s HookOptions::pure, every hook on a method must use the same setting!\n", className, methodName, pure ? "without" : "with");
+			HookNodePool::global().retire(handle);
+			HookNodePool::global().release(handle.index);
+			return HookHandle();
+		}
 
 		if constexpr (isThisCall) {
 			auto invokeMemberFn = &invokeMemberFunction<isThisCall, typename ReturnTypeSpecialization<Ret>::type, Args...>;
 			call.invokeFn = *(void **)&invokeMemberFn;
+
+			auto invokeSingleFn = &invokeSingleMemberFunction<isThisCall, typename ReturnTypeSpecialization<Ret>::type, Args...>;
+			call.invokeSingleFn = *(void **)&invokeSingleFn;
 		}
 		else {
 			auto invokeStaticFn = &invokeStaticFunction<isThisCall, typename ReturnTypeSpecialization<Ret>::type, Args...>;
 			call.invokeFn = *(void **)&invokeStaticFn;
+
+			auto invokeSingleFn = &invokeSingleStaticFunction<isThisCall, typename ReturnTypeSpecialization<Ret>::type, Args...>;
+			call.invokeSingleFn = *(void **)&invokeSingleFn;
 		}
 
+		std::string hookName = std::string(className) + "::" + methodName;
+
+		//Resolved here so a dispatch never looks the name up
+		node->zoneName = Zones::intern(hookName.c_str());
+
+		//The loader writes the id and originalFn back into `call`, see AddHookCall
 		AddHookCall(*this, namespaceName, className, methodName, sizeof...(Args), std::move(call));
+		PureCallCache::global().track(handle, purity, pure, call.originalFn);
+
+		if (call.id != 0) {
+			Telemetry::bindHook(static_cast<typename MethodHookType::Node *>(node->data)->telemetry, call.id, hookName.c_str());
+		}
+
+		return handle;
 	}
 };
 
+inline uint64_t FunctionChainInvoker::activeHookId() {
+	const il2cpp_binding::HookCall *call = getContext()->getBinding().getActiveHookCall();
+	return call ? call->id : 0;
+}
+
+inline const char *FunctionChainInvoker::activeZoneName() {
+	const il2cpp_binding::HookCall *call = getContext()->getBinding().getActiveHookCall();
+	return Zones::nameOr(call != nullptr && call->node != nullptr ? call->node->zoneName : nullptr);
+}
+
+inline void FunctionChainInvoker::dispatchChain(MethodInvocationContext &methodCtx, std::optional<void *> ths) {
+	il2cpp_binding &binding = getContext()->getBinding();
+	const il2cpp_binding::HookCall *call = binding.getActiveHookCall();
+
+	auto compiledChain = call ? call->loadCompiledChain() : nullptr;
+	if (compiledChain != nullptr) {
+		std::optional<ThisPtr> thisPtr;
+		if (ths) {
+			thisPtr = ThisPtr(internal::Il2CppObject{ *ths }, call->klass);
+		}
+
+		compiledChain(&methodCtx, &thisPtr, ths.value_or(nullptr));
+		return;
+	}
+
+	binding.InvokeFunctionChain(methodCtx, ths);
+}
+
+inline void FunctionChainInvoker::observeChain(const void *ths, const void *const *args, const void *ret, const NodeVerdicts &verdicts) {
+	const il2cpp_binding::HookCall *call = getContext()->getBinding().getActiveHookCall();
+	if (call == nullptr) {
+		return;
+	}
+
+	//Nodes bound since the prechecks have no verdict and sit this call out
+	for (const MethodHookNode *node = call->loadChainHead(); node != nullptr; node = node->next) {
+		const NodeVerdict *verdict = verdicts.find(node->data);
+		if (verdict != nullptr && *verdict == NodeVerdict::Observe) {
+			node->observe(node, ths, args, ret);
+		}
+	}
+}
+
+inline void *FunctionChainInvoker::precheckChain(const void *ths, const void *const *args, NodeVerdicts &verdicts) {
+	const il2cpp_binding::HookCall *call = getContext()->getBinding().getActiveHookCall();
+	if (call == nullptr) {
+		return nullptr;
+	}
+
+	//Nodes are retired through HookReclaimer, the caller's DispatchGuard keeps them alive during the walk
+	const MethodHookNode *node = call->loadChainHead();
+	if (node == nullptr) {
+		return nullptr;
+	}
+
+	for (; node != nullptr; node = node->next) {
+		//Nodes past this point decide for themselves once the chain runs
+		if (node->precheck == nullptr || verdicts.count == NodeVerdicts::MaxNodes) {
+			return nullptr;
+		}
+
+		NodeVerdict verdict = node->precheck(node, ths, args);
+		verdicts.add(node->data, verdict);
+		if (verdict == NodeVerdict::Run) {
+			return nullptr;
+		}
+	}
+	return call->originalFn;
+}
+
+//Invoker for a method whose chain holds a single node. Calls the node and the original directly with
+//stack storage, instead of building heap storage and walking the loader's chain
+struct SingleHookInvoker {
+	template<bool isThisCall, typename Ret, typename... Args>
+	static __declspec(noinline) Ret invoke(void *ths, Args&... args) {
+		HookReclaimer::DispatchGuard dispatchGuard;
+
+		const il2cpp_context &globalCtx = *FunctionChainInvoker::getContext();
+		const il2cpp_binding::HookCall *call = globalCtx.getBinding().getActiveHookCall();
+
+		//Without the active call there's no node to run directly, the loader's chain still has it
+		if (call == nullptr || call->node == nullptr) {
+			std::optional<void *> thisArg;
+			if constexpr (isThisCall) {
+				thisArg = ths;
+			}
+			return FunctionChainInvoker::invoke<isThisCall, Ret, Args...>(thisArg, std::tuple<Args*...>(&args...), NodeVerdicts());
+		}
+
+		MethodHookNode *node = call->node;
+		NodeVerdicts verdicts;
+		if (node->precheck != nullptr) {
+			const void *argPtrs[] = { &args..., nullptr };
+			NodeVerdict verdict = node->precheck(node, ths, argPtrs);
+
+			//Like callPrechecked, calls the hook doesn't run for go to the original without PureCallCache
+			if (verdict == NodeVerdict::Skip) {
+				return FunctionChainInvoker::callOriginal<isThisCall, Ret, Args...>(call->originalFn, ths, args...);
+			}
+			if (verdict == NodeVerdict::Observe) {
+				return FunctionChainInvoker::callObserved<isThisCall, Ret>(call->originalFn, ths, [node, ths, &argPtrs](const void *ret) {
+					node->observe(node, ths, argPtrs, ret);
+				}, args...);
+			}
+			verdicts.add(node->data, verdict);
+		}
+
+		ZoneScope zone([node]() { return Zones::nameOr(node->zoneName); });
+
+		InlineInvocationStorage<Ret, Args...> storage(args...);
+		MethodInvocationContext methodCtx(globalCtx, storage.storage);
+		methodCtx.setVerdicts(&verdicts);
+
+		std::optional<ThisPtr> thisPtr;
+		if (ths != nullptr) {
+			thisPtr = ThisPtr(internal::Il2CppObject{ ths }, call->klass);
+		}
+
+		if (node->invokeTime == InvokeTime::Before) {
+			call->invokeNodeFunction(methodCtx, thisPtr, node->data);
+			if (methodCtx.didStopExecution()) {
+				return methodCtx.getReturn<Ret>();
+			}
+		}
+
+		call->invokeOriginalFunction(methodCtx, ths, call->originalFn);
+
+		if (node->invokeTime == InvokeTime::After) {
+			call->invokeNodeFunction(methodCtx, thisPtr, node->data);
+		}
+
+		return methodCtx.getReturn<Ret>();
+	}
+};
+
+template<bool isThisCall, typename Ret, typename... Args>
+__declspec(noinline) Ret __thiscall invokeSingleMemberFunction(void *ths, Args... args) {
+	return SingleHookInvoker::invoke<isThisCall, Ret, Args...>(ths, args...);
+}
+
+template<bool isThisCall, typename Ret, typename... Args>
+__declspec(noinline) Ret invokeSingleStaticFunction(Args... args) {
+	return SingleHookInvoker::invoke<isThisCall, Ret, Args...>(nullptr, args...);
+}
+
 struct ModDeclaration {
 	semver bindingVersion;
 	const char *modName;
+
+	//Optional, mods declaring these are initialized by the loader's ModInitScheduler.
+	//`dependencies` lists the modName of every mod that must finish initializing first
+	const char *const *dependencies = nullptr;
+	uint32_t numDependencies = 0;
+	void(*initialize)(il2cpp_binding &binding) = nullptr;
 };
 ENFORCE_TYPE_OFFSET(ModDeclaration, bindingVersion, 0);
-ENFORCE_TYPE_OFFSET(ModDeclaration, modName, 16);
\ No newline at end of file
+ENFORCE_TYPE_OFFSET(ModDeclaration, modName, 16);
+ENFORCE_TYPE_OFFSET(ModDeclaration, dependencies, 24);
+ENFORCE_TYPE_OFFSET(ModDeclaration, numDependencies, 32);
+ENFORCE_TYPE_OFFSET(ModDeclaration, initialize, 40);
\ No newline at end of file
@@ -0,0 +1,458 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+
+//libgcc's unwinder, takes an .eh_frame section: CIEs and FDEs ended by a zero length
+extern "C" void __register_frame(void *begin);
+extern "C" void __deregister_frame(void *begin);
+#endif
+
+#include "il2cpp_binding.h"
+
+//Loader side compiler for hook chains. Whenever a method's chain changes, the loader can call
+//HookChainJit::rebuild with the chain's HookCalls in dispatch order; it emits a small x86-64 stub that calls every
+//node in turn with its data baked in as an immediate, checks the stop flag inline after each Before node and
+//(tail) calls the original, then publishes it in HookCall::compiledChain. FunctionChainInvoker::invoke runs the
+//stub instead of InvokeFunctionChain while it is set.
+//
+//Every stub is registered with the platform unwinder (RtlAddFunctionTable on Windows, __register_frame elsewhere), so
+//exceptions thrown by a hook or the original unwind through it like through any compiled frame. Replaced stubs are
+//retired on HookReclaimer's shared list and freed by the next dispatch that finds them unused.
+//
+//rebuild returns false and leaves the interpreted chain in place on other architectures, when a node comes from
+//a mod built against an older binding, or when executable memory can't be allocated.
+class HookChainJit {
+public:
+	static bool isSupported() {
+#if defined(_M_X64) || defined(__x86_64__)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	//`chain` holds the HookCall registered for every node of the method, in the order the loader dispatches them.
+	//`target` is the HookCall whose invokeFn the loader routes calls through
+	static bool rebuild(il2cpp_binding &binding, il2cpp_binding::HookCall &target, const il2cpp_binding::HookCall *const *chain, size_t count) {
+		binding.attachHookEpoch();
+
+		void *stub = nullptr;
+		if (isSupported() && canCompile(target, chain, count)) {
+			std::vector<uint8_t> code = emit(target, chain, count);
+			stub = allocateExecutable(code);
+			if (stub == nullptr) {
+				printf("ERROR: HookChainJit: Could not allocate executable memory, using the interpreted chain\n");
+			}
+		}
+
+		retire(target.exchangeCompiledChain(stub));
+		return stub != nullptr;
+	}
+
+	//Falls back to the interpreted chain, e.g. once a method's last node is unbound
+	static void clear(il2cpp_binding::HookCall &target) {
+		retire(target.exchangeCompiledChain(nullptr));
+	}
+
+private:
+	//Register numbers as encoded in ModRM/REX
+	enum Reg : uint8_t {
+		RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RSI = 6, RDI = 7, R8 = 8, R12 = 12, R13 = 13
+	};
+
+#if defined(_WIN32)
+	static const Reg Arg0 = RCX, Arg1 = RDX, Arg2 = R8;
+#else
+	static const Reg Arg0 = RDI, Arg1 = RSI, Arg2 = RDX;
+#endif
+
+	//MethodInvocationContext::mStopExecution, see its ENFORCE_TYPE_OFFSET
+	static const uint8_t StopExecutionOffset = 16;
+
+	//Prologue emitted by emit(): push rbx, push r12, push r13, sub rsp 32. Offsets are where each instruction ends,
+	//the unwind info describes the frame in these terms
+	static const uint8_t PushRbxEnd = 1;
+	static const uint8_t PushR12End = 3;
+	static const uint8_t PushR13End = 5;
+	static const uint8_t PrologEnd = 9;
+	static const uint8_t ShadowSpace = 32;
+
+	//Leads every stub allocation, followed by the code and then the unwind info
+	struct StubHeader {
+		size_t size;
+		size_t unwindOffset;
+	};
+
+	struct Assembler {
+		std::vector<uint8_t> code;
+
+		void byte(uint8_t value) {
+			code.push_back(value);
+		}
+
+		void imm32(uint32_t value) {
+			for (int i = 0; i < 4; ++i) {
+				byte((uint8_t)(value >> (i * 8)));
+			}
+		}
+
+		void imm64(uint64_t value) {
+			for (int i = 0; i < 8; ++i) {
+				byte((uint8_t)(value >> (i * 8)));
+			}
+		}
+
+		void push(Reg reg) {
+			if (reg >= 8) byte(0x41);
+			byte(0x50 + (reg & 7));
+		}
+
+		void pop(Reg reg) {
+			if (reg >= 8) byte(0x41);
+			byte(0x58 + (reg & 7));
+		}
+
+		//mov dst, src
+		void mov(Reg dst, Reg src) {
+			byte(0x48 | (src >= 8 ? 0x04 : 0) | (dst >= 8 ? 0x01 : 0));
+			byte(0x89);
+			byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+		}
+
+		//mov dst, imm64
+		void mov(Reg dst, const void *value) {
+			byte(0x48 | (dst >= 8 ? 0x01 : 0));
+			byte(0xB8 + (dst & 7));
+			imm64((uint64_t)(uintptr_t)value);
+		}
+
+		//sub rsp, imm8 / add rsp, imm8
+		void adjustStack(int8_t amount) {
+			byte(0x48);
+			byte(0x83);
+			byte(amount < 0 ? 0xEC : 0xC4);
+			byte((uint8_t)(amount < 0 ? -amount : amount));
+		}
+
+		void callRax() {
+			byte(0xFF);
+			byte(0xD0);
+		}
+
+		void jmpRax() {
+			byte(0xFF);
+			byte(0xE0);
+		}
+
+		void ret() {
+			byte(0xC3);
+		}
+
+		//cmp byte ptr [rbx + offset], 0 ; jne <patched later>. Returns the position of the rel32 to patch
+		size_t jumpIfStopped() {
+			byte(0x80);
+			byte(0x7B);
+			byte(StopExecutionOffset);
+			byte(0x00);
+			byte(0x0F);
+			byte(0x85);
+			size_t patch = code.size();
+			imm32(0);
+			return patch;
+		}
+
+		void patchJump(size_t patch, size_t target) {
+			uint32_t rel = (uint32_t)(int32_t)((int64_t)target - (int64_t)(patch + 4));
+			memcpy(&code[patch], &rel, sizeof(rel));
+		}
+	};
+
+	//invokeNodeFunctionIndirect was added in binding 2.6. The 3.0 bump only changed MethodHookNode, the field kept its offset
+	static bool hasIndirectInvoker(const il2cpp_binding::HookCall &call) {
+		semver version = call.hookVersion;
+		return !(version < semver{ 2, 6, 0 }) && call.invokeNodeFunctionIndirect != nullptr;
+	}
+
+	static bool canCompile(const il2cpp_binding::HookCall &target, const il2cpp_binding::HookCall *const *chain, size_t count) {
+		if (target.invokeOriginalFunction == nullptr) {
+			return false;
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			if (!hasIndirectInvoker(*chain[i]) || chain[i]->node == nullptr) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//Stub signature is HookCall::CompiledChainFn. rbx, r12 and r13 hold ctx, ths and the raw this pointer across calls
+	static std::vector<uint8_t> emit(const il2cpp_binding::HookCall &target, const il2cpp_binding::HookCall *const *chain, size_t count) {
+		Assembler a;
+		std::vector<size_t> stopJumps;
+
+		//Three pushes realign rsp to 16, the 32 bytes are the Win64 shadow space for our callees
+		a.push(RBX);
+		a.push(R12);
+		a.push(R13);
+		a.adjustStack(-(int8_t)ShadowSpace);
+		a.mov(RBX, Arg0);
+		a.mov(R12, Arg1);
+		a.mov(R13, Arg2);
+
+		auto emitNode = [&a](const il2cpp_binding::HookCall &call) {
+			a.mov(Arg0, RBX);
+			a.mov(Arg1, R12);
+			a.mov(Arg2, call.node->data);
+			a.mov(RAX, (const void *)call.invokeNodeFunctionIndirect);
+			a.callRax();
+		};
+
+		bool hasAfter = false;
+		for (size_t i = 0; i < count; ++i) {
+			if (chain[i]->node->invokeTime == InvokeTime::Before) {
+				emitNode(*chain[i]);
+				stopJumps.push_back(a.jumpIfStopped());
+			}
+			else {
+				hasAfter = true;
+			}
+		}
+
+		a.mov(Arg0, RBX);
+		a.mov(Arg1, R13);
+		a.mov(Arg2, target.originalFn);
+		a.mov(RAX, (const void *)target.invokeOriginalFunction);
+
+		if (!hasAfter) {
+			//Nothing runs after the original, so restore our frame and let it return straight to our caller
+			a.adjustStack(ShadowSpace);
+			a.pop(R13);
+			a.pop(R12);
+			a.pop(RBX);
+			a.jmpRax();
+		}
+		else {
+			a.callRax();
+			for (size_t i = 0; i < count; ++i) {
+				if (chain[i]->node->invokeTime == InvokeTime::After) {
+					emitNode(*chain[i]);
+				}
+			}
+		}
+
+		size_t epilogue = a.code.size();
+		for (size_t patch : stopJumps) {
+			a.patchJump(patch, epilogue);
+		}
+		a.adjustStack(ShadowSpace);
+		a.pop(R13);
+		a.pop(R12);
+		a.pop(RBX);
+		a.ret();
+
+		return std::move(a.code);
+	}
+
+#if defined(_WIN32)
+	//UNWIND_INFO with its four codes, followed by the RUNTIME_FUNCTION covering the stub
+	struct UnwindData {
+		uint8_t versionAndFlags;
+		uint8_t sizeOfProlog;
+		uint8_t countOfCodes;
+		uint8_t frameRegister;
+		uint16_t codes[4];
+		RUNTIME_FUNCTION function;
+	};
+
+	static uint16_t unwindCode(uint8_t offset, uint8_t op, uint8_t info) {
+		return (uint16_t)(offset | ((op | (info << 4)) << 8));
+	}
+
+	//RVAs are relative to the allocation, which RtlAddFunctionTable gets as its base
+	static std::vector<uint8_t> emitUnwindInfo(const uint8_t *memory, const uint8_t *code, size_t codeSize, size_t unwindOffset) {
+		const uint8_t UWOP_PUSH_NONVOL = 0, UWOP_ALLOC_SMALL = 2;
+
+		UnwindData data = {};
+		data.versionAndFlags = 1;
+		data.sizeOfProlog = PrologEnd;
+		data.countOfCodes = 4;
+
+		//Codes are listed in reverse order of the prologue
+		data.codes[0] = unwindCode(PrologEnd, UWOP_ALLOC_SMALL, ShadowSpace / 8 - 1);
+		data.codes[1] = unwindCode(PushR13End, UWOP_PUSH_NONVOL, R13);
+		data.codes[2] = unwindCode(PushR12End, UWOP_PUSH_NONVOL, R12);
+		data.codes[3] = unwindCode(PushRbxEnd, UWOP_PUSH_NONVOL, RBX);
+
+		data.function.BeginAddress = (DWORD)(code - memory);
+		data.function.EndAddress = (DWORD)(code - memory + codeSize);
+		data.function.UnwindData = (DWORD)unwindOffset;
+
+		std::vector<uint8_t> bytes(sizeof(data));
+		memcpy(bytes.data(), &data, sizeof(data));
+		return bytes;
+	}
+
+	static bool registerUnwindInfo(uint8_t *memory, const StubHeader &header) {
+		UnwindData *data = reinterpret_cast<UnwindData *>(memory + header.unwindOffset);
+		return RtlAddFunctionTable(&data->function, 1, (DWORD64)memory) != FALSE;
+	}
+
+	static void deregisterUnwindInfo(uint8_t *memory, const StubHeader &header) {
+		UnwindData *data = reinterpret_cast<UnwindData *>(memory + header.unwindOffset);
+		RtlDeleteFunctionTable(&data->function);
+	}
+#else
+	//Pads a CIE/FDE so the next record starts 8 byte aligned, then fills in its length
+	static void finishRecord(Assembler &a, size_t start) {
+		while ((a.code.size() - start) % 8 != 0) {
+			a.byte(0x00);	//DW_CFA_nop
+		}
+		uint32_t length = (uint32_t)(a.code.size() - start - 4);
+		memcpy(&a.code[start], &length, sizeof(length));
+	}
+
+	//.eh_frame with one CIE and one FDE for the stub. DWARF numbers rbx 3, rsp 7, r12 12, r13 13, return address 16
+	static std::vector<uint8_t> emitUnwindInfo(const uint8_t *, const uint8_t *code, size_t codeSize, size_t) {
+		Assembler a;
+
+		size_t cie = a.code.size();
+		a.imm32(0);
+		a.imm32(0);				//CIE id
+		a.byte(1);				//Version
+		a.byte('z');
+		a.byte('R');
+		a.byte(0);
+		a.byte(1);				//Code alignment
+		a.byte(0x78);			//Data alignment -8
+		a.byte(16);				//Return address column
+		a.byte(1);				//Augmentation data length
+		a.byte(0x00);			//DW_EH_PE_absptr
+		a.byte(0x0C);			//DW_CFA_def_cfa rsp+8
+		a.byte(7);
+		a.byte(8);
+		a.byte(0x80 | 16);		//DW_CFA_offset return address, cfa-8
+		a.byte(1);
+		finishRecord(a, cie);
+
+		size_t fde = a.code.size();
+		a.imm32(0);
+		a.imm32((uint32_t)(fde + 4 - cie));	//Distance back to the CIE
+		a.imm64((uint64_t)(uintptr_t)code);
+		a.imm64(codeSize);
+		a.byte(0);				//Augmentation data length
+
+		//One row per prologue instruction: advance to its end, move the CFA, record the saved register
+		const uint8_t steps[][3] = {
+			{ PushRbxEnd, 16, 3 },
+			{ PushR12End - PushRbxEnd, 24, 12 },
+			{ PushR13End - PushR12End, 32, 13 },
+		};
+		for (auto &step : steps) {
+			a.byte(0x40 | step[0]);	//DW_CFA_advance_loc
+			a.byte(0x0E);			//DW_CFA_def_cfa_offset
+			a.byte(step[1]);
+			a.byte(0x80 | step[2]);	//DW_CFA_offset, factored by the data alignment
+			a.byte(step[1] / 8);
+		}
+		a.byte(0x40 | (PrologEnd - PushR13End));
+		a.byte(0x0E);
+		a.byte(32 + ShadowSpace);
+		finishRecord(a, fde);
+
+		a.imm32(0);				//End of the section
+		return std::move(a.code);
+	}
+
+	static bool registerUnwindInfo(uint8_t *memory, const StubHeader &header) {
+		__register_frame(memory + header.unwindOffset);
+		return true;
+	}
+
+	static void deregisterUnwindInfo(uint8_t *memory, const StubHeader &header) {
+		__deregister_frame(memory + header.unwindOffset);
+	}
+#endif
+
+	//Pages are written while RW and flipped to RX before the stub is published, never writable and executable at once
+	static void *allocateExecutable(const std::vector<uint8_t> &code) {
+		StubHeader header;
+		header.unwindOffset = (sizeof(StubHeader) + code.size() + 7) & ~(size_t)7;
+		header.size = header.unwindOffset + emitUnwindInfo(nullptr, nullptr, 0, 0).size();
+
+#if defined(_WIN32)
+		uint8_t *memory = static_cast<uint8_t *>(VirtualAlloc(nullptr, header.size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+		if (memory == nullptr) {
+			return nullptr;
+		}
+#else
+		uint8_t *memory = static_cast<uint8_t *>(mmap(nullptr, header.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if (memory == MAP_FAILED) {
+			return nullptr;
+		}
+#endif
+
+		uint8_t *stub = memory + sizeof(StubHeader);
+		std::vector<uint8_t> unwind = emitUnwindInfo(memory, stub, code.size(), header.unwindOffset);
+		memcpy(memory, &header, sizeof(header));
+		memcpy(stub, code.data(), code.size());
+		memcpy(memory + header.unwindOffset, unwind.data(), unwind.size());
+
+#if defined(_WIN32)
+		DWORD oldProtect;
+		if (!VirtualProtect(memory, header.size, PAGE_EXECUTE_READ, &oldProtect)) {
+			VirtualFree(memory, 0, MEM_RELEASE);
+			return nullptr;
+		}
+		FlushInstructionCache(GetCurrentProcess(), memory, header.size);
+#else
+		if (mprotect(memory, header.size, PROT_READ | PROT_EXEC) != 0) {
+			munmap(memory, header.size);
+			return nullptr;
+		}
+#endif
+
+		if (!registerUnwindInfo(memory, header)) {
+			printf("ERROR: HookChainJit: Could not register unwind info for the stub\n");
+			releaseMemory(memory, header);
+			return nullptr;
+		}
+		return stub;
+	}
+
+	static void releaseMemory(uint8_t *memory, const StubHeader &header) {
+#if defined(_WIN32)
+		VirtualFree(memory, 0, MEM_RELEASE);
+#else
+		munmap(memory, header.size);
+#endif
+	}
+
+	static void releaseExecutable(void *stub) {
+		uint8_t *memory = static_cast<uint8_t *>(stub) - sizeof(StubHeader);
+		StubHeader header;
+		memcpy(&header, memory, sizeof(header));
+
+		deregisterUnwindInfo(memory, header);
+		releaseMemory(memory, header);
+	}
+
+	//A replaced stub may still be running on another thread, it is freed once every dispatch that could see it is done.
+	//The shared list lets the mods' dispatches free it, the loader itself rarely dispatches
+	static void retire(void *stub) {
+		if (stub == nullptr) {
+			return;
+		}
+
+		HookReclaimer::global().retireShared(&releaseExecutable, stub);
+		HookReclaimer::collectShared();
+	}
+};
@@ -20,6 +20,17 @@ il2cppapi::Class* il2cpp_context::getClassFromObject(internal::Il2CppObject obj)
 	return mGetClassFromObject(obj);
 }
 
+size_t il2cpp_context::getFieldOffset(const internal::FieldInfo * field) const {
+	if (field == nullptr) return 0;
+
+	//Appended to the table later, loaders built before it leave the entry null
+	if (il2cpp_field_get_offset == nullptr) {
+		printf("ERROR: getFieldOffset: The loader does not provide il2cpp_field_get_offset, update the mod loader!\n");
+		return 0;
+	}
+	return il2cpp_field_get_offset(field);
+}
+
 void il2cpp_context::getValueFromField(internal::Il2CppObject obj, const internal::FieldInfo * field, void * value) const {
 	il2cpp_field_get_value(obj, field, value);
 }
@@ -100,6 +111,10 @@ std::wstring il2cpp_context::getCString(const internal::Il2CppString str) const
 	return std::wstring(getStringChars(str), getStringLength(str));
 }
 
+size_t il2cppapi::Class::fieldOffset(const char *fieldName) const {
+	return ctx.getFieldOffset(ctx.getClassFieldInfo(klass, fieldName));
+}
+
 uint32_t il2cpp_context::getArrayLength(internal::Il2CppObject arr) const {
 	return il2cpp_array_length(arr);
 }
@@ -115,4 +130,18 @@ uint32_t il2cpp_context::getArrayStride(internal::Il2CppObject arr) const {
 	}
 
 	return getArrayByteLength(arr) / elements;
-}
\ No newline at end of file
+}
+
+internal::Il2CppThread *il2cpp_context::attachThread() const {
+	//Appended to the table later, loaders built before it leave the entries null
+	if (il2cpp_thread_attach == nullptr || il2cpp_thread_detach == nullptr) {
+		return nullptr;
+	}
+	return il2cpp_thread_attach(il2cpp_domain_get());
+}
+
+void il2cpp_context::detachThread(internal::Il2CppThread *thread) const {
+	if (thread != nullptr && il2cpp_thread_detach != nullptr) {
+		il2cpp_thread_detach(thread);
+	}
+}
@@ -23,6 +23,8 @@ public:
 	const internal::FieldInfo *getClassFieldInfo(internal::Il2CppClass* klass, const char *fieldName, bool error = true) const;
 	const internal::PropertyInfo *getClassPropertyInfo(internal::Il2CppClass* klass, const char *propName, bool error = true) const;
 
+	//0 if the field is null or its offset can't be resolved. 0 is never a valid instance field offset
+	size_t getFieldOffset(const internal::FieldInfo* field) const;
 	void getValueFromField(internal::Il2CppObject obj, const internal::FieldInfo* field, void *value) const;
 	void setValueFromField(internal::Il2CppObject obj, const internal::FieldInfo* field, const void *value) const;
 
@@ -42,6 +44,11 @@ public:
 	uint32_t getArrayByteLength(internal::Il2CppObject arr) const;
 	uint32_t getArrayStride(internal::Il2CppObject arr) const;
 
+	//Registers a thread the game didn't create with the il2cpp runtime, required before it touches managed state.
+	//nullptr if the loader doesn't provide the entry
+	internal::Il2CppThread *attachThread() const;
+	void detachThread(internal::Il2CppThread *thread) const;
+
 protected:
 	internal::FieldInfo* (*il2cpp_class_get_field_from_name)(internal::Il2CppClass* klass, const char* name);
 	void(*il2cpp_field_get_value)(internal::Il2CppObject obj, const internal::FieldInfo* field, void* value);
@@ -69,4 +76,9 @@ protected:
 	il2cppapi::Class*(*mGetClass)(const char *, const char *);
 	il2cppapi::Class*(*mGetClassFromField)(const internal::FieldInfo* field);
 	il2cppapi::Class*(*mGetClassFromObject)(internal::Il2CppObject obj);
+
+	//Appended after the original table so older loaders keep the same layout
+	size_t(*il2cpp_field_get_offset)(const internal::FieldInfo* field);
+	internal::Il2CppThread* (*il2cpp_thread_attach)(internal::Il2CppDomain* domain);
+	void(*il2cpp_thread_detach)(internal::Il2CppThread* thread);
 };
\ No newline at end of file
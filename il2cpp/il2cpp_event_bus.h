@@ -0,0 +1,433 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#include "il2cpp_binding.h"
+
+//Publish/subscribe between mods. One mod hooks a method once and publishes a fixed-size POD event; every
+//interested mod subscribes to the topic instead of binding the same method again.
+//
+//	struct NoteHit { int32_t cue; float accuracy; };
+//	auto topic = EventBus(binding).topic<NoteHit>("Audica.NoteHit");
+//	topic.publish({ cue, accuracy });								//From a hook
+//	auto queued = topic.subscribe(1024, BackpressurePolicy::DropOldest);
+//	queued->poll([](const NoteHit &hit) { ... });					//From any one consumer thread
+//	auto direct = topic.subscribe([](const NoteHit &hit) { ... });	//Runs on the publisher's thread
+//
+//The topic table lives in il2cpp_binding::getSharedData so every mod sees the same topics. It only holds
+//plain data and pointers; each subscription's memory belongs to the mod that created it.
+
+enum class BackpressurePolicy : uint32_t {
+	DropOldest,	//Discard the oldest queued event to make room
+	DropNewest,	//Discard the event being published
+
+	//Wait for the consumer. Never use this if the consumer runs on the publishing thread. The publisher waits outside
+	//its own HookReclaimer::DispatchGuard, but a publisher inside a hook still holds its invoker's, which holds up
+	//reclamation for every mod; prefer the drop policies there
+	Block
+};
+
+//Bounded lock free MPMC ring buffer (Vyukov). Capacity is rounded up to a power of two
+template<typename T>
+class EventQueue {
+public:
+	static_assert(std::is_trivially_copyable_v<T>, "Events must be trivially copyable");
+
+	explicit EventQueue(uint32_t capacity) {
+		uint32_t size = 2;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		mMask = size - 1;
+		mCells.reset(new Cell[size]);
+		for (uint32_t i = 0; i < size; ++i) {
+			mCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	bool tryPush(const T &value) {
+		uint64_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell &cell = mCells[pos & mMask];
+			uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+			int64_t diff = (int64_t)seq - (int64_t)pos;
+			if (diff == 0) {
+				if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = mEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool tryPop(T &value) {
+		uint64_t pos = mDequeuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell &cell = mCells[pos & mMask];
+			uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+			int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+			if (diff == 0) {
+				if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					value = cell.value;
+					cell.sequence.store(pos + mMask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = mDequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	uint32_t capacity() const {
+		return mMask + 1;
+	}
+
+private:
+	struct Cell {
+		std::atomic<uint64_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> mCells;
+	uint32_t mMask = 0;
+	alignas(64) std::atomic<uint64_t> mEnqueuePos{ 0 };
+	alignas(64) std::atomic<uint64_t> mDequeuePos{ 0 };
+};
+
+//Receiving end of a topic, as seen by publishers in any mod
+struct EventSink {
+	virtual ~EventSink() = default;
+
+	//Returns false if the sink is full and the publisher should wait and try again (BackpressurePolicy::Block)
+	virtual bool deliver(const void *event) = 0;
+
+	//Set once the sink has been removed from its topic, so a blocked publisher stops waiting for it
+	std::atomic<bool> closed{ false };
+};
+
+struct EventTopicState {
+	static const uint32_t MaxNameLength = 64;
+	static const uint32_t MaxSubscribers = 16;
+
+	char name[MaxNameLength];
+	uint32_t eventSize;
+	std::atomic<EventSink *> sinks[MaxSubscribers];
+};
+
+struct EventBusState {
+	static const uint32_t MaxTopics = 128;
+
+	std::atomic<uint32_t> lock;
+	uint32_t numTopics;
+	EventTopicState topics[MaxTopics];
+};
+
+//Removes a sink from its topic and frees it once no publisher can still be delivering to it.
+//Publishers hold a HookReclaimer::DispatchGuard, so this never waits and is safe from inside a callback on the same topic
+inline void retireEventSink(EventTopicState *topic, EventSink *sink) {
+	if (sink == nullptr) {
+		return;
+	}
+
+	if (topic != nullptr) {
+		for (auto &slot : topic->sinks) {
+			EventSink *expected = sink;
+			slot.compare_exchange_strong(expected, nullptr);
+		}
+	}
+	sink->closed.store(true);
+
+	HookReclaimer::global().retire([](void *data) { delete static_cast<EventSink *>(data); }, sink);
+	HookReclaimer::global().collect(false);
+}
+
+template<typename T>
+class EventQueueSink : public EventSink {
+public:
+	EventQueueSink(uint32_t capacity, BackpressurePolicy policy) : mQueue(capacity), mPolicy(policy) {}
+
+	bool deliver(const void *event) override {
+		const T &value = *static_cast<const T *>(event);
+		if (mQueue.tryPush(value)) {
+			return true;
+		}
+
+		switch (mPolicy) {
+		case BackpressurePolicy::DropNewest:
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			break;
+
+		case BackpressurePolicy::DropOldest: {
+			T discarded;
+			while (!mQueue.tryPush(value)) {
+				if (mQueue.tryPop(discarded)) {
+					mDropped.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+			break;
+		}
+
+		case BackpressurePolicy::Block:
+			//The publisher waits outside its DispatchGuard, see EventTopic::publish
+			if (closed.load(std::memory_order_relaxed)) {
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+				break;
+			}
+			return false;
+		}
+		return true;
+	}
+
+private:
+	template<typename U>
+	friend class EventSubscription;
+
+	EventQueue<T> mQueue;
+	BackpressurePolicy mPolicy;
+	std::atomic<uint64_t> mDropped{ 0 };
+};
+
+//Subscription that queues events for a consumer to poll. Unsubscribes when destroyed, from any thread
+template<typename T>
+class EventSubscription {
+public:
+	EventSubscription(EventTopicState *topic, uint32_t capacity, BackpressurePolicy policy)
+		: mTopic(topic), mSink(new EventQueueSink<T>(capacity, policy)) {
+	}
+
+	~EventSubscription() {
+		retireEventSink(mTopic, mSink);
+	}
+
+	EventSubscription(const EventSubscription &) = delete;
+	EventSubscription &operator=(const EventSubscription &) = delete;
+
+	bool tryPop(T &value) {
+		return mSink->mQueue.tryPop(value);
+	}
+
+	//Hands up to `maxEvents` queued events to `fn`, returns how many were handled
+	template<typename Fn>
+	uint32_t poll(Fn &&fn, uint32_t maxEvents = 0xFFFFFFFF) {
+		uint32_t handled = 0;
+		T value;
+		while (handled < maxEvents && mSink->mQueue.tryPop(value)) {
+			fn(static_cast<const T &>(value));
+			++handled;
+		}
+		return handled;
+	}
+
+	uint64_t droppedCount() const {
+		return mSink->mDropped.load(std::memory_order_relaxed);
+	}
+
+	EventSink *sink() const {
+		return mSink;
+	}
+
+private:
+	EventTopicState *mTopic;
+	EventQueueSink<T> *mSink;
+};
+
+template<typename T>
+class EventCallbackSink : public EventSink {
+public:
+	explicit EventCallbackSink(std::function<void(const T &)> &&callback) : mCallback(std::move(callback)) {}
+
+	bool deliver(const void *event) override {
+		if (!closed.load(std::memory_order_relaxed)) {
+			mCallback(*static_cast<const T *>(event));
+		}
+		return true;
+	}
+
+private:
+	std::function<void(const T &)> mCallback;
+};
+
+//Subscription that runs a callback synchronously on the publishing thread. Can be destroyed from anywhere,
+//including its own callback; a delivery already in progress finishes, later ones are skipped
+template<typename T>
+class EventCallbackSubscription {
+public:
+	EventCallbackSubscription(EventTopicState *topic, std::function<void(const T &)> &&callback)
+		: mTopic(topic), mSink(new EventCallbackSink<T>(std::move(callback))) {
+	}
+
+	~EventCallbackSubscription() {
+		retireEventSink(mTopic, mSink);
+	}
+
+	EventCallbackSubscription(const EventCallbackSubscription &) = delete;
+	EventCallbackSubscription &operator=(const EventCallbackSubscription &) = delete;
+
+	EventSink *sink() const {
+		return mSink;
+	}
+
+private:
+	EventTopicState *mTopic;
+	EventCallbackSink<T> *mSink;
+};
+
+template<typename T>
+class EventTopic {
+public:
+	static_assert(std::is_trivially_copyable_v<T>, "Events must be fixed size POD types");
+
+	explicit EventTopic(EventTopicState *state) : mState(state) {}
+
+	bool isValid() const {
+		return mState != nullptr;
+	}
+
+	//Delivers the event to every current subscriber
+	void publish(const T &event) {
+		if (mState == nullptr) {
+			return;
+		}
+
+		//Sinks are retired through HookReclaimer, the guard keeps every sink loaded below alive until it returns
+		uint32_t full[EventTopicState::MaxSubscribers];
+		uint32_t numFull = 0;
+		{
+			HookReclaimer::DispatchGuard guard;
+			for (uint32_t i = 0; i < EventTopicState::MaxSubscribers; ++i) {
+				EventSink *sink = mState->sinks[i].load();
+				if (sink != nullptr && !sink->deliver(&event)) {
+					full[numFull++] = i;
+				}
+			}
+		}
+
+		//Blocking sinks are waited for without a guard, so reclamation goes on meanwhile. Each retry takes a new
+		//guard and reloads the slot, a sink that was unsubscribed in between is gone and no longer waited for
+		for (uint32_t i = 0; i < numFull; ++i) {
+			std::atomic<EventSink *> &slot = mState->sinks[full[i]];
+			for (;;) {
+				std::this_thread::yield();
+
+				HookReclaimer::DispatchGuard guard;
+				EventSink *sink = slot.load();
+				if (sink == nullptr || sink->deliver(&event)) {
+					break;
+				}
+			}
+		}
+	}
+
+	std::unique_ptr<EventSubscription<T>> subscribe(uint32_t capacity, BackpressurePolicy policy = BackpressurePolicy::DropOldest) {
+		auto subscription = std::make_unique<EventSubscription<T>>(mState, capacity, policy);
+		if (!attach(subscription->sink())) {
+			return nullptr;
+		}
+		return subscription;
+	}
+
+	std::unique_ptr<EventCallbackSubscription<T>> subscribe(std::function<void(const T &)> &&callback) {
+		auto subscription = std::make_unique<EventCallbackSubscription<T>>(mState, std::move(callback));
+		if (!attach(subscription->sink())) {
+			return nullptr;
+		}
+		return subscription;
+	}
+
+private:
+	bool attach(EventSink *sink) {
+		if (mState == nullptr) {
+			return false;
+		}
+
+		for (auto &slot : mState->sinks) {
+			EventSink *expected = nullptr;
+			if (slot.compare_exchange_strong(expected, sink)) {
+				return true;
+			}
+		}
+
+		printf("ERROR: EventBus: Topic %s already has %u subscribers!\n", mState->name, EventTopicState::MaxSubscribers);
+		return false;
+	}
+
+	EventTopicState *mState;
+};
+
+class EventBus {
+public:
+	explicit EventBus(il2cpp_binding &binding)
+		: mState(static_cast<EventBusState *>(binding.getSharedData("EventBus", sizeof(EventBusState)))) {
+		binding.attachHookEpoch();
+	}
+
+	//Finds or creates a topic. Every mod using the same name must use an event type of the same size
+	template<typename T>
+	EventTopic<T> topic(const char *name) {
+		if (mState == nullptr) {
+			return EventTopic<T>(nullptr);
+		}
+
+		lock();
+		EventTopicState *found = nullptr;
+		for (uint32_t i = 0; i < mState->numTopics; ++i) {
+			if (strncmp(mState->topics[i].name, name, EventTopicState::MaxNameLength) == 0) {
+				found = &mState->topics[i];
+				break;
+			}
+		}
+
+		if (found == nullptr && mState->numTopics < EventBusState::MaxTopics) {
+			found = &mState->topics[mState->numTopics++];
+			size_t length = strnlen(name, EventTopicState::MaxNameLength - 1);
+			std::memcpy(found->name, name, length);
+			found->name[length] = '\0';
+			found->eventSize = sizeof(T);
+		}
+		unlock();
+
+		if (found == nullptr) {
+			printf("ERROR: EventBus: Too many topics, could not create %s!\n", name);
+			return EventTopic<T>(nullptr);
+		}
+
+		if (found->eventSize != sizeof(T)) {
+			printf("ERROR: EventBus: Topic %s carries %u byte events, but was requested with a %u byte type!\n", name, found->eventSize, (uint32_t)sizeof(T));
+			return EventTopic<T>(nullptr);
+		}
+
+		return EventTopic<T>(found);
+	}
+
+private:
+	void lock() {
+		uint32_t expected = 0;
+		while (!mState->lock.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+			expected = 0;
+			std::this_thread::yield();
+		}
+	}
+
+	void unlock() {
+		mState->lock.store(0, std::memory_order_release);
+	}
+
+	EventBusState *mState;
+};
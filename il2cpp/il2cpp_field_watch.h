@@ -0,0 +1,354 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include <emmintrin.h>
+
+#include "il2cpp_types.h"
+#include "il2cpp_binding.h"
+
+//Per-frame change detection for fields across many objects.
+//Instead of polling `obj.field<T>("name").get()` and comparing by hand, register the fields once:
+//
+//	il2cppapi::FieldWatcher watcher;
+//	watcher.watch(target, "hitCount", sizeof(int32_t), [](const il2cppapi::FieldChange &change) { ... });
+//	watcher.attach(binding, "", "ScoreKeeper", "Update");	//Unbound again by detach or the destructor
+//
+//Every update copies all watched fields into one contiguous snapshot, compares it with the previous frame 16 bytes
+//at a time, and only runs callbacks for fields whose bytes changed. Watched objects must stay alive (or be unwatched)
+//for as long as they are watched; the watcher reads them directly by offset. Don't watch or unwatch from inside a
+//change callback.
+namespace il2cppapi {
+	struct FieldChange {
+		uint32_t id;
+		void *object;
+		size_t fieldOffset;
+		uint32_t size;
+
+		//Both only valid during the callback
+		const void *previous;
+		const void *current;
+
+		template<typename T>
+		T previousAs() const {
+			T value;
+			std::memcpy(&value, previous, sizeof(T));
+			return value;
+		}
+
+		template<typename T>
+		T currentAs() const {
+			T value;
+			std::memcpy(&value, current, sizeof(T));
+			return value;
+		}
+	};
+
+	class FieldWatcher {
+	public:
+		using Callback = std::function<void(const FieldChange &change)>;
+
+		static constexpr uint32_t InvalidId = 0xFFFFFFFF;
+
+		FieldWatcher() = default;
+		FieldWatcher(const FieldWatcher &) = delete;
+		FieldWatcher &operator=(const FieldWatcher &) = delete;
+
+		~FieldWatcher() {
+			detach();
+		}
+
+		//Watches `size` bytes at `fieldOffset` in `object`. The current value is the baseline, so the callback
+		//first runs once it differs. Returns an id for unwatch
+		uint32_t watch(void *object, size_t fieldOffset, uint32_t size, Callback &&callback) {
+			if (object == nullptr || size == 0) {
+				return InvalidId;
+			}
+
+			uint32_t id;
+			if (!mFreeIds.empty()) {
+				id = mFreeIds.back();
+				mFreeIds.pop_back();
+			}
+			else {
+				id = (uint32_t)mIdToEntry.size();
+				mIdToEntry.push_back(InvalidId);
+			}
+
+			Entry entry;
+			entry.source = static_cast<const uint8_t *>(object) + fieldOffset;
+			entry.size = size;
+			entry.snapshotOffset = place(mSnapshotSize, size);
+			mSnapshotSize = entry.snapshotOffset + size;
+
+			mIdToEntry[id] = (uint32_t)mEntries.size();
+			mEntries.push_back(entry);
+			mWatches.push_back({ object, fieldOffset, id, std::move(callback) });
+
+			growSnapshots();
+			std::memcpy(mPrevious.data() + entry.snapshotOffset, entry.source, size);
+			return id;
+		}
+
+		//Fails if the field can't be resolved, rather than watching the object header at offset 0
+		uint32_t watch(ThisPtr object, const char *fieldName, uint32_t size, Callback &&callback) {
+			if (object.ptr == nullptr || object.klass == nullptr) {
+				return InvalidId;
+			}
+
+			size_t offset = object.klass->fieldOffset(fieldName);
+			if (offset == 0) {
+				printf("ERROR: FieldWatcher: Could not resolve field %s, it will not be watched!\n", fieldName);
+				return InvalidId;
+			}
+			return watch(object.ptr, offset, size, std::move(callback));
+		}
+
+		template<typename T>
+		uint32_t watch(ThisPtr object, const char *fieldName, std::function<void(const FieldChange &change, T previous, T current)> &&callback) {
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable fields can be watched");
+			return watch(object, fieldName, sizeof(T), [callback = std::move(callback)](const FieldChange &change) {
+				callback(change, change.previousAs<T>(), change.currentAs<T>());
+			});
+		}
+
+		//Stops watching. The entry's snapshot space is reclaimed the next time more than half of it is unused
+		void unwatch(uint32_t id) {
+			if (id >= mIdToEntry.size() || mIdToEntry[id] == InvalidId) {
+				return;
+			}
+
+			uint32_t index = mIdToEntry[id];
+			mEntries[index].source = nullptr;
+			mWatches[index].callback = nullptr;
+			mIdToEntry[id] = InvalidId;
+			mFreeIds.push_back(id);
+			++mDeadEntries;
+		}
+
+		size_t watchedCount() const {
+			return mEntries.size() - mDeadEntries;
+		}
+
+		//Snapshots every watched field, diffs against the previous update and runs callbacks for changed fields.
+		//Returns how many fields changed
+		uint32_t update() {
+			if (mDeadEntries * 2 > mEntries.size()) {
+				compact();
+			}
+
+			snapshot();
+			uint32_t changed = diff();
+			for (uint32_t index : mDirty) {
+				const Entry &entry = mEntries[index];
+				const Watch &watch = mWatches[index];
+				FieldChange change{ watch.id, watch.object, watch.fieldOffset, entry.size,
+					mPrevious.data() + entry.snapshotOffset, mCurrent.data() + entry.snapshotOffset };
+				watch.callback(change);
+			}
+
+			std::swap(mPrevious, mCurrent);
+			return changed;
+		}
+
+		//Updates after every call of the given per-frame method, e.g. an Update.
+		//The hook is unbound again by detach or when the watcher is destroyed, replacing any previous attach
+		bool attach(il2cpp_binding &binding, const char *namespaceName, const char *className, const char *methodName, int priority = 0) {
+			detach();
+
+			mUpdateHook = binding.bindClassFunction(namespaceName, className, methodName, InvokeTime::After, priority, [this](const MethodInvocationContext &, ThisPtr) {
+				update();
+			});
+			if (!mUpdateHook.isValid()) {
+				return false;
+			}
+
+			mBinding = &binding;
+			return true;
+		}
+
+		void detach() {
+			if (mBinding != nullptr) {
+				mBinding->unbind(mUpdateHook);
+				mBinding = nullptr;
+				mUpdateHook = HookHandle();
+			}
+		}
+
+	private:
+		static const uint32_t ChunkSize = 16;
+
+		//How many objects ahead to prefetch while snapshotting, as in GatherOptions
+		static const uint32_t PrefetchDistance = 8;
+
+		//What the snapshot loop touches, kept apart from the callbacks so it stays dense
+		struct Entry {
+			const uint8_t *source;
+			uint32_t size;
+			uint32_t snapshotOffset;
+		};
+
+		struct Watch {
+			void *object;
+			size_t fieldOffset;
+			uint32_t id;
+			Callback callback;
+		};
+
+		//Fields up to 16 bytes never straddle a chunk, larger ones start on a chunk boundary.
+		//Power of two sizes are naturally aligned, so small fields pack densely
+		static uint32_t place(uint32_t offset, uint32_t size) {
+			if (size > ChunkSize) {
+				return (offset + ChunkSize - 1) & ~(ChunkSize - 1);
+			}
+
+			uint32_t align = 1;
+			while (align < size) {
+				align <<= 1;
+			}
+			offset = (offset + align - 1) & ~(align - 1);
+
+			if ((offset % ChunkSize) + size > ChunkSize) {
+				offset = (offset + ChunkSize - 1) & ~(ChunkSize - 1);
+			}
+			return offset;
+		}
+
+		void growSnapshots() {
+			size_t chunks = (mSnapshotSize + ChunkSize - 1) / ChunkSize;
+			if (mPrevious.size() < chunks * ChunkSize) {
+				size_t size = std::max(chunks * ChunkSize, mPrevious.size() * 2);
+				mPrevious.resize(size);
+				mCurrent.resize(size);
+			}
+
+			//First entry touching each chunk, entries are in snapshot order
+			while (mChunkFirstEntry.size() < chunks) {
+				mChunkFirstEntry.push_back((uint32_t)mEntries.size() - 1);
+			}
+		}
+
+		void snapshot() {
+			uint8_t *current = mCurrent.data();
+			size_t count = mEntries.size();
+			for (size_t i = 0; i < count; ++i) {
+				if (i + PrefetchDistance < count) {
+					_mm_prefetch(reinterpret_cast<const char *>(mEntries[i + PrefetchDistance].source), _MM_HINT_T0);
+				}
+
+				const Entry &entry = mEntries[i];
+				const uint8_t *source = entry.source;
+				if (source == nullptr) {
+					continue;
+				}
+
+				uint8_t *target = current + entry.snapshotOffset;
+				switch (entry.size) {
+				case 1: *target = *source; break;
+				case 2: std::memcpy(target, source, 2); break;
+				case 4: std::memcpy(target, source, 4); break;
+				case 8: std::memcpy(target, source, 8); break;
+				default: std::memcpy(target, source, entry.size); break;
+				}
+			}
+		}
+
+		uint32_t diff() {
+			mDirty.clear();
+
+			const uint8_t *previous = mPrevious.data();
+			const uint8_t *current = mCurrent.data();
+			uint32_t chunks = (uint32_t)mChunkFirstEntry.size();
+			uint32_t lastDirty = InvalidId;
+
+			for (uint32_t chunk = 0; chunk < chunks; ++chunk) {
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous + chunk * ChunkSize));
+				__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current + chunk * ChunkSize));
+				uint32_t changedBytes = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xFFFF;
+				if (changedBytes == 0) {
+					continue;
+				}
+
+				uint32_t chunkStart = chunk * ChunkSize;
+				for (uint32_t index = mChunkFirstEntry[chunk]; index < mEntries.size(); ++index) {
+					const Entry &entry = mEntries[index];
+					if (entry.snapshotOffset >= chunkStart + ChunkSize) {
+						break;
+					}
+					if (entry.source == nullptr || index == lastDirty) {
+						continue;
+					}
+
+					uint32_t begin = std::max(entry.snapshotOffset, chunkStart) - chunkStart;
+					uint32_t end = std::min(entry.snapshotOffset + entry.size, chunkStart + ChunkSize) - chunkStart;
+					uint32_t entryBytes = ((1u << (end - begin)) - 1) << begin;
+					if (changedBytes & entryBytes) {
+						mDirty.push_back(index);
+						lastDirty = index;
+					}
+				}
+			}
+
+			return (uint32_t)mDirty.size();
+		}
+
+		//Repacks live entries so the snapshot stays dense after many unwatches
+		void compact() {
+			std::vector<Entry> entries;
+			std::vector<Watch> watches;
+			std::vector<uint8_t> previous;
+			entries.reserve(watchedCount());
+			watches.reserve(watchedCount());
+
+			uint32_t size = 0;
+			std::vector<uint32_t> chunkFirstEntry;
+			for (size_t i = 0; i < mEntries.size(); ++i) {
+				Entry entry = mEntries[i];
+				if (entry.source == nullptr) {
+					continue;
+				}
+
+				uint32_t oldOffset = entry.snapshotOffset;
+				entry.snapshotOffset = place(size, entry.size);
+				size = entry.snapshotOffset + entry.size;
+
+				size_t chunks = (size + ChunkSize - 1) / ChunkSize;
+				previous.resize(chunks * ChunkSize);
+				std::memcpy(previous.data() + entry.snapshotOffset, mPrevious.data() + oldOffset, entry.size);
+				while (chunkFirstEntry.size() < chunks) {
+					chunkFirstEntry.push_back((uint32_t)entries.size());
+				}
+
+				mIdToEntry[mWatches[i].id] = (uint32_t)entries.size();
+				entries.push_back(entry);
+				watches.push_back(std::move(mWatches[i]));
+			}
+
+			mEntries = std::move(entries);
+			mWatches = std::move(watches);
+			mChunkFirstEntry = std::move(chunkFirstEntry);
+			mSnapshotSize = size;
+			mDeadEntries = 0;
+
+			mPrevious = std::move(previous);
+			mCurrent.assign(mPrevious.size(), 0);
+		}
+
+		std::vector<Entry> mEntries;
+		std::vector<Watch> mWatches;
+		std::vector<uint32_t> mIdToEntry;
+		std::vector<uint32_t> mFreeIds;
+		std::vector<uint32_t> mChunkFirstEntry;
+		std::vector<uint32_t> mDirty;
+		std::vector<uint8_t> mPrevious;
+		std::vector<uint8_t> mCurrent;
+		uint32_t mSnapshotSize = 0;
+		size_t mDeadEntries = 0;
+
+		il2cpp_binding *mBinding = nullptr;
+		HookHandle mUpdateHook;
+	};
+}
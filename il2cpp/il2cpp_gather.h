@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <xmmintrin.h>
+
+#include "il2cpp_types.h"
+#include "il2cpp_context.h"
+
+//Bulk reads of a single field across an array of managed objects.
+//Reading `obj.field<T>("name").get()` in a loop goes through il2cpp_field_get_value and
+//chases a pointer into a different heap object every element. The gather instead reads
+//the field straight from a resolved offset and prefetches objects a few elements ahead.
+namespace il2cppapi {
+	struct GatherOptions {
+		//How many elements ahead to prefetch. Objects are scattered, so this needs to cover a cache miss
+		uint32_t prefetchDistance = 8;
+
+		//Arrays with fewer elements than this are always gathered on the calling thread
+		uint32_t parallelThreshold = 1 << 16;
+
+		//0 = use std::thread::hardware_concurrency()
+		uint32_t maxThreads = 1;
+	};
+
+	namespace detail {
+		inline void *arrayElementObject(const Array<internal::Il2CppObject> &arr, uint32_t idx) {
+			return reinterpret_cast<void **>(reinterpret_cast<uint8_t *>(arr.arrayStart) + 0x20)[idx];
+		}
+
+		template<typename T>
+		void gatherRange(const Array<internal::Il2CppObject> &arr, uint32_t begin, uint32_t end, size_t fieldOffset, uint32_t prefetchDistance, T *out) {
+			for (uint32_t i = begin; i < end; ++i) {
+				if (i + prefetchDistance < end) {
+					void *ahead = arrayElementObject(arr, i + prefetchDistance);
+					if (ahead) {
+						_mm_prefetch(reinterpret_cast<const char *>(ahead) + fieldOffset, _MM_HINT_T0);
+					}
+				}
+
+				void *obj = arrayElementObject(arr, i);
+				if (obj) {
+					std::memcpy(&out[i], reinterpret_cast<const uint8_t *>(obj) + fieldOffset, sizeof(T));
+				}
+				else {
+					out[i] = T{};
+				}
+			}
+		}
+	}
+
+	//Reads the field at `fieldOffset` from the first `count` objects of `arr` into `out`.
+	//Null elements produce a value-initialized T. `out` must hold at least `count` elements.
+	//Offset 0 is the object header and is what a failed field lookup resolves to, so it's rejected and nothing is written
+	template<typename T>
+	bool gatherField(const Array<internal::Il2CppObject> &arr, uint32_t count, size_t fieldOffset, T *out, const GatherOptions &options = {}) {
+		static_assert(std::is_trivially_copyable_v<T>, "gatherField can only read trivially copyable field types");
+
+		if (fieldOffset == 0) {
+			printf("ERROR: gatherField: Invalid field offset, the field could not be resolved!\n");
+			return false;
+		}
+
+		if (count == 0) {
+			return true;
+		}
+
+		uint32_t threads = options.maxThreads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : options.maxThreads;
+		if (count < options.parallelThreshold || threads <= 1) {
+			detail::gatherRange(arr, 0, count, fieldOffset, options.prefetchDistance, out);
+			return true;
+		}
+
+		threads = std::max(1u, std::min(threads, count / std::max(1u, options.parallelThreshold / 2)));
+		uint32_t chunk = (count + threads - 1) / threads;
+
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		for (uint32_t t = 1; t < threads; ++t) {
+			uint32_t begin = t * chunk;
+			uint32_t end = std::min(count, begin + chunk);
+			if (begin >= end) break;
+
+			workers.emplace_back([&arr, begin, end, fieldOffset, &options, out]() {
+				detail::gatherRange(arr, begin, end, fieldOffset, options.prefetchDistance, out);
+			});
+		}
+
+		detail::gatherRange(arr, 0, std::min(count, chunk), fieldOffset, options.prefetchDistance, out);
+		for (auto &worker : workers) {
+			worker.join();
+		}
+		return true;
+	}
+
+	//`out` is left empty if the gather fails
+	template<typename T>
+	bool gatherField(const il2cpp_context &ctx, const Array<internal::Il2CppObject> &arr, size_t fieldOffset, std::vector<T> &out, const GatherOptions &options = {}) {
+		out.clear();
+		if (fieldOffset == 0) {
+			printf("ERROR: gatherField: Invalid field offset, the field could not be resolved!\n");
+			return false;
+		}
+
+		uint32_t count = ctx.getArrayLength(internal::Il2CppObject{ arr.arrayStart });
+		out.resize(count);
+		return gatherField(arr, count, fieldOffset, out.data(), options);
+	}
+
+	template<typename T>
+	std::vector<T> gatherField(const il2cpp_context &ctx, const Array<internal::Il2CppObject> &arr, const Class &klass, const char *fieldName, const GatherOptions &options = {}) {
+		std::vector<T> out;
+		gatherField(ctx, arr, klass.fieldOffset(fieldName), out, options);
+		return out;
+	}
+}
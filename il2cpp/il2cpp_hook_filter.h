@@ -0,0 +1,289 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+//Declarative call filter for a hook, set through HookOptions::filter. Every clause must hold for the hook to run:
+//
+//	HookOptions options;
+//	options.filter = HookFilter().thisIs(target).argEquals(0, 3).argInRange(1, 0.5f, 1.0f);
+//	binding.bindClassFunction("", "Target", "OnHit", InvokeTime::Before, 0, options, onTargetHit);
+//
+//Clauses compare the raw bytes of the native arguments, argument indices don't count `this`. A clause's value must
+//have the same size and kind (integer, float or double) as the argument it tests, and a range the same signedness,
+//which is checked when the hook is bound: write `argEquals(0, 3.0f)` for a float argument, not `argEquals(0, 3)`.
+//Filters are checked in the invoker before the call's storage is built. When no node in the method's chain accepts
+//a call, the original runs directly and the chain is never entered; a node that rejects a call is skipped otherwise.
+class HookFilter {
+public:
+	static const uint32_t MaxClauses = 4;
+
+	enum class Op : uint8_t {
+		ThisEquals,
+		Equals,
+		NotEquals,
+		InRange,
+		MaskEquals,
+		MaskAny,
+	};
+
+	enum class Kind : uint8_t {
+		Unsigned,
+		Signed,
+		Float,
+		Double,
+	};
+
+	struct Clause {
+		Op op;
+		Kind kind;
+		uint8_t arg;
+		uint8_t size;
+
+		//Operands as raw bits: the value, the range's lower bound or the mask
+		uint64_t a;
+		//The range's upper bound or the masked value
+		uint64_t b;
+	};
+
+	//Only calls on this instance
+	HookFilter &thisIs(const void *instance) {
+		Clause *clause = add();
+		if (clause != nullptr) {
+			clause->op = Op::ThisEquals;
+			clause->size = sizeof(void *);
+			clause->a = (uint64_t)(uintptr_t)instance;
+		}
+		return *this;
+	}
+
+	template<typename T>
+	HookFilter &argEquals(uint8_t index, T value) {
+		return addValue(Op::Equals, index, value, value);
+	}
+
+	template<typename T>
+	HookFilter &argNotEquals(uint8_t index, T value) {
+		return addValue(Op::NotEquals, index, value, value);
+	}
+
+	//Inclusive on both ends
+	template<typename T>
+	HookFilter &argInRange(uint8_t index, T min, T max) {
+		static_assert(!std::is_pointer_v<T>, "Pointer arguments can only be compared for equality");
+		return addValue(Op::InRange, index, min, max);
+	}
+
+	//(arg & mask) == value
+	template<typename T>
+	HookFilter &argMaskEquals(uint8_t index, T mask, T value) {
+		static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "Masks only apply to integer and enum arguments");
+		return addValue(Op::MaskEquals, index, mask, value);
+	}
+
+	//(arg & mask) != 0
+	template<typename T>
+	HookFilter &argMaskAny(uint8_t index, T mask) {
+		static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "Masks only apply to integer and enum arguments");
+		return addValue(Op::MaskAny, index, mask, mask);
+	}
+
+	bool isActive() const {
+		return mNumClauses > 0 || mOverflowed;
+	}
+
+	//`args` points at each native argument, in order
+	bool matches(const void *ths, const void *const *args) const {
+		for (uint32_t i = 0; i < mNumClauses; ++i) {
+			if (!test(mClauses[i], ths, args)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//Checks the clauses against the bound method's signature
+	template<bool isThisCall, typename... Args>
+	bool validate(const char *className, const char *methodName) const {
+		if (mOverflowed) {
+			printf("ERROR: Filter for %s::%s has more than %u clauses!\n", className, methodName, MaxClauses);
+			return false;
+		}
+
+		const size_t argSizes[] = { sizeof(Args)..., 0 };
+		const Kind argKinds[] = { kindOf<Args>()..., Kind::Unsigned };
+		for (uint32_t i = 0; i < mNumClauses; ++i) {
+			const Clause &clause = mClauses[i];
+			if (clause.op == Op::ThisEquals) {
+				if (!isThisCall) {
+					printf("ERROR: Filter for %s::%s tests `this`, but the method is static!\n", className, methodName);
+					return false;
+				}
+				continue;
+			}
+
+			if (clause.arg >= sizeof...(Args)) {
+				printf("ERROR: Filter for %s::%s tests argument %u, but the method only has %u!\n", className, methodName, (uint32_t)clause.arg, (uint32_t)sizeof...(Args));
+				return false;
+			}
+			if (clause.size != argSizes[clause.arg]) {
+				printf("ERROR: Filter for %s::%s tests argument %u as %u bytes, but it is %u bytes!\n", className, methodName, (uint32_t)clause.arg, (uint32_t)clause.size, (uint32_t)argSizes[clause.arg]);
+				return false;
+			}
+
+			//A float compared as an int32 (or the other way around) has the right size but never means what was written
+			Kind argKind = argKinds[clause.arg];
+			bool integral = !isFloatingPoint(clause.kind) && !isFloatingPoint(argKind);
+			if (integral ? (clause.op == Op::InRange && clause.kind != argKind) : clause.kind != argKind) {
+				printf("ERROR: Filter for %s::%s tests argument %u as %s, but it is %s!\n", className, methodName, (uint32_t)clause.arg,
+					kindName(clause.kind, clause.op == Op::InRange), kindName(argKind, clause.op == Op::InRange));
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	Clause *add() {
+		if (mNumClauses == MaxClauses) {
+			mOverflowed = true;
+			return nullptr;
+		}
+
+		Clause *clause = &mClauses[mNumClauses++];
+		*clause = Clause{};
+		return clause;
+	}
+
+	template<typename T>
+	static constexpr Kind kindOf() {
+		if constexpr (std::is_same_v<T, float>) {
+			return Kind::Float;
+		}
+		else if constexpr (std::is_same_v<T, double>) {
+			return Kind::Double;
+		}
+		else if constexpr (std::is_enum_v<T>) {
+			return std::is_signed_v<std::underlying_type_t<T>> ? Kind::Signed : Kind::Unsigned;
+		}
+		else if constexpr (std::is_integral_v<T>) {
+			return std::is_signed_v<T> ? Kind::Signed : Kind::Unsigned;
+		}
+		else {
+			return Kind::Unsigned;
+		}
+	}
+
+	static bool isFloatingPoint(Kind kind) {
+		return kind == Kind::Float || kind == Kind::Double;
+	}
+
+	//Signedness only changes what a range means, other clauses compare integers bit for bit
+	static const char *kindName(Kind kind, bool withSign) {
+		switch (kind) {
+		case Kind::Float: return "float";
+		case Kind::Double: return "double";
+		case Kind::Signed: return withSign ? "a signed integer" : "an integer";
+		default: return withSign ? "an unsigned integer" : "an integer";
+		}
+	}
+
+	template<typename T>
+	static uint64_t bitsOf(T value) {
+		uint64_t bits = 0;
+		std::memcpy(&bits, &value, sizeof(T));
+		return bits;
+	}
+
+	template<typename T>
+	HookFilter &addValue(Op op, uint8_t index, T a, T b) {
+		static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(uint64_t), "Filters only compare arguments of up to 8 bytes");
+		static_assert(!std::is_floating_point_v<T> || std::is_same_v<T, float> || std::is_same_v<T, double>, "Unsupported floating point type");
+
+		Clause *clause = add();
+		if (clause != nullptr) {
+			clause->op = op;
+			clause->kind = kindOf<T>();
+			clause->arg = index;
+			clause->size = (uint8_t)sizeof(T);
+			clause->a = bitsOf(a);
+			clause->b = bitsOf(b);
+		}
+		return *this;
+	}
+
+	static int64_t signExtend(uint64_t bits, uint32_t size) {
+		uint32_t shift = 64 - size * 8;
+		return (int64_t)(bits << shift) >> shift;
+	}
+
+	static bool inRange(Kind kind, uint32_t size, uint64_t value, uint64_t min, uint64_t max) {
+		switch (kind) {
+		case Kind::Signed: {
+			int64_t v = signExtend(value, size);
+			return v >= signExtend(min, size) && v <= signExtend(max, size);
+		}
+		case Kind::Float: {
+			float v, lo, hi;
+			std::memcpy(&v, &value, sizeof(float));
+			std::memcpy(&lo, &min, sizeof(float));
+			std::memcpy(&hi, &max, sizeof(float));
+			return v >= lo && v <= hi;
+		}
+		case Kind::Double: {
+			double v, lo, hi;
+			std::memcpy(&v, &value, sizeof(double));
+			std::memcpy(&lo, &min, sizeof(double));
+			std::memcpy(&hi, &max, sizeof(double));
+			return v >= lo && v <= hi;
+		}
+		default:
+			return value >= min && value <= max;
+		}
+	}
+
+	//Floats compare by value, so 0.0 matches -0.0 and NaN never matches
+	static bool equal(Kind kind, uint64_t value, uint64_t expected) {
+		if (kind == Kind::Float) {
+			float v, e;
+			std::memcpy(&v, &value, sizeof(float));
+			std::memcpy(&e, &expected, sizeof(float));
+			return v == e;
+		}
+		if (kind == Kind::Double) {
+			double v, e;
+			std::memcpy(&v, &value, sizeof(double));
+			std::memcpy(&e, &expected, sizeof(double));
+			return v == e;
+		}
+		return value == expected;
+	}
+
+	static bool test(const Clause &clause, const void *ths, const void *const *args) {
+		if (clause.op == Op::ThisEquals) {
+			return (uint64_t)(uintptr_t)ths == clause.a;
+		}
+
+		uint64_t value = 0;
+		switch (clause.size) {
+		case 1: value = *static_cast<const uint8_t *>(args[clause.arg]); break;
+		case 2: std::memcpy(&value, args[clause.arg], 2); break;
+		case 4: std::memcpy(&value, args[clause.arg], 4); break;
+		default: std::memcpy(&value, args[clause.arg], clause.size); break;
+		}
+
+		switch (clause.op) {
+		case Op::Equals: return equal(clause.kind, value, clause.a);
+		case Op::NotEquals: return !equal(clause.kind, value, clause.a);
+		case Op::InRange: return inRange(clause.kind, clause.size, value, clause.a, clause.b);
+		case Op::MaskEquals: return (value & clause.a) == clause.b;
+		case Op::MaskAny: return (value & clause.a) != 0;
+		default: return true;
+		}
+	}
+
+	uint32_t mNumClauses = 0;
+	bool mOverflowed = false;
+	Clause mClauses[MaxClauses];
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "il2cpp_hook_filter.h"
+
+//Frame counter used by per-frame hook limits and anything else that needs a frame boundary.
+//Mods advance it from whatever per-frame method they hook (e.g. an Update), once per frame.
+struct HookFrame {
+	static std::atomic<uint64_t> &counter() {
+		static std::atomic<uint64_t> frame{ 0 };
+		return frame;
+	}
+
+	static uint64_t current() {
+		return counter().load(std::memory_order_relaxed);
+	}
+
+	static void advance() {
+		counter().fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+//Limits on how often a hook body runs. All limits are optional and are combined, a call must pass every one
+struct HookSampling {
+	//Run the hook on every Nth call only (deterministic, the first call always runs). 0 or 1 = every call
+	uint32_t everyNth = 1;
+
+	//Token bucket limit, in hook runs per second. 0 = unlimited
+	double maxPerSecond = 0.0;
+
+	//How many runs can be bursted at once when maxPerSecond is set
+	uint32_t burst = 1;
+
+	//Maximum runs per HookFrame. 0 = unlimited
+	uint32_t maxPerFrame = 0;
+
+	bool isActive() const {
+		return everyNth > 1 || maxPerSecond > 0.0 || maxPerFrame > 0;
+	}
+};
+
+//Options for bindClassFunction/bindStaticFunction that go beyond invoke time and priority
+struct HookOptions {
+	HookSampling sampling;
+
+	//The static method's result only depends on its arguments, so the original's return value is memoized in
+	//PureCallCache. Hooks still run on every call, and calls the prechecks send straight to the original skip the cache.
+	//Ignored for member methods, and unless the return value and every argument are plain values (see
+	//PureCallCache::canCache). Purity belongs to the method, so binding a hook that disagrees with the method's existing
+	//hooks fails; invalidate its results with PureCallCache::global().invalidate(handle)
+	bool pure = false;
+
+	//Only run the hook for calls matching this filter, see HookFilter
+	HookFilter filter;
+};
+
+//Runtime state for HookSampling, lives alongside each hook node.
+//Lock free so it can be evaluated on every call from any thread
+class HookGate {
+public:
+	HookGate() = default;
+	explicit HookGate(const HookSampling &sampling) {
+		configure(sampling);
+	}
+
+	void configure(const HookSampling &sampling) {
+		mActive = sampling.isActive();
+		mEveryNth = sampling.everyNth > 1 ? sampling.everyNth : 1;
+		mMaxPerFrame = sampling.maxPerFrame;
+
+		if (sampling.maxPerSecond > 0.0) {
+			mIntervalNs = (int64_t)(1e9 / sampling.maxPerSecond);
+			mBurstToleranceNs = mIntervalNs * (int64_t)(sampling.burst > 1 ? sampling.burst - 1 : 0);
+		}
+		else {
+			mIntervalNs = 0;
+		}
+	}
+
+	//Nanoseconds on the clock maxPerSecond is measured against
+	using ClockFn = int64_t(*)();
+
+	static int64_t steadyNowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//Returns true if the hook should run for this call. `nowNs` is only read when maxPerSecond is set, tests pass
+	//their own clock to step through time
+	bool allow(ClockFn nowNs = &steadyNowNs) {
+		if (!mActive) {
+			return true;
+		}
+
+		if (mEveryNth > 1 && (mCallCount.fetch_add(1, std::memory_order_relaxed) % mEveryNth) != 0) {
+			return false;
+		}
+
+		if (mMaxPerFrame > 0 && !allowFrame()) {
+			return false;
+		}
+
+		if (mIntervalNs > 0 && !allowRate(nowNs())) {
+			return false;
+		}
+
+		return true;
+	}
+
+private:
+	bool allowFrame() {
+		//High 32 bits hold the frame the count belongs to, low 32 bits the count
+		uint64_t frame = HookFrame::current() & 0xFFFFFFFF;
+		uint64_t state = mFrameState.load(std::memory_order_relaxed);
+		for (;;) {
+			uint64_t newState;
+			if ((state >> 32) != frame) {
+				newState = (frame << 32) | 1;
+			}
+			else if ((state & 0xFFFFFFFF) >= mMaxPerFrame) {
+				return false;
+			}
+			else {
+				newState = state + 1;
+			}
+
+			if (mFrameState.compare_exchange_weak(state, newState, std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+	}
+
+	//Token bucket expressed as GCRA, so the whole bucket is a single atomic timestamp
+	bool allowRate(int64_t now) {
+		int64_t tat = mTheoreticalArrival.load(std::memory_order_relaxed);
+		for (;;) {
+			int64_t start = tat > now ? tat : now;
+			if (start - now > mBurstToleranceNs) {
+				return false;
+			}
+
+			if (mTheoreticalArrival.compare_exchange_weak(tat, start + mIntervalNs, std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+	}
+
+	bool mActive = false;
+	uint32_t mEveryNth = 1;
+	uint32_t mMaxPerFrame = 0;
+	int64_t mIntervalNs = 0;
+	int64_t mBurstToleranceNs = 0;
+
+	std::atomic<uint64_t> mCallCount{ 0 };
+	std::atomic<uint64_t> mFrameState{ 0 };
+	std::atomic<int64_t> mTheoreticalArrival{ 0 };
+};
@@ -0,0 +1,371 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//Handle to a bound hook, returned from bindClassFunction/bindStaticFunction and passed to unbind.
+//The generation makes handles to unbound (and possibly reused) slots fail instead of touching another hook
+struct HookHandle {
+	uint32_t index = 0;
+	uint32_t generation = 0;
+
+	bool isValid() const {
+		return generation != 0;
+	}
+};
+
+//Fails to compile when a node outgrows its pool slot. The sizes are template arguments so the compiler prints them,
+//e.g. NodeSizeCheck<272, 256>
+template<size_t ActualSize, size_t MaxSize>
+struct NodeSizeCheck {
+	static_assert(ActualSize <= MaxSize, "Hook node does not fit in a pool slot, increase HookNodePool::MaxNodeSize. See NodeSizeCheck<ActualSize, MaxSize> for the sizes");
+	static constexpr bool value = ActualSize <= MaxSize;
+};
+
+//Slab allocator for hook nodes. Slots have a fixed size and are recycled through a free list,
+//so binding and unbinding hooks over and over (e.g. hot reloading a mod) keeps memory flat
+class HookNodePool {
+public:
+	//A node holds a std::function (64 bytes on MSVC), its HookGate and HookFilter next to the MethodHookNode, which is
+	//already ~256 bytes, so this leaves room for the node to grow
+	static const size_t MaxNodeSize = 384;
+	static const uint32_t SlabSize = 256;
+
+	static HookNodePool &global() {
+		static HookNodePool pool;
+		return pool;
+	}
+
+	//Constructs a T in a free slot. T must be standard layout, so a pointer to it or to its first member is the slot's
+	//data and handleOf can find the slot again
+	template<typename T>
+	T *allocate(HookHandle &handle) {
+		static_assert(std::is_standard_layout_v<T>, "Hook node must be standard layout for handleOf");
+		static_assert(NodeSizeCheck<sizeof(T), MaxNodeSize>::value, "Hook node does not fit in a pool slot");
+		static_assert(alignof(T) <= alignof(std::max_align_t), "Hook node is over-aligned for a pool slot");
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		Slot &slot = acquireSlot();
+		T *value = new (slot.data) T();
+		slot.destroy = [](void *data) { static_cast<T *>(data)->~T(); };
+		slot.live = true;
+		++mLiveCount;
+
+		handle.index = slot.index;
+		handle.generation = slot.generation;
+		return value;
+	}
+
+	//Handle for a pointer previously returned by allocate, or to the first member of what it returned
+	HookHandle handleOf(const void *value) const {
+		const Slot *slot = reinterpret_cast<const Slot *>(reinterpret_cast<const uint8_t *>(value) - offsetof(Slot, data));
+		return HookHandle{ slot->index, slot->generation };
+	}
+
+	//Invalidates the handle and returns the slot's memory, which stays allocated until release.
+	//Returns nullptr if the handle is stale
+	void *retire(HookHandle handle) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		Slot *slot = findSlot(handle);
+		if (slot == nullptr) {
+			return nullptr;
+		}
+
+		slot->live = false;
+		slot->generation = nextGeneration(slot->generation);
+		return slot->data;
+	}
+
+	//Destroys a retired slot's contents and puts it back on the free list
+	void release(uint32_t index) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		Slot &slot = slotAt(index);
+		if (slot.destroy) {
+			slot.destroy(slot.data);
+			slot.destroy = nullptr;
+		}
+		slot.nextFree = mFreeHead;
+		mFreeHead = index;
+		--mLiveCount;
+	}
+
+	size_t liveCount() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mLiveCount;
+	}
+
+	size_t capacity() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mSlabs.size() * SlabSize;
+	}
+
+private:
+	static const uint32_t NoSlot = 0xFFFFFFFF;
+
+	struct Slot {
+		alignas(std::max_align_t) uint8_t data[MaxNodeSize];
+		void(*destroy)(void *data) = nullptr;
+		uint32_t index = 0;
+		uint32_t generation = 1;
+		uint32_t nextFree = NoSlot;
+		bool live = false;
+	};
+
+	static uint32_t nextGeneration(uint32_t generation) {
+		//0 is reserved for invalid handles
+		return generation + 1 == 0 ? 1 : generation + 1;
+	}
+
+	Slot &slotAt(uint32_t index) {
+		return mSlabs[index / SlabSize][index % SlabSize];
+	}
+
+	Slot *findSlot(HookHandle handle) {
+		if (!handle.isValid() || handle.index >= mSlabs.size() * SlabSize) {
+			return nullptr;
+		}
+
+		Slot &slot = slotAt(handle.index);
+		return (slot.live && slot.generation == handle.generation) ? &slot : nullptr;
+	}
+
+	Slot &acquireSlot() {
+		if (mFreeHead == NoSlot) {
+			uint32_t base = (uint32_t)(mSlabs.size() * SlabSize);
+			mSlabs.emplace_back(new Slot[SlabSize]);
+			auto &slab = mSlabs.back();
+			for (uint32_t i = 0; i < SlabSize; ++i) {
+				slab[i].index = base + i;
+				slab[i].nextFree = (i + 1 < SlabSize) ? base + i + 1 : NoSlot;
+			}
+			mFreeHead = base;
+		}
+
+		Slot &slot = slotAt(mFreeHead);
+		mFreeHead = slot.nextFree;
+		slot.nextFree = NoSlot;
+		return slot;
+	}
+
+	mutable std::mutex mMutex;
+	std::vector<std::unique_ptr<Slot[]>> mSlabs;
+	uint32_t mFreeHead = NoSlot;
+	size_t mLiveCount = 0;
+};
+
+//Process wide dispatch epoch, shared by every mod through il2cpp_binding::getSharedData since a chain
+//can hold nodes from several mods and be dispatched through any of their invokers. Zero initialized is valid
+struct HookEpochState {
+	std::atomic<uint64_t> epoch;
+	std::atomic<uint64_t> activeDispatches[2];
+};
+
+//Retired memory whose release function belongs to the loader rather than a mod, e.g. HookChainJit stubs. Shared like
+//HookEpochState so it is freed by whichever mod dispatches next. Mod memory must not go here, the mod may be unloaded
+//before another mod collects it
+struct HookSharedRetireList {
+	static const uint32_t Capacity = 256;
+
+	struct Entry {
+		uint64_t epoch;
+		void(*release)(void *data);
+		void *data;
+	};
+
+	std::atomic<uint32_t> lock;
+	std::atomic<uint32_t> count;
+	Entry entries[Capacity];
+};
+
+//Deferred reclamation for unbound hook nodes. Every chain dispatch registers in the current epoch;
+//a node removed from its chain is only released once every dispatch that could have seen it has finished
+class HookReclaimer {
+public:
+	static HookReclaimer &global() {
+		static HookReclaimer reclaimer;
+		return reclaimer;
+	}
+
+	static HookEpochState *&sharedState() {
+		static HookEpochState *state = nullptr;
+		return state;
+	}
+
+	static HookSharedRetireList *&sharedRetired() {
+		static HookSharedRetireList *list = nullptr;
+		return list;
+	}
+
+	class DispatchGuard {
+	public:
+		DispatchGuard() : mState(sharedState()) {
+			if (mState == nullptr) {
+				return;
+			}
+
+			//Re-check the epoch after registering, a collector may have advanced it in between
+			for (;;) {
+				mEpoch = mState->epoch.load();
+				mState->activeDispatches[mEpoch & 1].fetch_add(1);
+				if (mState->epoch.load() == mEpoch) {
+					break;
+				}
+				mState->activeDispatches[mEpoch & 1].fetch_sub(1);
+			}
+		}
+
+		~DispatchGuard() {
+			if (mState == nullptr) {
+				return;
+			}
+
+			mState->activeDispatches[mEpoch & 1].fetch_sub(1);
+			if (global().mHasRetired.load(std::memory_order_relaxed)) {
+				global().collect(false);
+			}
+
+			HookSharedRetireList *shared = sharedRetired();
+			if (shared != nullptr && shared->count.load(std::memory_order_relaxed) != 0) {
+				collectShared();
+			}
+		}
+
+		DispatchGuard(const DispatchGuard &) = delete;
+		DispatchGuard &operator=(const DispatchGuard &) = delete;
+
+	private:
+		HookEpochState *mState;
+		uint64_t mEpoch = 0;
+	};
+
+	//Queues a pool slot that has already been removed from its chain
+	void retire(uint32_t index) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		HookEpochState *state = sharedState();
+		mRetired.push_back({ state ? state->epoch.load() : 0, index, nullptr, nullptr });
+		mHasRetired.store(true, std::memory_order_relaxed);
+	}
+
+	//Queues any other memory a dispatch may still be running through, e.g. a replaced compiled chain
+	void retire(void(*release)(void *data), void *data) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		HookEpochState *state = sharedState();
+		mRetired.push_back({ state ? state->epoch.load() : 0, 0, release, data });
+		mHasRetired.store(true, std::memory_order_relaxed);
+	}
+
+	//Queues loader owned memory on the shared list, see HookSharedRetireList. Falls back to this module's own list
+	//when the shared one isn't attached or is full
+	void retireShared(void(*release)(void *data), void *data) {
+		HookSharedRetireList *shared = sharedRetired();
+		HookEpochState *state = sharedState();
+		if (shared != nullptr && state != nullptr) {
+			lockShared(shared);
+			uint32_t count = shared->count.load(std::memory_order_relaxed);
+			if (count < HookSharedRetireList::Capacity) {
+				shared->entries[count] = { state->epoch.load(), release, data };
+				shared->count.store(count + 1, std::memory_order_relaxed);
+				shared->lock.store(0, std::memory_order_release);
+				return;
+			}
+			shared->lock.store(0, std::memory_order_release);
+		}
+		retire(release, data);
+	}
+
+	//Releases whatever on the shared list no dispatch can still be using. Never blocks
+	static void collectShared() {
+		HookSharedRetireList *shared = sharedRetired();
+		HookEpochState *state = sharedState();
+		if (shared == nullptr || state == nullptr || shared->lock.exchange(1, std::memory_order_acquire) != 0) {
+			return;
+		}
+
+		uint64_t epoch = advanceEpoch(state);
+		uint32_t count = shared->count.load(std::memory_order_relaxed);
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			HookSharedRetireList::Entry &entry = shared->entries[i];
+			if (entry.epoch + 2 <= epoch) {
+				entry.release(entry.data);
+			}
+			else {
+				shared->entries[kept++] = entry;
+			}
+		}
+		shared->count.store(kept, std::memory_order_relaxed);
+		shared->lock.store(0, std::memory_order_release);
+	}
+
+	//Releases every retired slot that no dispatch can still be using.
+	//Advances the epoch once the previous epoch's dispatches have all finished; slots retired two or more
+	//epochs ago are then safe. Never blocks when `wait` is false
+	void collect(bool wait = true) {
+		std::unique_lock<std::mutex> lock(mMutex, std::defer_lock);
+		if (wait) {
+			lock.lock();
+		}
+		else if (!lock.try_lock()) {
+			return;
+		}
+
+		HookEpochState *state = sharedState();
+		uint64_t epoch = state != nullptr ? advanceEpoch(state) : 0;
+
+		size_t kept = 0;
+		for (auto &retired : mRetired) {
+			if (state == nullptr || retired.epoch + 2 <= epoch) {
+				if (retired.release != nullptr) {
+					retired.release(retired.data);
+				}
+				else {
+					HookNodePool::global().release(retired.index);
+				}
+			}
+			else {
+				mRetired[kept++] = retired;
+			}
+		}
+		mRetired.resize(kept);
+		mHasRetired.store(kept != 0, std::memory_order_relaxed);
+	}
+
+	size_t pendingCount() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mRetired.size();
+	}
+
+private:
+	//Moves to the next epoch if the previous epoch's dispatches have all finished, returns the current epoch
+	static uint64_t advanceEpoch(HookEpochState *state) {
+		uint64_t epoch = state->epoch.load();
+		if (state->activeDispatches[(epoch + 1) & 1].load() == 0) {
+			state->epoch.compare_exchange_strong(epoch, epoch + 1);
+			epoch = state->epoch.load();
+		}
+		return epoch;
+	}
+
+	static void lockShared(HookSharedRetireList *shared) {
+		while (shared->lock.exchange(1, std::memory_order_acquire) != 0) {
+			std::this_thread::yield();
+		}
+	}
+
+	struct Retired {
+		uint64_t epoch;
+		uint32_t index;
+		void(*release)(void *data);
+		void *data;
+	};
+
+	mutable std::mutex mMutex;
+	std::vector<Retired> mRetired;
+	std::atomic<bool> mHasRetired{ false };
+};
@@ -0,0 +1,336 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "il2cpp_binding.h"
+
+//Loader side scheduler for ModDeclaration::initialize.
+//Builds the dependency graph from every declaration and runs mods whose dependencies are done in parallel on
+//a thread pool attached to the il2cpp runtime. Class lookups and hook setup inside each mod run concurrently; the
+//loader entries mods call while initializing (GetIL2CPPContext, AddHookCall, RemoveHookCall, GetSharedData) are
+//serialized for the duration of run(), since the loader was written for one caller at a time. The per-call entries,
+//InvokeFunctionChain and GetActiveHookCall, are left as they are so hooked calls never wait on a mod.
+//
+//A mod whose dependency is missing, failed (threw from initialize), or part of a cycle is skipped, along with
+//everything depending on it. Declarations older than binding 2.5 have no dependencies or initialize and are only
+//checked for duplicates.
+class ModInitScheduler {
+public:
+	struct Result {
+		uint32_t initialized = 0;
+		uint32_t skipped = 0;
+		std::chrono::microseconds elapsed{ 0 };
+		std::vector<std::string> errors;
+	};
+
+	void addMod(const ModDeclaration &declaration) {
+		mMods.push_back(&declaration);
+	}
+
+	//Initializes every added mod. `threads` = 0 uses std::thread::hardware_concurrency()
+	Result run(il2cpp_binding &binding, uint32_t threads = 0) {
+		auto start = std::chrono::steady_clock::now();
+		Result result;
+
+		mErrors.clear();
+		mReady.clear();
+		mInFlight = 0;
+		buildGraph(result);
+
+		threads = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+		threads = std::max(1u, std::min<uint32_t>(threads, (uint32_t)mMods.size()));
+
+		for (uint32_t i = 0; i < mMods.size(); ++i) {
+			if (mNodes[i].remaining == 0 && !mNodes[i].skipped) {
+				mReady.push_back(i);
+			}
+		}
+		mOutstanding = 0;
+		for (auto &node : mNodes) {
+			mOutstanding += node.skipped ? 0 : 1;
+		}
+
+		const il2cpp_context &context = binding.GetIL2CPPContext(binding);
+		serializeLoader(binding, true);
+		{
+			std::vector<std::thread> workers;
+			for (uint32_t t = 1; t < threads; ++t) {
+				workers.emplace_back([this, &binding, &context]() {
+					internal::Il2CppThread *thread = context.attachThread();
+					workerLoop(binding);
+					context.detachThread(thread);
+				});
+			}
+			workerLoop(binding);
+			for (auto &worker : workers) {
+				worker.join();
+			}
+		}
+		serializeLoader(binding, false);
+
+		//Anything still waiting was never released, which only happens with a cycle
+		for (uint32_t i = 0; i < mMods.size(); ++i) {
+			if (!mNodes[i].done && !mNodes[i].skipped) {
+				mNodes[i].skipped = true;
+				mErrors.push_back(std::string(mMods[i]->modName) + ": dependency cycle");
+			}
+		}
+
+		for (auto &node : mNodes) {
+			result.initialized += node.done ? 1 : 0;
+			result.skipped += node.skipped ? 1 : 0;
+		}
+		result.errors.insert(result.errors.end(), mErrors.begin(), mErrors.end());
+		result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		for (auto &error : result.errors) {
+			printf("ERROR: ModInitScheduler: %s\n", error.c_str());
+		}
+		return result;
+	}
+
+private:
+	struct Node {
+		uint32_t remaining = 0;
+		std::vector<uint32_t> dependents;
+		bool done = false;
+		bool skipped = false;
+	};
+
+	//dependencies and initialize were appended to ModDeclaration in binding 2.5, 3.0 left ModDeclaration as it was
+	static bool hasInitializer(const ModDeclaration &mod) {
+		semver version = mod.bindingVersion;
+		return !(version < semver{ 2, 5, 0 });
+	}
+
+	void buildGraph(Result &result) {
+		mNodes.assign(mMods.size(), Node());
+
+		std::unordered_map<std::string, uint32_t> byName;
+		for (uint32_t i = 0; i < mMods.size(); ++i) {
+			if (!byName.emplace(mMods[i]->modName, i).second) {
+				result.errors.push_back(std::string(mMods[i]->modName) + ": declared twice, skipping the duplicate");
+				mNodes[i].skipped = true;
+			}
+		}
+
+		for (uint32_t i = 0; i < mMods.size(); ++i) {
+			if (mNodes[i].skipped) {
+				continue;
+			}
+
+			const ModDeclaration &mod = *mMods[i];
+			if (!hasInitializer(mod)) {
+				continue;
+			}
+
+			for (uint32_t d = 0; d < mod.numDependencies; ++d) {
+				auto it = byName.find(mod.dependencies[d]);
+				if (it == byName.end()) {
+					result.errors.push_back(std::string(mod.modName) + ": missing dependency " + mod.dependencies[d]);
+					mNodes[i].skipped = true;
+					continue;
+				}
+
+				mNodes[it->second].dependents.push_back(i);
+				++mNodes[i].remaining;
+			}
+		}
+
+		std::vector<uint32_t> skipped;
+		for (uint32_t i = 0; i < mMods.size(); ++i) {
+			if (mNodes[i].skipped) {
+				skipped.push_back(i);
+			}
+		}
+		skipDependents(std::move(skipped), result.errors);
+	}
+
+	//Skipping propagates to every mod that depends on a skipped one. Returns how many mods were newly skipped
+	uint32_t skipDependents(std::vector<uint32_t> &&stack, std::vector<std::string> &errors) {
+		uint32_t count = 0;
+		while (!stack.empty()) {
+			uint32_t i = stack.back();
+			stack.pop_back();
+			for (uint32_t dependent : mNodes[i].dependents) {
+				if (!mNodes[dependent].skipped) {
+					mNodes[dependent].skipped = true;
+					errors.push_back(std::string(mMods[dependent]->modName) + ": dependency " + mMods[i]->modName + " was skipped");
+					stack.push_back(dependent);
+					++count;
+				}
+			}
+		}
+		return count;
+	}
+
+	//Runs a mod's initialize, turning anything it throws into an error instead of taking down the loader
+	bool initialize(uint32_t index, il2cpp_binding &binding, std::string &error) {
+		const ModDeclaration &mod = *mMods[index];
+		if (!hasInitializer(mod) || mod.initialize == nullptr) {
+			return true;
+		}
+
+		try {
+			mod.initialize(binding);
+			return true;
+		}
+		catch (const std::exception &e) {
+			error = std::string(mod.modName) + ": initialize threw: " + e.what();
+		}
+		catch (...) {
+			error = std::string(mod.modName) + ": initialize threw an unknown exception";
+		}
+		return false;
+	}
+
+	void workerLoop(il2cpp_binding &binding) {
+		for (;;) {
+			uint32_t index;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCv.wait(lock, [this]() { return !mReady.empty() || mOutstanding == 0 || mInFlight == 0; });
+				if (mReady.empty()) {
+					//Either everything is done, or nothing is running that could release more work (a cycle)
+					mCv.notify_all();
+					return;
+				}
+				index = mReady.front();
+				mReady.pop_front();
+				++mInFlight;
+			}
+
+			std::string error;
+			bool succeeded = initialize(index, binding, error);
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				--mOutstanding;
+				--mInFlight;
+				if (!succeeded) {
+					mNodes[index].skipped = true;
+					mErrors.push_back(error);
+					mOutstanding -= skipDependents({ index }, mErrors);
+					mCv.notify_all();
+					continue;
+				}
+
+				mNodes[index].done = true;
+				for (uint32_t dependent : mNodes[index].dependents) {
+					if (--mNodes[dependent].remaining == 0 && !mNodes[dependent].skipped) {
+						mReady.push_back(dependent);
+					}
+				}
+			}
+			mCv.notify_all();
+		}
+	}
+
+	//Recursive, the loader may call back into its own table from inside an entry
+	static std::recursive_mutex &loaderMutex() {
+		static std::recursive_mutex mutex;
+		return mutex;
+	}
+
+	struct LoaderFunctions {
+		decltype(il2cpp_binding::GetIL2CPPContext) getContext = nullptr;
+		decltype(il2cpp_binding::AddHookCall) addHookCall = nullptr;
+		decltype(il2cpp_binding::RemoveHookCall) removeHookCall = nullptr;
+		decltype(il2cpp_binding::GetSharedData) getSharedData = nullptr;
+	};
+
+	//The loader's own entries of every binding currently serialized. Schedulers running on the same binding at once,
+	//or one started from a mod's initialize, share the entry; the last one to finish restores the binding
+	struct SerializedBinding {
+		LoaderFunctions original;
+		uint32_t schedulers = 0;
+	};
+
+	//Only touched with loaderMutex held
+	static std::unordered_map<const il2cpp_binding *, SerializedBinding> &serializedBindings() {
+		static std::unordered_map<const il2cpp_binding *, SerializedBinding> bindings;
+		return bindings;
+	}
+
+	//The loader entries to forward to from a wrapper. Called with loaderMutex held; a caller that loaded the wrapper
+	//just before the binding was restored finds the loader's own entries back in the binding
+	static LoaderFunctions originalLoader(const il2cpp_binding &bnd) {
+		auto &bindings = serializedBindings();
+		auto it = bindings.find(&bnd);
+		if (it != bindings.end()) {
+			return it->second.original;
+		}
+		return LoaderFunctions{ bnd.GetIL2CPPContext, bnd.AddHookCall, bnd.RemoveHookCall, bnd.GetSharedData };
+	}
+
+	//Game threads read the table while it is swapped, so each entry is replaced with a single atomic store
+	template<typename Fn>
+	static void publishEntry(Fn &entry, Fn value) {
+		std::atomic_ref<Fn>(entry).store(value, std::memory_order_release);
+	}
+
+	//GetActiveHookCall is left alone: every hooked call on every game thread goes through it, and the loader
+	//answers it from the calling thread's own state
+	static void serializeLoader(il2cpp_binding &binding, bool enable) {
+		std::lock_guard<std::recursive_mutex> lock(loaderMutex());
+		auto &bindings = serializedBindings();
+		if (enable) {
+			SerializedBinding &serialized = bindings[&binding];
+			if (serialized.schedulers++ != 0) {
+				return;
+			}
+
+			serialized.original = LoaderFunctions{ binding.GetIL2CPPContext, binding.AddHookCall, binding.RemoveHookCall, binding.GetSharedData };
+
+			publishEntry(binding.GetIL2CPPContext, +[](const il2cpp_binding &bnd) -> const il2cpp_context & {
+				std::lock_guard<std::recursive_mutex> lock(loaderMutex());
+				return originalLoader(bnd).getContext(bnd);
+			});
+			publishEntry(binding.AddHookCall, +[](il2cpp_binding &bnd, const char *namespaceName, const char *className, const char *methodName, size_t numArgs, il2cpp_binding::HookCall &&call) {
+				std::lock_guard<std::recursive_mutex> lock(loaderMutex());
+				originalLoader(bnd).addHookCall(bnd, namespaceName, className, methodName, numArgs, std::move(call));
+			});
+			publishEntry(binding.RemoveHookCall, +[](il2cpp_binding &bnd, MethodHookNode *node) {
+				std::lock_guard<std::recursive_mutex> lock(loaderMutex());
+				originalLoader(bnd).removeHookCall(bnd, node);
+			});
+			publishEntry(binding.GetSharedData, +[](il2cpp_binding &bnd, const char *name, size_t size) -> void * {
+				std::lock_guard<std::recursive_mutex> lock(loaderMutex());
+				return originalLoader(bnd).getSharedData(bnd, name, size);
+			});
+		}
+		else {
+			auto it = bindings.find(&binding);
+			if (it == bindings.end() || --it->second.schedulers != 0) {
+				return;
+			}
+
+			const LoaderFunctions &original = it->second.original;
+			publishEntry(binding.GetIL2CPPContext, original.getContext);
+			publishEntry(binding.AddHookCall, original.addHookCall);
+			publishEntry(binding.RemoveHookCall, original.removeHookCall);
+			publishEntry(binding.GetSharedData, original.getSharedData);
+			bindings.erase(it);
+		}
+	}
+
+	std::vector<const ModDeclaration *> mMods;
+	std::vector<Node> mNodes;
+	std::vector<std::string> mErrors;
+
+	std::mutex mMutex;
+	std::condition_variable mCv;
+	std::deque<uint32_t> mReady;
+	uint32_t mOutstanding = 0;
+	uint32_t mInFlight = 0;
+};
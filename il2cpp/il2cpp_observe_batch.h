@@ -0,0 +1,488 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "il2cpp_binding.h"
+
+//Batched read-only observers for methods the game calls in tight loops. Every call only appends `this`, the
+//arguments and the return value to a per-thread columnar buffer; the observer runs once per batch with a span per
+//column. Observers bind through il2cpp_binding::observeClassFunction, so a call nothing else hooks goes straight to the
+//original and is recorded from the invoker's raw arguments, without building the call's storage. Requires C++20.
+//
+//	HookHandle handle = ObserveBatch::bindClass<float, int32_t, float>(binding, "", "Target", "GetScore",
+//		[](const ObservedBatch<float, int32_t, float> &batch) {
+//			std::span<const float> accuracy = batch.arg<1>();
+//			for (size_t i = 0; i < batch.size(); ++i) { ... }
+//		});
+//	ObserveBatch::bindFrameFlush(binding, "", "SongControl", "Update");
+//	...
+//	ObserveBatch::unbind(binding, handle);	//Delivers what is still buffered
+//
+//A batch is delivered on the thread that recorded it once it reaches maxBatchSize, on that thread's first call after the
+//HookFrame advances, or when the thread exits. Partial batches are delivered on the calling thread by
+//ObserveBatch::flushAll (bindFrameFlush calls it after a per-frame method), and by ObserveBatch::unbind for its observer,
+//so nothing waits for a method that stopped being called.
+
+struct ObserveBatchOptions {
+	uint32_t maxBatchSize = 256;
+
+	//Deliver a partial batch once HookFrame has advanced, so a batch never mixes frames
+	bool flushOnFrame = true;
+
+	int priority = 0;
+};
+
+//Fixed capacity column storage of one thread's records, see ObserveBatch::Observer::Buffer
+template<typename Ret, typename... Args>
+struct ObserveColumns {
+	using ArgTuple = std::tuple<std::decay_t<Args>...>;
+	using ReturnType = std::conditional_t<std::is_void_v<Ret>, char, Ret>;
+
+	explicit ObserveColumns(size_t capacity)
+		: instances(new void *[capacity]), args(std::unique_ptr<std::decay_t<Args>[]>(new std::decay_t<Args>[capacity])...),
+		returns(new ReturnType[std::is_void_v<Ret> ? 1 : capacity]) {}
+
+	std::unique_ptr<void *[]> instances;
+	std::tuple<std::unique_ptr<std::decay_t<Args>[]>...> args;
+	std::unique_ptr<ReturnType[]> returns;
+};
+
+//Read-only view of one batch, only valid during the observer callback
+template<typename Ret, typename... Args>
+class ObservedBatch {
+public:
+	using Columns = ObserveColumns<Ret, Args...>;
+
+	ObservedBatch(const Columns &columns, size_t first, size_t count, bool hasInstances)
+		: mColumns(columns), mFirst(first), mCount(count), mHasInstances(hasInstances) {}
+
+	size_t size() const {
+		return mCount;
+	}
+
+	//Raw `this` of every call, empty for static methods
+	std::span<void *const> instances() const {
+		return std::span<void *const>(mColumns.instances.get() + mFirst, mHasInstances ? mCount : 0);
+	}
+
+	template<size_t I>
+	std::span<const std::tuple_element_t<I, typename Columns::ArgTuple>> arg() const {
+		return std::span<const std::tuple_element_t<I, typename Columns::ArgTuple>>(std::get<I>(mColumns.args).get() + mFirst, mCount);
+	}
+
+	std::span<const Ret> returns() const requires (!std::is_void_v<Ret>) {
+		return std::span<const Ret>(mColumns.returns.get() + mFirst, mCount);
+	}
+
+private:
+	const Columns &mColumns;
+	size_t mFirst;
+	size_t mCount;
+	bool mHasInstances;
+};
+
+class ObserveBatch {
+public:
+	template<typename Ret, typename... Args>
+	using Callback = std::function<void(const ObservedBatch<Ret, Args...> &batch)>;
+
+	template<typename Ret, typename... Args>
+	static HookHandle bindClass(il2cpp_binding &binding, const char *namespaceName, const char *className, const char *methodName,
+		std::type_identity_t<Callback<Ret, Args...>> &&onBatch, const ObserveBatchOptions &options = {}) {
+		auto observer = std::make_shared<Observer<Ret, Args...>>(std::move(onBatch), options, true);
+
+		std::function<void(void *ths, const void *ret, Args...)> fn = [observer](void *ths, const void *ret, Args... args) {
+			observer->record(ths, ret, args...);
+		};
+		HookHandle handle = binding.observeClassFunction<Ret, Args...>(namespaceName, className, methodName, options.priority, HookOptions{}, std::move(fn));
+		track(handle, observer);
+		return handle;
+	}
+
+	template<typename Ret, typename... Args>
+	static HookHandle bindStatic(il2cpp_binding &binding, const char *namespaceName, const char *className, const char *methodName,
+		std::type_identity_t<Callback<Ret, Args...>> &&onBatch, const ObserveBatchOptions &options = {}) {
+		auto observer = std::make_shared<Observer<Ret, Args...>>(std::move(onBatch), options, false);
+
+		std::function<void(void *ths, const void *ret, Args...)> fn = [observer](void *, const void *ret, Args... args) {
+			observer->record(nullptr, ret, args...);
+		};
+		HookHandle handle = binding.observeStaticFunction<Ret, Args...>(namespaceName, className, methodName, options.priority, HookOptions{}, std::move(fn));
+		track(handle, observer);
+		return handle;
+	}
+
+	//Unbinds an observer and delivers everything it still buffers, on the calling thread. Calls still in flight on
+	//other threads deliver their record right away instead of buffering it
+	static bool unbind(il2cpp_binding &binding, HookHandle handle) {
+		bool unbound = binding.unbind(handle);
+
+		std::shared_ptr<ObserverBase> observer;
+		{
+			std::lock_guard<std::mutex> lock(registryMutex());
+			auto &observers = registry();
+			for (size_t i = 0; i < observers.size(); ++i) {
+				if (observers[i].handle.index == handle.index && observers[i].handle.generation == handle.generation) {
+					observer = std::move(observers[i].observer);
+					observers[i] = std::move(observers.back());
+					observers.pop_back();
+					break;
+				}
+			}
+		}
+
+		if (observer) {
+			observer->close();
+		}
+		return unbound;
+	}
+
+	//Delivers every partial batch of every bound observer, recorded on any thread, on the calling thread
+	static void flushAll() {
+		std::vector<std::shared_ptr<ObserverBase>> observers;
+		{
+			std::lock_guard<std::mutex> lock(registryMutex());
+			for (auto &entry : registry()) {
+				observers.push_back(entry.observer);
+			}
+		}
+
+		for (auto &observer : observers) {
+			observer->flushAll();
+		}
+	}
+
+	//Calls flushAll after every call of a per-frame method, e.g. the Update that advances HookFrame
+	static HookHandle bindFrameFlush(il2cpp_binding &binding, const char *namespaceName, const char *className, const char *methodName, int priority = 0) {
+		return binding.bindClassFunction(namespaceName, className, methodName, InvokeTime::After, priority, [](const MethodInvocationContext &, ThisPtr) {
+			flushAll();
+		});
+	}
+
+	//Delivers every partial batch recorded on the calling thread
+	static void flushThread() {
+		threadCache().flush();
+	}
+
+private:
+	struct BufferBase {
+		virtual ~BufferBase() = default;
+		virtual void flush() = 0;
+	};
+
+	struct ObserverBase {
+		virtual ~ObserverBase() = default;
+		virtual void flushAll() = 0;
+		virtual void close() = 0;
+		virtual void releaseBuffer(BufferBase *buffer) = 0;
+	};
+
+	struct Registered {
+		HookHandle handle;
+		std::shared_ptr<ObserverBase> observer;
+	};
+
+	static std::mutex &registryMutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static std::vector<Registered> &registry() {
+		static std::vector<Registered> observers;
+		return observers;
+	}
+
+	static void track(HookHandle handle, std::shared_ptr<ObserverBase> observer) {
+		if (!handle.isValid()) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(registryMutex());
+		registry().push_back({ handle, std::move(observer) });
+	}
+
+	//Observers keep the buffer of each of the first ThreadSlots threads that record in a table indexed by the thread's
+	//slot, so finding it is one load. Threads past that go through ThreadCache::find
+	static constexpr uint32_t ThreadSlots = 64;
+	static constexpr uint32_t NoThreadSlot = UINT32_MAX;
+
+	//The calling thread's slot, NoThreadSlot until its ThreadCache exists or if every slot is taken
+	static uint32_t &threadSlot() {
+		thread_local uint32_t slot = NoThreadSlot;
+		return slot;
+	}
+
+	static std::mutex &threadSlotsMutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static std::vector<uint32_t> &freeThreadSlots() {
+		static std::vector<uint32_t> slots;
+		return slots;
+	}
+
+	static uint32_t acquireThreadSlot() {
+		static uint32_t next = 0;
+		std::lock_guard<std::mutex> lock(threadSlotsMutex());
+		auto &slots = freeThreadSlots();
+		if (!slots.empty()) {
+			uint32_t slot = slots.back();
+			slots.pop_back();
+			return slot;
+		}
+		return next < ThreadSlots ? next++ : NoThreadSlot;
+	}
+
+	static void releaseThreadSlot(uint32_t slot) {
+		if (slot == NoThreadSlot) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(threadSlotsMutex());
+		freeThreadSlots().push_back(slot);
+	}
+
+	//The calling thread's buffer for each observer it recorded for. Observers own their buffers; entries only hold a
+	//weak reference, so a thread never keeps an unbound observer alive. Delivers and releases its buffers at thread exit,
+	//then hands its slot back once no observer's table points at one of its buffers anymore
+	struct ThreadCache {
+		struct Entry {
+			uint64_t observerId;
+			std::weak_ptr<ObserverBase> observer;
+			BufferBase *buffer;
+		};
+
+		std::vector<Entry> entries;
+
+		ThreadCache() {
+			threadSlot() = acquireThreadSlot();
+		}
+
+		~ThreadCache() {
+			for (auto &entry : entries) {
+				if (auto observer = entry.observer.lock()) {
+					entry.buffer->flush();
+					observer->releaseBuffer(entry.buffer);
+				}
+			}
+			releaseThreadSlot(threadSlot());
+			threadSlot() = NoThreadSlot;
+		}
+
+		BufferBase *find(uint64_t observerId) const {
+			for (auto &entry : entries) {
+				if (entry.observerId == observerId) {
+					return entry.buffer;
+				}
+			}
+			return nullptr;
+		}
+
+		//Also drops the entries of observers that are gone, so the cache only holds live observers
+		void add(uint64_t observerId, std::weak_ptr<ObserverBase> observer, BufferBase *buffer) {
+			std::erase_if(entries, [](const Entry &entry) { return entry.observer.expired(); });
+			entries.push_back({ observerId, std::move(observer), buffer });
+		}
+
+		void flush() {
+			for (auto &entry : entries) {
+				if (auto observer = entry.observer.lock()) {
+					entry.buffer->flush();
+				}
+			}
+		}
+	};
+
+	static ThreadCache &threadCache() {
+		thread_local ThreadCache cache;
+		return cache;
+	}
+
+	//Never reused, so a stale cache entry can't match a newer observer
+	static uint64_t nextObserverId() {
+		static std::atomic<uint64_t> id{ 0 };
+		return id.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<typename Ret, typename... Args>
+	class Observer : public ObserverBase, public std::enable_shared_from_this<Observer<Ret, Args...>> {
+	public:
+		Observer(Callback<Ret, Args...> &&onBatch, const ObserveBatchOptions &options, bool hasInstances)
+			: mOnBatch(std::move(onBatch)), mOptions(options), mId(nextObserverId()), mHasInstances(hasInstances) {
+			mOptions.maxBatchSize = mOptions.maxBatchSize == 0 ? 1 : mOptions.maxBatchSize;
+		}
+
+		//`ret` points at the result, nullptr for void methods. On the recording thread this is a table lookup, the
+		//column stores and a release store of the write position; delivery runs once per batch
+		void record(void *ths, const void *ret, Args... args) {
+			Buffer &buffer = threadBuffer();
+			if (mOptions.flushOnFrame) {
+				uint64_t frame = HookFrame::current();
+				if (frame != buffer.frame) {
+					//Whatever is still buffered belongs to an earlier frame
+					buffer.flush();
+					buffer.frame = frame;
+				}
+			}
+
+			uint64_t head = buffer.head.load(std::memory_order_relaxed);
+			if (head - buffer.tail.load(std::memory_order_acquire) == buffer.capacity) {
+				//Only reachable from a batch callback on this thread recording while its own batch is out
+				deliverAlone(ths, ret, args...);
+				return;
+			}
+
+			size_t index = (size_t)(head % buffer.capacity);
+			store(buffer.columns, index, ths, ret, args...);
+			buffer.head.store(head + 1, std::memory_order_release);
+
+			if ((index + 1) % mOptions.maxBatchSize == 0 || mClosed.load(std::memory_order_relaxed)) {
+				buffer.flush();
+			}
+		}
+
+		void flushAll() override {
+			std::lock_guard<std::recursive_mutex> lock(mBuffersMutex);
+			for (auto &buffer : mBuffers) {
+				buffer->flush();
+			}
+		}
+
+		//Records that land after this are delivered immediately, see ObserveBatch::unbind
+		void close() override {
+			mClosed.store(true);
+			flushAll();
+		}
+
+		//Called on the buffer's own thread as it exits
+		void releaseBuffer(BufferBase *released) override {
+			uint32_t slot = threadSlot();
+			if (slot != NoThreadSlot && mThreadBuffers[slot] == released) {
+				mThreadBuffers[slot] = nullptr;
+			}
+
+			std::lock_guard<std::recursive_mutex> lock(mBuffersMutex);
+			for (size_t i = 0; i < mBuffers.size(); ++i) {
+				if (mBuffers[i].get() == released) {
+					mBuffers[i] = std::move(mBuffers.back());
+					mBuffers.pop_back();
+					return;
+				}
+			}
+		}
+
+	private:
+		using Columns = ObserveColumns<Ret, Args...>;
+
+		//Single producer ring of two batches. Only its thread writes records and advances `head`; whichever thread flushes
+		//delivers [tail, head) straight from the columns and advances `tail`, serialized by `deliverMutex`. The owner
+		//delivers at the end of each half and never gets a full ring ahead of `tail`, so it never writes a record that is
+		//being delivered. Pending records split at the end of the columns go out as two batches
+		struct Buffer : BufferBase {
+			Buffer(Observer *observer, size_t capacity) : observer(observer), capacity(capacity), columns(capacity) {}
+
+			Observer *observer;
+			const size_t capacity;
+			Columns columns;
+			std::atomic<uint64_t> head{ 0 };
+			std::atomic<uint64_t> tail{ 0 };
+			uint64_t frame = 0;
+
+			std::recursive_mutex deliverMutex;
+			bool delivering = false;
+
+			void flush() override {
+				std::lock_guard<std::recursive_mutex> deliver(deliverMutex);
+
+				//A callback flushing its own observer again; the outer flush picks up whatever was recorded since
+				if (delivering) {
+					return;
+				}
+
+				delivering = true;
+				for (;;) {
+					uint64_t first = tail.load(std::memory_order_relaxed);
+					uint64_t last = head.load(std::memory_order_acquire);
+					if (first == last) {
+						break;
+					}
+
+					size_t index = (size_t)(first % capacity);
+					size_t count = (size_t)std::min<uint64_t>({ last - first, observer->mOptions.maxBatchSize, capacity - index });
+					observer->mOnBatch(ObservedBatch<Ret, Args...>(columns, index, count, observer->mHasInstances));
+					tail.store(first + count, std::memory_order_release);
+				}
+				delivering = false;
+			}
+		};
+
+		void store(Columns &columns, size_t index, void *ths, const void *ret, Args... args) {
+			if (mHasInstances) {
+				columns.instances[index] = ths;
+			}
+			storeArgs(columns, index, std::index_sequence_for<Args...>{}, args...);
+			if constexpr (!std::is_void_v<Ret>) {
+				columns.returns[index] = *static_cast<const Ret *>(ret);
+			}
+		}
+
+		template<size_t... I>
+		static void storeArgs(Columns &columns, size_t index, std::index_sequence<I...>, Args... args) {
+			((std::get<I>(columns.args)[index] = args), ...);
+		}
+
+		void deliverAlone(void *ths, const void *ret, Args... args) {
+			Columns single(1);
+			store(single, 0, ths, ret, args...);
+			mOnBatch(ObservedBatch<Ret, Args...>(single, 0, 1, mHasInstances));
+		}
+
+		Buffer &threadBuffer() {
+			uint32_t slot = threadSlot();
+			if (slot != NoThreadSlot && mThreadBuffers[slot] != nullptr) {
+				return *mThreadBuffers[slot];
+			}
+
+			ThreadCache &cache = threadCache();
+			slot = threadSlot();
+			if (BufferBase *buffer = cache.find(mId)) {
+				return static_cast<Buffer &>(*buffer);
+			}
+
+			auto buffer = std::make_unique<Buffer>(this, (size_t)mOptions.maxBatchSize * 2);
+			Buffer *created = buffer.get();
+			{
+				std::lock_guard<std::recursive_mutex> lock(mBuffersMutex);
+				mBuffers.push_back(std::move(buffer));
+			}
+			cache.add(mId, this->weak_from_this(), created);
+			if (slot != NoThreadSlot) {
+				mThreadBuffers[slot] = created;
+			}
+			return *created;
+		}
+
+		Callback<Ret, Args...> mOnBatch;
+		ObserveBatchOptions mOptions;
+		uint64_t mId;
+		bool mHasInstances;
+		std::atomic<bool> mClosed{ false };
+
+		//Entry `slot` is only read and written by the thread holding that slot
+		Buffer *mThreadBuffers[ThreadSlots] = {};
+
+		//Recursive, a batch callback may flush or unbind observers itself
+		std::recursive_mutex mBuffersMutex;
+		std::vector<std::unique_ptr<Buffer>> mBuffers;
+	};
+};
@@ -0,0 +1,315 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "il2cpp_types.h"
+#include "il2cpp_hook_pool.h"
+
+//Whether a hooked method's original is memoized. Shared between mods through il2cpp_binding::getSharedData, since the
+//loader calls the invokeOriginalFunction of whichever HookCall it routes through, so every hook on a method has to agree
+struct PureMethodState {
+	std::atomic<uint32_t> pureHooks;
+	std::atomic<uint32_t> plainHooks;
+};
+
+//Result cache for hooked methods bound with HookOptions::pure.
+//Keys are the original function and the raw argument bytes out of MethodInvocationStorage. Only static methods are
+//memoized, a this pointer is an address the GC can give to another object just like a managed argument. The table has a fixed size: it is split into independently locked
+//shards, each made of small sets that evict with a CLOCK hand, so memory never grows.
+class PureCallCache {
+public:
+	static const uint32_t MaxKeySize = 64;
+	static const uint32_t MaxValueSize = 32;
+	static const uint32_t NumShards = 16;
+	static const uint32_t SetsPerShard = 32;
+	static const uint32_t Ways = 8;
+
+	//Managed references only identify an object, not its contents, and the GC may hand the address to another object
+	template<typename T>
+	static constexpr bool isManagedReference() {
+		return std::is_same_v<T, internal::Il2CppObject> || std::is_same_v<T, internal::Il2CppString> || std::is_same_v<T, il2cppapi::Object> || IsArray<T>::value;
+	}
+
+	//Values are keyed and stored as raw bytes, so only plain values qualify: no pointers, references or managed objects
+	template<typename T>
+	static constexpr bool isPlainValue() {
+		using U = std::remove_cv_t<T>;
+		return !std::is_reference_v<T> && !std::is_pointer_v<U> && !std::is_member_pointer_v<U> && !isManagedReference<U>() && std::is_trivially_copyable_v<U>;
+	}
+
+	template<typename Ret, typename... Args>
+	static constexpr bool canCache() {
+		if constexpr (std::is_void_v<Ret>) {
+			return false;
+		}
+		else {
+			return isPlainValue<Ret>() && std::is_default_constructible_v<Ret> && sizeof(Ret) <= MaxValueSize && (isPlainValue<Args>() && ...);
+		}
+	}
+
+	//Registers a hook on a method, `pure` being whether it memoizes the original. Fails if the method's other hooks disagree
+	static bool claim(PureMethodState &state, bool pure) {
+		std::atomic<uint32_t> &own = pure ? state.pureHooks : state.plainHooks;
+		std::atomic<uint32_t> &other = pure ? state.plainHooks : state.pureHooks;
+
+		own.fetch_add(1);
+		if (other.load() != 0) {
+			own.fetch_sub(1);
+			return false;
+		}
+		return true;
+	}
+
+	struct Key {
+		const void *fn;
+		const uint8_t *args;
+		uint32_t argSize;
+		uint64_t hash;
+
+		Key(const void *fn, const uint8_t *args, uint32_t argSize) : fn(fn), args(args), argSize(argSize) {
+			//FNV-1a over the function and the argument bytes
+			uint64_t h = 14695981039346656037ull;
+			auto mix = [&h](const uint8_t *data, size_t size) {
+				for (size_t i = 0; i < size; ++i) {
+					h = (h ^ data[i]) * 1099511628211ull;
+				}
+			};
+			mix(reinterpret_cast<const uint8_t *>(&fn), sizeof(fn));
+			mix(args, argSize);
+			hash = h;
+		}
+	};
+
+	struct Stats {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t uncacheable;
+		uint64_t invalidations;
+		uint64_t liveEntries;
+		uint64_t memoryBytes;
+	};
+
+	static PureCallCache &global() {
+		static PureCallCache cache;
+		return cache;
+	}
+
+	//Copies the cached value into `value` and returns true on a hit
+	bool lookup(const Key &key, void *value, uint32_t valueSize) {
+		if (key.argSize > MaxKeySize) {
+			mUncacheable.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		Shard &shard = shardFor(key);
+		uint32_t generation = mGeneration.load(std::memory_order_acquire);
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		Set &set = setFor(shard, key);
+		for (auto &entry : set.entries) {
+			if (entry.matches(key, generation) && entry.valueSize == valueSize) {
+				std::memcpy(value, entry.value, valueSize);
+				entry.referenced = true;
+				mHits.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		mMisses.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	void store(const Key &key, const void *value, uint32_t valueSize) {
+		if (key.argSize > MaxKeySize || valueSize > MaxValueSize) {
+			return;
+		}
+
+		Shard &shard = shardFor(key);
+		uint32_t generation = mGeneration.load(std::memory_order_acquire);
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		Set &set = setFor(shard, key);
+
+		Entry *slot = nullptr;
+		for (auto &entry : set.entries) {
+			if (entry.matches(key, generation) || !entry.isLive(generation)) {
+				slot = &entry;
+				break;
+			}
+		}
+
+		//CLOCK: skip over recently used entries, clearing their bit, and take the first unreferenced one
+		while (slot == nullptr) {
+			Entry &candidate = set.entries[set.hand];
+			set.hand = (set.hand + 1) % Ways;
+			if (candidate.referenced) {
+				candidate.referenced = false;
+			}
+			else {
+				slot = &candidate;
+				mEvictions.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		slot->valid = true;
+		slot->referenced = false;
+		slot->generation = generation;
+		slot->hash = key.hash;
+		slot->fn = key.fn;
+		slot->keySize = key.argSize;
+		slot->valueSize = valueSize;
+		std::memcpy(slot->key, key.args, key.argSize);
+		std::memcpy(slot->value, value, valueSize);
+	}
+
+	//Drops every cached result. O(1), entries from older generations are treated as empty
+	void invalidateAll() {
+		mGeneration.fetch_add(1, std::memory_order_acq_rel);
+		mInvalidations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//Drops every cached result of the method a hook is bound to. Falls back to invalidateAll if the loader didn't report
+	//the method's original
+	void invalidate(HookHandle handle) {
+		const void *originalFn = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(mBindingsMutex);
+			for (auto &binding : mBindings) {
+				if (binding.handle.index == handle.index && binding.handle.generation == handle.generation) {
+					originalFn = binding.originalFn;
+					break;
+				}
+			}
+		}
+
+		if (originalFn == nullptr) {
+			invalidateAll();
+			return;
+		}
+		invalidateFunction(originalFn);
+	}
+
+	//Remembers the method a hook was bound to, for invalidate and to release its claim on unbind
+	void track(HookHandle handle, PureMethodState *state, bool pure, const void *originalFn) {
+		std::lock_guard<std::mutex> lock(mBindingsMutex);
+		mBindings.push_back({ handle, state, pure, originalFn });
+	}
+
+	void untrack(HookHandle handle) {
+		std::lock_guard<std::mutex> lock(mBindingsMutex);
+		for (size_t i = 0; i < mBindings.size(); ++i) {
+			Binding &binding = mBindings[i];
+			if (binding.handle.index == handle.index && binding.handle.generation == handle.generation) {
+				(binding.pure ? binding.state->pureHooks : binding.state->plainHooks).fetch_sub(1);
+				mBindings[i] = mBindings.back();
+				mBindings.pop_back();
+				return;
+			}
+		}
+	}
+
+	Stats stats() {
+		Stats stats = {};
+		stats.hits = mHits.load(std::memory_order_relaxed);
+		stats.misses = mMisses.load(std::memory_order_relaxed);
+		stats.evictions = mEvictions.load(std::memory_order_relaxed);
+		stats.uncacheable = mUncacheable.load(std::memory_order_relaxed);
+		stats.invalidations = mInvalidations.load(std::memory_order_relaxed);
+		stats.memoryBytes = sizeof(*this);
+
+		uint32_t generation = mGeneration.load(std::memory_order_acquire);
+		for (auto &shard : mShards) {
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			for (auto &set : shard.sets) {
+				for (auto &entry : set.entries) {
+					stats.liveEntries += entry.isLive(generation) ? 1 : 0;
+				}
+			}
+		}
+		return stats;
+	}
+
+private:
+	template<typename T>
+	struct IsArray : std::false_type {};
+
+	template<typename T>
+	struct IsArray<il2cppapi::Array<T>> : std::true_type {};
+
+	struct Binding {
+		HookHandle handle;
+		PureMethodState *state;
+		bool pure;
+		const void *originalFn;
+	};
+
+	void invalidateFunction(const void *originalFn) {
+		for (auto &shard : mShards) {
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			for (auto &set : shard.sets) {
+				for (auto &entry : set.entries) {
+					if (entry.fn == originalFn) {
+						entry.valid = false;
+					}
+				}
+			}
+		}
+		mInvalidations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	struct Entry {
+		uint64_t hash = 0;
+		const void *fn = nullptr;
+		uint32_t generation = 0;
+		uint32_t keySize = 0;
+		uint32_t valueSize = 0;
+		bool valid = false;
+		bool referenced = false;
+		uint8_t key[MaxKeySize];
+		uint8_t value[MaxValueSize];
+
+		bool isLive(uint32_t currentGeneration) const {
+			return valid && generation == currentGeneration;
+		}
+
+		bool matches(const Key &k, uint32_t currentGeneration) const {
+			return isLive(currentGeneration) && hash == k.hash && fn == k.fn && keySize == k.argSize && std::memcmp(key, k.args, k.argSize) == 0;
+		}
+	};
+
+	struct Set {
+		std::array<Entry, Ways> entries;
+		uint32_t hand = 0;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+		std::array<Set, SetsPerShard> sets;
+	};
+
+	Shard &shardFor(const Key &key) {
+		return mShards[key.hash % NumShards];
+	}
+
+	Set &setFor(Shard &shard, const Key &key) {
+		return shard.sets[(key.hash / NumShards) % SetsPerShard];
+	}
+
+	std::array<Shard, NumShards> mShards;
+	std::atomic<uint32_t> mGeneration{ 1 };
+
+	std::atomic<uint64_t> mHits{ 0 };
+	std::atomic<uint64_t> mMisses{ 0 };
+	std::atomic<uint64_t> mEvictions{ 0 };
+	std::atomic<uint64_t> mUncacheable{ 0 };
+	std::atomic<uint64_t> mInvalidations{ 0 };
+
+	std::mutex mBindingsMutex;
+	std::vector<Binding> mBindings;
+};
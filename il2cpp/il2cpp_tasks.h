@@ -0,0 +1,285 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "il2cpp_binding.h"
+
+//Coroutine tasks for spreading expensive mod work across frames. Requires C++20.
+//
+//	Task loadSongs(TaskScheduler &) {
+//		co_await onWorkerThread();	//Parse files off the game thread
+//		...
+//		co_await nextFrame();		//Back on the game thread, at most once per budgeted tick
+//		...
+//	}
+//
+//	scheduler.attach(binding, "", "SongList", "Update");
+//	scheduler.spawn(loadSongs(scheduler));
+//
+//Everything between two awaits runs uninterrupted, so long loops should `co_await nextFrame()` periodically.
+
+class TaskScheduler;
+
+class Task {
+public:
+	struct promise_type {
+		TaskScheduler *scheduler = nullptr;
+
+		Task get_return_object() {
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		//Tasks don't run until they are handed to a scheduler
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		struct FinalAwaiter {
+			bool await_ready() noexcept { return false; }
+			void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+			void await_resume() noexcept {}
+		};
+		FinalAwaiter final_suspend() noexcept { return {}; }
+
+		void return_void() {}
+
+		void unhandled_exception() {
+			try {
+				std::rethrow_exception(std::current_exception());
+			}
+			catch (const std::exception &e) {
+				printf("ERROR: Task: Unhandled exception: %s\n", e.what());
+			}
+			catch (...) {
+				printf("ERROR: Task: Unhandled exception!\n");
+			}
+		}
+	};
+
+	Task(Task &&rhs) noexcept : mHandle(rhs.mHandle) {
+		rhs.mHandle = nullptr;
+	}
+
+	Task(const Task &) = delete;
+	Task &operator=(const Task &) = delete;
+
+	~Task() {
+		if (mHandle) {
+			mHandle.destroy();
+		}
+	}
+
+	std::coroutine_handle<promise_type> release() {
+		auto handle = mHandle;
+		mHandle = nullptr;
+		return handle;
+	}
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+
+	std::coroutine_handle<promise_type> mHandle;
+};
+
+//Drives tasks from a per-frame hook, resuming only as many as fit in the frame budget
+class TaskScheduler {
+public:
+	using Handle = std::coroutine_handle<Task::promise_type>;
+
+	explicit TaskScheduler(std::chrono::microseconds frameBudget = std::chrono::microseconds(2000), uint32_t workerThreads = 1)
+		: mFrameBudget(frameBudget) {
+		for (uint32_t i = 0; i < workerThreads; ++i) {
+			mWorkers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	~TaskScheduler() {
+		detach();
+
+		{
+			std::lock_guard<std::mutex> lock(mWorkerMutex);
+			mShutdown = true;
+		}
+		mWorkerCv.notify_all();
+		for (auto &worker : mWorkers) {
+			worker.join();
+		}
+		for (auto handle : mWorkQueue) handle.destroy();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (auto handle : mReady) handle.destroy();
+		for (auto handle : mNextFrame) handle.destroy();
+		for (auto handle : mCompleted) handle.destroy();
+	}
+
+	//Takes ownership of the task, it first runs on the next tick
+	void spawn(Task &&task) {
+		Handle handle = task.release();
+		handle.promise().scheduler = this;
+		scheduleNextFrame(handle);
+	}
+
+	//Runs one frame of work. Resumes queued tasks in order until the frame budget is used up,
+	//always resuming at least one so nothing starves. Tasks that didn't fit stay queued for the next tick
+	void tick() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			for (auto handle : mNextFrame) {
+				mReady.push_back(handle);
+			}
+			mNextFrame.clear();
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		uint32_t resumed = 0;
+		while (resumed == 0 || std::chrono::steady_clock::now() - start < mFrameBudget) {
+			Handle handle;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (mReady.empty()) {
+					break;
+				}
+				handle = mReady.front();
+				mReady.pop_front();
+			}
+
+			handle.resume();
+			++resumed;
+		}
+		mLastResumed.store(resumed, std::memory_order_relaxed);
+
+		std::vector<Handle> completed;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			completed.swap(mCompleted);
+		}
+		for (auto handle : completed) {
+			handle.destroy();
+		}
+	}
+
+	//Ticks the scheduler after every call of the given per-frame method, e.g. an Update.
+	//The hook is unbound again by detach or when the scheduler is destroyed, replacing any previous attach
+	bool attach(il2cpp_binding &binding, const char *namespaceName, const char *className, const char *methodName, int priority = 0) {
+		detach();
+
+		mTickHook = binding.bindClassFunction(namespaceName, className, methodName, InvokeTime::After, priority, [this](const MethodInvocationContext &, ThisPtr) {
+			tick();
+		});
+		if (!mTickHook.isValid()) {
+			return false;
+		}
+
+		mBinding = &binding;
+		return true;
+	}
+
+	void detach() {
+		if (mBinding != nullptr) {
+			mBinding->unbind(mTickHook);
+			mBinding = nullptr;
+			mTickHook = HookHandle();
+		}
+	}
+
+	size_t pendingTasks() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mReady.size() + mNextFrame.size();
+	}
+
+	uint32_t lastResumedCount() const {
+		return mLastResumed.load(std::memory_order_relaxed);
+	}
+
+	void setFrameBudget(std::chrono::microseconds budget) {
+		mFrameBudget = budget;
+	}
+
+	void scheduleNextFrame(Handle handle) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mNextFrame.push_back(handle);
+	}
+
+	void scheduleOnWorker(Handle handle) {
+		if (mWorkers.empty()) {
+			//No workers, so run it on the next tick instead
+			scheduleNextFrame(handle);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mWorkerMutex);
+			mWorkQueue.push_back(handle);
+		}
+		mWorkerCv.notify_one();
+	}
+
+	void complete(Handle handle) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mCompleted.push_back(handle);
+	}
+
+private:
+	void workerLoop() {
+		for (;;) {
+			Handle handle;
+			{
+				std::unique_lock<std::mutex> lock(mWorkerMutex);
+				mWorkerCv.wait(lock, [this]() { return mShutdown || !mWorkQueue.empty(); });
+				if (mShutdown) {
+					return;
+				}
+				handle = mWorkQueue.front();
+				mWorkQueue.pop_front();
+			}
+
+			handle.resume();
+		}
+	}
+
+	std::chrono::microseconds mFrameBudget;
+	std::atomic<uint32_t> mLastResumed{ 0 };
+
+	il2cpp_binding *mBinding = nullptr;
+	HookHandle mTickHook;
+
+	mutable std::mutex mMutex;
+	std::deque<Handle> mReady;
+	std::vector<Handle> mNextFrame;
+	std::vector<Handle> mCompleted;
+
+	std::mutex mWorkerMutex;
+	std::condition_variable mWorkerCv;
+	std::deque<Handle> mWorkQueue;
+	bool mShutdown = false;
+	std::vector<std::thread> mWorkers;
+};
+
+inline void Task::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+	//Finished tasks are destroyed by the scheduler on the next tick, since they may finish on a worker thread
+	handle.promise().scheduler->complete(handle);
+}
+
+//Suspends the task until the next scheduler tick
+struct nextFrame {
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(TaskScheduler::Handle handle) const {
+		handle.promise().scheduler->scheduleNextFrame(handle);
+	}
+	void await_resume() const noexcept {}
+};
+
+//Continues the task on one of the scheduler's worker threads. Use `co_await nextFrame()` to get back to the game thread
+struct onWorkerThread {
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(TaskScheduler::Handle handle) const {
+		handle.promise().scheduler->scheduleOnWorker(handle);
+	}
+	void await_resume() const noexcept {}
+};
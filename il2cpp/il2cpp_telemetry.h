@@ -0,0 +1,447 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//Live hook telemetry, published into a shared memory segment that external tools can map read-only.
+//
+//Segment layout (version 2, little endian, all offsets in bytes). The layout is stable; anything new is
+//added by bumping TelemetryHeader::version and appending, never by moving existing fields.
+//
+//	TelemetryHeader, 64 bytes, at offset 0
+//		0	uint32 magic			TelemetryMagic ('AMLT')
+//		4	uint32 version			TelemetryVersion
+//		8	uint32 slotCount		number of TelemetrySlot entries following the header
+//		12	uint32 slotSize			sizeof(TelemetrySlot), 128
+//		16	uint32 usedSlots		slots [0, usedSlots) have been claimed
+//		20	uint32 createLock		writer-only spinlock for claiming slots
+//		24	uint64 createdUnixNs	when the segment was initialized
+//		32	uint32 ownerProcessId	process that initialized the segment
+//		36	uint32 readyProcessId	set to ownerProcessId once that initialization finished
+//
+//The segment can outlive the game (a file mapping, or shm on Linux), so the first writer from a new process
+//clears it: slots left over from an earlier run are dropped and createdUnixNs changes, which tells readers to reset.
+//
+//	TelemetrySlot[slotCount], 128 bytes each, starting at offset 64
+//		0	uint32 sequence			seqlock, odd while a writer is updating the slot
+//		4	uint32 kind				TelemetrySlotKind
+//		8	uint64 id				HookCall::id for hook slots, 0 for mod slots
+//		16	char name[48]			null terminated, longer names are cut to 47 bytes
+//		64	uint64 calls			hook runs recorded
+//		72	uint64 totalNs			summed time spent in the hook
+//		80	uint64 maxNs			slowest run
+//		88	uint64 errors			runs that ended in an exception
+//		96	uint64 pending[4]		writer-only, samples not yet folded into the fields above
+//
+//Readers take a consistent copy of a slot by reading `sequence`, the fields, then `sequence` again, and
+//retrying if it changed or was odd (see TelemetrySlot::read). Writers never wait: if another thread holds a
+//slot's seqlock, the sample is added to the slot's pending counters and folded in by the next writer.
+//A hook slot times the hook's own body, a mod slot every hook the mod bound (whichever mod's invoker dispatched it).
+//
+//Mapping names: `Local\AudicaModLoaderTelemetry` on Windows, `/AudicaModLoaderTelemetry` (shm_open) elsewhere.
+//If AUDICA_TELEMETRY_FILE is set, that file is mapped instead, e.g. `Z:\dev\shm\audica_telemetry` under Proton
+//so a native Linux reader can open /dev/shm/audica_telemetry.
+
+static const uint32_t TelemetryMagic = 0x544C4D41;
+static const uint32_t TelemetryVersion = 2;
+static const uint32_t TelemetrySlotCount = 1024;
+static const char *const TelemetryMappingName = "AudicaModLoaderTelemetry";
+
+enum class TelemetrySlotKind : uint32_t {
+	Free = 0,
+	Hook = 1,
+	Mod = 2
+};
+
+struct TelemetryHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t slotSize;
+	std::atomic<uint32_t> usedSlots;
+	std::atomic<uint32_t> createLock;
+	uint64_t createdUnixNs;
+	std::atomic<uint32_t> ownerProcessId;
+	std::atomic<uint32_t> readyProcessId;
+	uint8_t reserved[24];
+};
+static_assert(sizeof(TelemetryHeader) == 64, "TelemetryHeader is part of the published segment layout");
+
+struct TelemetrySlot {
+	struct Snapshot {
+		TelemetrySlotKind kind;
+		uint64_t id;
+		char name[48];
+		uint64_t calls;
+		uint64_t totalNs;
+		uint64_t maxNs;
+		uint64_t errors;
+	};
+
+	std::atomic<uint32_t> sequence;
+	TelemetrySlotKind kind;
+	uint64_t id;
+	char name[48];
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> totalNs;
+	std::atomic<uint64_t> maxNs;
+	std::atomic<uint64_t> errors;
+	std::atomic<uint64_t> pendingCalls;
+	std::atomic<uint64_t> pendingNs;
+	std::atomic<uint64_t> pendingMaxNs;
+	std::atomic<uint64_t> pendingErrors;
+
+	//Adds one sample. Lock free and never waits on other writers
+	void record(uint64_t ns, bool error) {
+		uint32_t seq = sequence.load(std::memory_order_relaxed);
+		if ((seq & 1) == 0 && sequence.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+			uint64_t addCalls = 1 + pendingCalls.exchange(0, std::memory_order_relaxed);
+			uint64_t addNs = ns + pendingNs.exchange(0, std::memory_order_relaxed);
+			uint64_t addErrors = (error ? 1 : 0) + pendingErrors.exchange(0, std::memory_order_relaxed);
+			uint64_t sampleMax = std::max(ns, pendingMaxNs.exchange(0, std::memory_order_relaxed));
+
+			calls.store(calls.load(std::memory_order_relaxed) + addCalls, std::memory_order_relaxed);
+			totalNs.store(totalNs.load(std::memory_order_relaxed) + addNs, std::memory_order_relaxed);
+			errors.store(errors.load(std::memory_order_relaxed) + addErrors, std::memory_order_relaxed);
+			if (sampleMax > maxNs.load(std::memory_order_relaxed)) {
+				maxNs.store(sampleMax, std::memory_order_relaxed);
+			}
+
+			sequence.store(seq + 2, std::memory_order_release);
+			return;
+		}
+
+		pendingCalls.fetch_add(1, std::memory_order_relaxed);
+		pendingNs.fetch_add(ns, std::memory_order_relaxed);
+		if (error) {
+			pendingErrors.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		uint64_t currentMax = pendingMaxNs.load(std::memory_order_relaxed);
+		while (ns > currentMax && !pendingMaxNs.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed)) {
+		}
+	}
+
+	//Consistent copy of the published fields, for readers
+	Snapshot read() const {
+		Snapshot snapshot;
+		for (;;) {
+			uint32_t before = sequence.load(std::memory_order_acquire);
+			if (before & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			snapshot.kind = kind;
+			snapshot.id = id;
+			std::memcpy(snapshot.name, name, sizeof(name));
+			snapshot.name[sizeof(name) - 1] = '\0';
+			snapshot.calls = calls.load(std::memory_order_relaxed);
+			snapshot.totalNs = totalNs.load(std::memory_order_relaxed);
+			snapshot.maxNs = maxNs.load(std::memory_order_relaxed);
+			snapshot.errors = errors.load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence.load(std::memory_order_relaxed) == before) {
+				return snapshot;
+			}
+		}
+	}
+
+	//Sets the slot's identity. Only called while holding the header's createLock
+	void claim(TelemetrySlotKind slotKind, uint64_t slotId, const char *slotName) {
+		uint32_t seq = sequence.load(std::memory_order_relaxed);
+		while ((seq & 1) || !sequence.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+			seq = sequence.load(std::memory_order_relaxed);
+		}
+
+		kind = slotKind;
+		id = slotId;
+		rename(slotName);
+
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	void rename(const char *slotName) {
+		std::memset(name, 0, sizeof(name));
+		if (slotName != nullptr) {
+			size_t length = strnlen(slotName, sizeof(name) - 1);
+			std::memcpy(name, slotName, length);
+			name[length] = '\0';
+		}
+	}
+};
+static_assert(sizeof(TelemetrySlot) == 128, "TelemetrySlot is part of the published segment layout");
+
+//Maps the telemetry segment, either as a writer (creating it if needed) or a reader
+class TelemetrySegment {
+public:
+	static size_t byteSize() {
+		return sizeof(TelemetryHeader) + sizeof(TelemetrySlot) * TelemetrySlotCount;
+	}
+
+	//Returns nullptr if the segment could not be mapped. Readers get nullptr if it doesn't exist yet
+	static TelemetryHeader *map(bool create) {
+		void *memory = nullptr;
+		const char *file = getenv("AUDICA_TELEMETRY_FILE");
+
+#ifdef _WIN32
+		HANDLE fileHandle = INVALID_HANDLE_VALUE;
+		if (file != nullptr) {
+			fileHandle = CreateFileA(file, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (fileHandle == INVALID_HANDLE_VALUE) {
+				return nullptr;
+			}
+		}
+
+		char mappingName[128];
+		snprintf(mappingName, sizeof(mappingName), "Local\\%s", TelemetryMappingName);
+		HANDLE mapping = (create || file != nullptr)
+			? CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, 0, (DWORD)byteSize(), file ? nullptr : mappingName)
+			: OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, mappingName);
+		if (mapping != nullptr) {
+			memory = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, byteSize());
+		}
+#else
+		int fd = -1;
+		if (file != nullptr) {
+			fd = open(file, create ? (O_RDWR | O_CREAT) : O_RDWR, 0644);
+		}
+		else {
+			char mappingName[128];
+			snprintf(mappingName, sizeof(mappingName), "/%s", TelemetryMappingName);
+			fd = shm_open(mappingName, create ? (O_RDWR | O_CREAT) : O_RDWR, 0644);
+		}
+
+		if (fd < 0) {
+			return nullptr;
+		}
+
+		if (create && ftruncate(fd, (off_t)byteSize()) != 0) {
+			close(fd);
+			return nullptr;
+		}
+
+		memory = mmap(nullptr, byteSize(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (memory == MAP_FAILED) {
+			memory = nullptr;
+		}
+#endif
+
+		if (memory == nullptr) {
+			return nullptr;
+		}
+
+		TelemetryHeader *header = static_cast<TelemetryHeader *>(memory);
+		if (create) {
+			initialize(header);
+		}
+
+		return header;
+	}
+
+	static TelemetrySlot *slots(TelemetryHeader *header) {
+		return reinterpret_cast<TelemetrySlot *>(reinterpret_cast<uint8_t *>(header) + sizeof(TelemetryHeader));
+	}
+
+	//Writer side slot claiming. Only used the first time a hook or mod is seen, never on the record path
+	static void lock(TelemetryHeader *header) {
+		uint32_t expected = 0;
+		while (!header->createLock.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+			expected = 0;
+			std::this_thread::yield();
+		}
+	}
+
+	static bool tryLock(TelemetryHeader *header) {
+		uint32_t expected = 0;
+		return header->createLock.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+	}
+
+	static void unlock(TelemetryHeader *header) {
+		header->createLock.store(0, std::memory_order_release);
+	}
+
+private:
+	static uint32_t processId() {
+#ifdef _WIN32
+		return (uint32_t)GetCurrentProcessId();
+#else
+		return (uint32_t)getpid();
+#endif
+	}
+
+	//The first writer of this process wipes whatever an earlier run left behind, including a createLock that run may
+	//have died holding. Other writers wait for it to finish
+	static void initialize(TelemetryHeader *header) {
+		uint32_t pid = processId();
+		uint32_t owner = header->ownerProcessId.load(std::memory_order_acquire);
+		if (owner != pid && header->ownerProcessId.compare_exchange_strong(owner, pid, std::memory_order_acq_rel)) {
+			header->magic = 0;
+			header->createLock.store(1, std::memory_order_relaxed);
+			std::memset(static_cast<void *>(slots(header)), 0, sizeof(TelemetrySlot) * TelemetrySlotCount);
+			header->usedSlots.store(0, std::memory_order_relaxed);
+			header->version = TelemetryVersion;
+			header->slotCount = TelemetrySlotCount;
+			header->slotSize = sizeof(TelemetrySlot);
+			header->createdUnixNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			std::atomic_thread_fence(std::memory_order_release);
+			header->magic = TelemetryMagic;
+			unlock(header);
+			header->readyProcessId.store(pid, std::memory_order_release);
+			return;
+		}
+
+		while (header->readyProcessId.load(std::memory_order_acquire) != pid) {
+			std::this_thread::yield();
+		}
+	}
+};
+
+//A hook's telemetry state, kept on its node so recording never has to look its slot up
+struct TelemetryHook {
+	std::atomic<TelemetrySlot *> slot{ nullptr };
+	uint64_t id = 0;
+};
+
+//Writer side API used by the invokers. Disabled (a null check) until a mod calls Telemetry::open
+class Telemetry {
+public:
+	//Maps the segment and registers a slot for this mod, e.g. `Telemetry::open(declaration.modName)`.
+	//Call it before binding so hook slots get their method names
+	static bool open(const char *modName) {
+		TelemetryHeader *header = TelemetrySegment::map(true);
+		if (header == nullptr) {
+			printf("ERROR: Telemetry: Could not map the telemetry segment!\n");
+			return false;
+		}
+
+		modSlot() = findOrClaim(header, TelemetrySlotKind::Mod, 0, modName, true);
+		segment().store(header, std::memory_order_release);
+		return true;
+	}
+
+	static bool isEnabled() {
+		return segment().load(std::memory_order_relaxed) != nullptr;
+	}
+
+	//Claims the hook's slot when it's bound, after the loader assigned its id
+	static void bindHook(TelemetryHook &hook, uint64_t hookId, const char *name) {
+		hook.id = hookId;
+		TelemetryHeader *header = segment().load(std::memory_order_acquire);
+		if (header != nullptr) {
+			hook.slot.store(findOrClaim(header, TelemetrySlotKind::Hook, hookId, name, true), std::memory_order_release);
+		}
+	}
+
+	//Never waits. Hooks bound before Telemetry::open claim a slot on their first run, and skip samples while
+	//another writer holds the segment's createLock
+	static void record(TelemetryHook &hook, uint64_t ns, bool error) {
+		TelemetrySlot *slot = hook.slot.load(std::memory_order_acquire);
+		if (slot == nullptr && hook.id != 0) {
+			char name[48];
+			snprintf(name, sizeof(name), "hook %llu", (unsigned long long)hook.id);
+			slot = findOrClaim(segment().load(std::memory_order_acquire), TelemetrySlotKind::Hook, hook.id, name, false);
+			if (slot != nullptr) {
+				hook.slot.store(slot, std::memory_order_release);
+			}
+		}
+
+		if (slot != nullptr) {
+			slot->record(ns, error);
+		}
+
+		//Mod slots are static per mod, so this is the mod that bound the hook
+		if (modSlot() != nullptr) {
+			modSlot()->record(ns, error);
+		}
+	}
+
+private:
+	static std::atomic<TelemetryHeader *> &segment() {
+		static std::atomic<TelemetryHeader *> header{ nullptr };
+		return header;
+	}
+
+	static TelemetrySlot *&modSlot() {
+		static TelemetrySlot *slot = nullptr;
+		return slot;
+	}
+
+	//Returns nullptr without waiting if `wait` is false and the createLock is taken
+	static TelemetrySlot *findOrClaim(TelemetryHeader *header, TelemetrySlotKind kind, uint64_t id, const char *name, bool wait) {
+		if (header == nullptr) {
+			return nullptr;
+		}
+
+		if (wait) {
+			TelemetrySegment::lock(header);
+		}
+		else if (!TelemetrySegment::tryLock(header)) {
+			return nullptr;
+		}
+		TelemetrySlot *slots = TelemetrySegment::slots(header);
+		uint32_t used = header->usedSlots.load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < used; ++i) {
+			bool sameMod = kind == TelemetrySlotKind::Mod && strncmp(slots[i].name, name, sizeof(slots[i].name) - 1) == 0;
+			if (slots[i].kind == kind && slots[i].id == id && (kind != TelemetrySlotKind::Mod || sameMod)) {
+				TelemetrySegment::unlock(header);
+				return &slots[i];
+			}
+		}
+
+		TelemetrySlot *slot = nullptr;
+		if (used < header->slotCount) {
+			slot = &slots[used];
+			slot->claim(kind, id, name);
+			header->usedSlots.store(used + 1, std::memory_order_release);
+		}
+		TelemetrySegment::unlock(header);
+		return slot;
+	}
+};
+
+//Times one run of a hook and records it against the hook and the mod that bound it
+class TelemetryScope {
+public:
+	explicit TelemetryScope(TelemetryHook &hook) {
+		if (Telemetry::isEnabled()) {
+			mHook = &hook;
+			mExceptions = std::uncaught_exceptions();
+			mStart = std::chrono::steady_clock::now();
+		}
+	}
+
+	~TelemetryScope() {
+		if (mHook != nullptr) {
+			uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStart).count();
+			Telemetry::record(*mHook, ns, std::uncaught_exceptions() > mExceptions);
+		}
+	}
+
+	TelemetryScope(const TelemetryScope &) = delete;
+	TelemetryScope &operator=(const TelemetryScope &) = delete;
+
+private:
+	TelemetryHook *mHook = nullptr;
+	int mExceptions = 0;
+	std::chrono::steady_clock::time_point mStart;
+};
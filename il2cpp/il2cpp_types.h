@@ -22,6 +22,7 @@ namespace internal {
     struct Il2CppImage {};
     struct Il2CppAssembly {};
     struct Il2CppDomain {};
+    struct Il2CppThread {};
 
     struct Il2CppObject {
         void *ptr;
@@ -169,6 +170,9 @@ namespace il2cppapi {
 			return Field<T>(ctx, internal::Il2CppObject{ nullptr }, internalField);
 		}
 
+		//Byte offset of an instance field from the start of the object, for use with raw/bulk reads
+		size_t fieldOffset(const char *fieldName) const;
+
 		operator internal::Il2CppClass*() {
 			return klass;
 		}
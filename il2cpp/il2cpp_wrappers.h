@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "il2cpp_types.h"
+#include "il2cpp_context.h"
+
+//Runtime support for the typed wrappers generated by tools/il2cpp_wrapgen.
+//A generated wrapper is a TypedObject with accessors for every instance field at a constexpr offset and a
+//MethodSlot per method. Call the generated `bind(ctx)` (or il2cpp_gen::bindAll(ctx)) once after the context is up;
+//it resolves the class, checks the dumped offsets against the running game and fills the method slots.
+//
+//	auto keeper = il2cpp_gen::ScoreKeeper(ths);
+//	int32_t score = keeper.mScore();	//A single load from ptr + constexpr offset
+//	keeper.AddScore(10);				//One indirect call through the bound slot
+namespace il2cppapi {
+	struct TypedObject {
+		void *ptr;
+
+		TypedObject(void *ptr = nullptr) : ptr(ptr) {}
+		TypedObject(internal::Il2CppObject obj) : ptr(obj.ptr) {}
+		TypedObject(const Object &obj) : ptr(obj.ptr) {}
+
+		explicit operator bool() const {
+			return ptr != nullptr;
+		}
+
+		operator internal::Il2CppObject() const {
+			return internal::Il2CppObject{ ptr };
+		}
+
+	protected:
+		template<typename T, size_t Offset>
+		T load() const {
+			return *reinterpret_cast<const T *>(static_cast<const uint8_t *>(ptr) + Offset);
+		}
+
+		template<typename T, size_t Offset>
+		void store(const T &value) const {
+			*reinterpret_cast<T *>(static_cast<uint8_t *>(ptr) + Offset) = value;
+		}
+
+		//Reference typed fields are stored as object pointers and handed out as their wrapper
+		template<typename Wrapper, size_t Offset>
+		Wrapper loadObject() const {
+			return Wrapper(load<void *, Offset>());
+		}
+	};
+
+	template<typename Fn>
+	struct MethodSlot;
+
+	//Instance method pointer, resolved once by the generated bind()
+	template<typename Ret, typename... Args>
+	struct MethodSlot<Ret(Args...)> {
+		typename function_traits<Ret(Args...)>::PtrType fn = nullptr;
+
+		bool bind(const Class &klass, const char *methodName) {
+			fn = klass.method<Ret(Args...)>(methodName);
+			return fn != nullptr;
+		}
+	};
+
+	template<typename Fn>
+	struct StaticMethodSlot;
+
+	template<typename Ret, typename... Args>
+	struct StaticMethodSlot<Ret(Args...)> {
+		typename function_traits<Ret(Args...)>::StaticPtrType fn = nullptr;
+
+		bool bind(const Class &klass, const char *methodName) {
+			fn = klass.static_method<Ret(Args...)>(methodName);
+			return fn != nullptr;
+		}
+	};
+
+	//The dump is only valid for the game build it came from, so bind() checks every offset it bakes in
+	inline bool verifyFieldOffset(const Class &klass, const char *className, const char *fieldName, size_t expected) {
+		size_t actual = klass.fieldOffset(fieldName);
+		if (actual != expected) {
+			printf("ERROR: il2cpp_wrapgen: %s::%s is at offset 0x%zx, but the wrappers were generated with 0x%zx! Regenerate them for this game version\n",
+				className, fieldName, actual, expected);
+			return false;
+		}
+		return true;
+	}
+}
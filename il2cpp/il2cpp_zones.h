@@ -0,0 +1,353 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+//Scoped timing zones, written as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+//
+//	Zones::start("C:\\traces\\mymod.json");
+//	...
+//	void onNoteHit(...) {
+//		ZONE("Score update");
+//		...
+//	}
+//	...
+//	Zones::stop();
+//
+//Every hook dispatch is wrapped in a zone named after its method, resolved when the hook is bound. Zones are recorded into per-thread chunks
+//and only written out by flush/stop. While tracing is off a zone costs one relaxed load and branch; while it is on,
+//two timestamp reads (rdtsc on x86-64) and a store into the thread's chunk.
+//Names must outlive the trace, string literals are the intended use. Every mod has its own trace file.
+//Define AUDICA_DISABLE_ZONES to compile ZONE out entirely.
+
+struct ZoneEvent {
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+};
+
+class Zones {
+public:
+	//Starts recording into `path`, replacing the file
+	static bool start(const char *path) {
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		if (registry().file != nullptr) {
+			return true;
+		}
+
+		registry().file = fopen(path, "w");
+		if (registry().file == nullptr) {
+			printf("ERROR: Zones: Could not open %s for writing!\n", path);
+			return false;
+		}
+
+		calibrate();
+
+		//Drop anything recorded by zones that were still open when a previous trace stopped
+		for (auto &chunk : registry().full) {
+			registry().spare.push_back(std::move(chunk));
+		}
+		registry().full.clear();
+		for (ThreadState *thread : registry().threads) {
+			thread->chunk->flushed = thread->chunk->count.load(std::memory_order_acquire);
+		}
+
+		fputs("[\n", registry().file);
+		registry().firstEvent = true;
+		enabled().store(true, std::memory_order_release);
+		return true;
+	}
+
+	//Flushes everything recorded and closes the trace
+	static void stop() {
+		enabled().store(false, std::memory_order_release);
+
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		if (registry().file == nullptr) {
+			return;
+		}
+
+		flushLocked();
+		fputs("\n]\n", registry().file);
+		fclose(registry().file);
+		registry().file = nullptr;
+	}
+
+	//Writes every zone finished so far, e.g. once a frame or on a timer
+	static void flush() {
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		flushLocked();
+	}
+
+	static bool isEnabled() {
+		return enabled().load(std::memory_order_relaxed);
+	}
+
+	//Raw timestamp, converted to time when the trace is written
+	static uint64_t now() {
+#if defined(_M_X64) || defined(__x86_64__)
+		return __rdtsc();
+#else
+		return steadyNs();
+#endif
+	}
+
+	static void record(const char *name, uint64_t begin, uint64_t end) {
+		ThreadState &state = threadState();
+		Chunk *chunk = state.chunk;
+		uint32_t count = chunk->count.load(std::memory_order_relaxed);
+		if (count == Chunk::Capacity) {
+			chunk = state.replaceChunk();
+			count = 0;
+		}
+
+		chunk->events[count] = { name, begin, end };
+		chunk->count.store(count + 1, std::memory_order_release);
+	}
+
+	//Copy of `name` that lives as long as the process, for zone names built at runtime such as a hook's
+	//Class::method. Equal names share one copy. Takes a lock, so resolve names once up front (the binding does it
+	//when a hook is bound) and keep the pointer
+	static const char *intern(const char *name) {
+		std::lock_guard<std::mutex> lock(internedNames().mutex);
+		auto &names = internedNames().names;
+		auto it = names.find(name);
+		if (it == names.end()) {
+			it = names.emplace(name, std::make_unique<std::string>(name)).first;
+		}
+		return it->second->c_str();
+	}
+
+	//Name for a hook dispatch zone whose node was never named
+	static const char *nameOr(const char *name) {
+		return name != nullptr ? name : "Hook dispatch";
+	}
+
+private:
+	//Written by its thread only; flush reads the published prefix [flushed, count)
+	struct Chunk {
+		static const uint32_t Capacity = 4096;
+
+		std::atomic<uint32_t> count{ 0 };
+		uint32_t flushed = 0;
+		uint32_t threadId = 0;
+		ZoneEvent events[Capacity];
+	};
+
+	struct ThreadState;
+
+	struct Registry {
+		std::mutex mutex;
+		FILE *file = nullptr;
+		bool firstEvent = true;
+		uint64_t startTicks = 0;
+		double nsPerTick = 1.0;
+		uint32_t nextThreadId = 1;
+		std::vector<ThreadState *> threads;
+		std::vector<std::unique_ptr<Chunk>> full;
+		std::vector<std::unique_ptr<Chunk>> spare;
+	};
+
+	struct ThreadState {
+		Chunk *chunk = nullptr;
+		uint32_t threadId = 0;
+
+		ThreadState() {
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			threadId = registry().nextThreadId++;
+			chunk = takeChunkLocked(threadId);
+			registry().threads.push_back(this);
+		}
+
+		~ThreadState() {
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			auto &threads = registry().threads;
+			threads.erase(std::remove(threads.begin(), threads.end(), this), threads.end());
+			registry().full.emplace_back(chunk);
+		}
+
+		Chunk *replaceChunk() {
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			registry().full.emplace_back(chunk);
+			chunk = takeChunkLocked(threadId);
+			return chunk;
+		}
+	};
+
+	static std::atomic<bool> &enabled() {
+		static std::atomic<bool> on{ false };
+		return on;
+	}
+
+	static Registry &registry() {
+		static Registry *instance = new Registry();	//Leaked so thread exit after static destruction still works
+		return *instance;
+	}
+
+	struct InternedNames {
+		std::mutex mutex;
+		std::unordered_map<std::string, std::unique_ptr<std::string>> names;
+	};
+
+	static InternedNames &internedNames() {
+		static InternedNames *names = new InternedNames();	//Leaked like the registry, chunks still point into it
+		return *names;
+	}
+
+	static ThreadState &threadState() {
+		thread_local ThreadState state;
+		return state;
+	}
+
+	static Chunk *takeChunkLocked(uint32_t threadId) {
+		Chunk *chunk;
+		if (!registry().spare.empty()) {
+			chunk = registry().spare.back().release();
+			registry().spare.pop_back();
+		}
+		else {
+			chunk = new Chunk();
+		}
+
+		chunk->count.store(0, std::memory_order_relaxed);
+		chunk->flushed = 0;
+		chunk->threadId = threadId;
+		return chunk;
+	}
+
+	static uint64_t steadyNs() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//Measures the timestamp rate against steady_clock, trace times are relative to the start
+	static void calibrate() {
+		Registry &reg = registry();
+		uint64_t ticks = now();
+		uint64_t ns = steadyNs();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		uint64_t elapsedTicks = now() - ticks;
+		uint64_t elapsedNs = steadyNs() - ns;
+
+		reg.startTicks = ticks;
+		reg.nsPerTick = elapsedTicks != 0 ? (double)elapsedNs / elapsedTicks : 1.0;
+	}
+
+	static uint32_t processId() {
+#ifdef _WIN32
+		return (uint32_t)GetCurrentProcessId();
+#else
+		return (uint32_t)getpid();
+#endif
+	}
+
+	static void writeEvents(Chunk &chunk, uint32_t end) {
+		Registry &reg = registry();
+		uint32_t pid = processId();
+		for (uint32_t i = chunk.flushed; i < end; ++i) {
+			const ZoneEvent &event = chunk.events[i];
+			fputs(reg.firstEvent ? "" : ",\n", reg.file);
+			reg.firstEvent = false;
+
+			fputs("{\"name\":\"", reg.file);
+			for (const char *c = event.name; *c; ++c) {
+				if (*c == '"' || *c == '\\') {
+					fputc('\\', reg.file);
+				}
+				fputc((unsigned char)*c < 0x20 ? ' ' : *c, reg.file);
+			}
+			double beginUs = (double)(int64_t)(event.begin - reg.startTicks) * reg.nsPerTick / 1000.0;
+			double durationUs = (double)(event.end - event.begin) * reg.nsPerTick / 1000.0;
+			fprintf(reg.file, "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u}",
+				beginUs, durationUs, pid, chunk.threadId);
+		}
+		chunk.flushed = end;
+	}
+
+	static void flushLocked() {
+		Registry &reg = registry();
+		if (reg.file == nullptr) {
+			return;
+		}
+
+		for (auto &chunk : reg.full) {
+			writeEvents(*chunk, chunk->count.load(std::memory_order_acquire));
+			reg.spare.push_back(std::move(chunk));
+		}
+		reg.full.clear();
+
+		for (ThreadState *thread : reg.threads) {
+			writeEvents(*thread->chunk, thread->chunk->count.load(std::memory_order_acquire));
+		}
+		fflush(reg.file);
+	}
+};
+
+class ZoneScope {
+public:
+	explicit ZoneScope(const char *name) {
+		if (Zones::isEnabled()) {
+			mName = name;
+			mBegin = Zones::now();
+		}
+	}
+
+	//`name` is only called while tracing
+	template<typename GetName, typename = std::enable_if_t<std::is_invocable_r_v<const char *, GetName>>>
+	explicit ZoneScope(GetName &&name) {
+		if (Zones::isEnabled()) {
+			mName = name();
+			mBegin = Zones::now();
+		}
+	}
+
+	~ZoneScope() {
+		if (mName != nullptr) {
+			finish();
+		}
+	}
+
+	ZoneScope(const ZoneScope &) = delete;
+	ZoneScope &operator=(const ZoneScope &) = delete;
+
+private:
+	//Kept out of line so the disabled path stays small enough to inline
+	__declspec(noinline) void finish() {
+		Zones::record(mName, mBegin, Zones::now());
+	}
+
+	const char *mName = nullptr;
+	uint64_t mBegin = 0;
+};
+
+#define ZONE_CONCAT_INNER(a, b) a##b
+#define ZONE_CONCAT(a, b) ZONE_CONCAT_INNER(a, b)
+
+#ifdef AUDICA_DISABLE_ZONES
+#define ZONE(name)
+#else
+#define ZONE(name) ZoneScope ZONE_CONCAT(zoneScope, __LINE__)(name)
+#endif
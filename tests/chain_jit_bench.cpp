@@ -0,0 +1,106 @@
+//Chain dispatch cost interpreted by the loader versus through a HookChainJit stub, and exceptions unwinding through stubs
+//	cl /std:c++20 /EHsc /O2 chain_jit_bench.cpp ..\il2cpp\il2cpp_context.cpp
+#include <stdexcept>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+#include "../il2cpp/il2cpp_chain_jit.h"
+
+static int32_t __thiscall getScore(void *, int32_t base) {
+	if (base == -1) {
+		throw std::runtime_error("original threw");
+	}
+	return base * 10;
+}
+
+//What the loader does after every chain change
+static bool rebuild(FakeLoader &loader, FakeLoader::Method &m) {
+	std::vector<const il2cpp_binding::HookCall *> chain;
+	for (auto &call : m.chain) {
+		chain.push_back(call.get());
+	}
+	return HookChainJit::rebuild(loader, *m.chain.front(), chain.data(), chain.size());
+}
+
+int main() {
+	if (!HookChainJit::isSupported()) {
+		printf("chain_jit_bench: skipped, HookChainJit does not support this architecture\n");
+		return 0;
+	}
+
+	FakeLoader loader;
+	loader.defineMethod("", "Player", "GetScore", &getScore);
+	loader.routeSingleHooks = false;
+	FakeLoader::Method &getScoreMethod = loader.method("", "Player", "GetScore");
+	FakeObject player;
+	const uint32_t iterations = 200000;
+
+	uint64_t beforeRuns = 0;
+	uint64_t afterRuns = 0;
+	for (int i = 0; i < 3; ++i) {
+		loader.bindClassFunction("", "Player", "GetScore", InvokeTime::Before, i, [&beforeRuns](const MethodInvocationContext &, ThisPtr, int32_t base) -> std::optional<int32_t> {
+			++beforeRuns;
+			if (base == 13) {
+				throw std::runtime_error("before hook threw");
+			}
+			return std::nullopt;
+		});
+	}
+	loader.bindClassFunction("", "Player", "GetScore", InvokeTime::After, -1, [&afterRuns](const MethodInvocationContext &ctx, ThisPtr, int32_t base) -> std::optional<int32_t> {
+		++afterRuns;
+		if (base == 14) {
+			throw std::runtime_error("after hook threw");
+		}
+		return ctx.getReturn<int32_t>() + 1;
+	});
+
+	auto call = [&](int32_t base) {
+		return loader.callMember<int32_t>(getScoreMethod, &player, base);
+	};
+
+	double interpretedNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call((int32_t)(i & 7))); });
+	TEST_CHECK(call(2) == 21);
+
+	TEST_CHECK(rebuild(loader, getScoreMethod));
+	uint64_t dispatches = getScoreMethod.chainDispatches;
+	double compiledNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call((int32_t)(i & 7))); });
+	TEST_CHECK(getScoreMethod.chainDispatches == dispatches);
+	TEST_CHECK(call(2) == 21);
+
+	printf("4 hooks: interpreted %.1f ns/call, compiled %.1f ns/call\n", interpretedNs, compiledNs);
+
+	//Exceptions from a Before hook, an After hook and the original all unwind through the stub to the caller
+	const int32_t throwing[] = { 13, 14, -1 };
+	for (int32_t base : throwing) {
+		bool caught = false;
+		try {
+			call(base);
+		}
+		catch (const std::runtime_error &) {
+			caught = true;
+		}
+		TEST_CHECK(caught);
+		TEST_CHECK(call(2) == 21);
+	}
+	TEST_CHECK(getScoreMethod.chainDispatches == dispatches);
+
+	//Replaced stubs are freed by later dispatches, not only by the next rebuild
+	for (int i = 0; i < 100; ++i) {
+		TEST_CHECK(rebuild(loader, getScoreMethod));
+		call(2);
+	}
+	call(2);
+	call(2);
+	TEST_CHECK(HookReclaimer::sharedRetired()->count.load() <= 1);
+
+	//Without a stub the loader's chain runs again
+	HookChainJit::clear(*getScoreMethod.chain.front());
+	TEST_CHECK(call(2) == 21);
+	TEST_CHECK(getScoreMethod.chainDispatches == dispatches + 1);
+	call(2);
+	call(2);
+	TEST_CHECK(HookReclaimer::sharedRetired()->count.load() == 0);
+	TEST_CHECK(beforeRuns > 0 && afterRuns > 0);
+
+	return testResult("chain_jit_bench");
+}
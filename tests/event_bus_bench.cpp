@@ -0,0 +1,183 @@
+//Publish throughput of the event bus, and unsubscribing from the places a subscription may be destroyed
+//	cl /std:c++20 /EHsc /O2 event_bus_bench.cpp ..\il2cpp\il2cpp_context.cpp
+#include <thread>
+#include <vector>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+#include "../il2cpp/il2cpp_event_bus.h"
+
+struct NoteHit {
+	int32_t cue;
+	float accuracy;
+};
+
+int main() {
+	FakeLoader loader;
+	EventBus bus(loader);
+	auto topic = bus.topic<NoteHit>("Audica.NoteHit");
+	TEST_CHECK(topic.isValid());
+	TEST_CHECK(!bus.topic<int32_t>("Audica.NoteHit").isValid());
+	const uint32_t iterations = 1000000;
+
+	//Publishing with nobody listening
+	double emptyNs = benchNs(iterations, [&](uint32_t i) { topic.publish({ (int32_t)i, 1.0f }); });
+
+	//One queued subscriber, drained by a consumer thread
+	auto queued = topic.subscribe(1024, BackpressurePolicy::DropOldest);
+	TEST_CHECK(queued != nullptr);
+	std::atomic<bool> stop{ false };
+	std::atomic<uint64_t> consumed{ 0 };
+	std::thread consumer([&]() {
+		while (!stop.load()) {
+			consumed.fetch_add(queued->poll([](const NoteHit &) {}));
+		}
+	});
+	double queuedNs = benchNs(iterations, [&](uint32_t i) { topic.publish({ (int32_t)i, 1.0f }); });
+	stop.store(true);
+	consumer.join();
+	consumed.fetch_add(queued->poll([](const NoteHit &) {}));
+	TEST_CHECK(consumed.load() + queued->droppedCount() == iterations + iterations / 10 + 1);
+
+	//A callback subscriber on the publishing thread
+	uint64_t delivered = 0;
+	auto direct = topic.subscribe([&delivered](const NoteHit &) { ++delivered; });
+	double directNs = benchNs(iterations, [&](uint32_t i) { topic.publish({ (int32_t)i, 1.0f }); });
+	TEST_CHECK(delivered == iterations + iterations / 10 + 1);
+
+	printf("no subscribers %.1f ns/publish, queued %.1f ns/publish, queued + callback %.1f ns/publish\n", emptyNs, queuedNs, directNs);
+	queued.reset();
+	direct.reset();
+
+	//Throughput with 1 to 8 blocking subscribers, each drained by its own consumer thread, so every event reaches
+	//every subscriber
+	const uint32_t sweepEvents = 200000;
+	for (uint32_t subscribers : { 1u, 2u, 4u, 8u }) {
+		std::vector<std::unique_ptr<EventSubscription<NoteHit>>> subscriptions;
+		for (uint32_t i = 0; i < subscribers; ++i) {
+			subscriptions.push_back(topic.subscribe(4096, BackpressurePolicy::Block));
+		}
+
+		std::atomic<uint64_t> received{ 0 };
+		std::atomic<uint64_t> outOfOrder{ 0 };
+		std::vector<std::thread> consumers;
+		for (auto &subscription : subscriptions) {
+			consumers.emplace_back([&, sub = subscription.get()]() {
+				int32_t expected = 0;
+				uint64_t count = 0;
+				while (count < sweepEvents) {
+					uint32_t handled = sub->poll([&](const NoteHit &hit) {
+						outOfOrder.fetch_add(hit.cue != expected++ ? 1 : 0, std::memory_order_relaxed);
+					});
+					count += handled;
+					if (handled == 0) {
+						std::this_thread::yield();
+					}
+				}
+				received.fetch_add(count);
+			});
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < sweepEvents; ++i) {
+			topic.publish({ (int32_t)i, 1.0f });
+		}
+		for (auto &consumer : consumers) {
+			consumer.join();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		printf("%u subscriber(s): %.2f M events/s published, %.2f M deliveries/s\n", subscribers, sweepEvents / seconds / 1e6, (double)received.load() / seconds / 1e6);
+		TEST_CHECK(received.load() == (uint64_t)sweepEvents * subscribers);
+		TEST_CHECK(outOfOrder.load() == 0);
+		for (auto &subscription : subscriptions) {
+			TEST_CHECK(subscription->droppedCount() == 0);
+		}
+	}
+
+	//A publisher blocked on a full subscriber doesn't hold up reclamation meanwhile: a sink unsubscribed from another
+	//topic while it waits is freed before it is released
+	{
+		auto blocking = topic.subscribe(2, BackpressurePolicy::Block);
+		auto other = bus.topic<NoteHit>("Audica.Other").subscribe([](const NoteHit &) {});
+		topic.publish({ 0, 1.0f });
+		topic.publish({ 1, 1.0f });
+
+		std::atomic<bool> published{ false };
+		std::thread blocked([&]() {
+			topic.publish({ 2, 1.0f });
+			published.store(true);
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		TEST_CHECK(!published.load());
+
+		other.reset();
+		for (int i = 0; i < 100 && HookReclaimer::global().pendingCount() != 0; ++i) {
+			HookReclaimer::global().collect();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		TEST_CHECK(HookReclaimer::global().pendingCount() == 0);
+		TEST_CHECK(!published.load());
+
+		NoteHit hit;
+		TEST_CHECK(blocking->tryPop(hit) && hit.cue == 0);
+		blocked.join();
+		TEST_CHECK(published.load());
+		TEST_CHECK(blocking->tryPop(hit) && hit.cue == 1);
+		TEST_CHECK(blocking->tryPop(hit) && hit.cue == 2);
+
+		//Unsubscribing releases a publisher still waiting on the sink
+		topic.publish({ 3, 1.0f });
+		topic.publish({ 4, 1.0f });
+		std::thread waiting([&]() {
+			topic.publish({ 5, 1.0f });
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		blocking.reset();
+		waiting.join();
+	}
+
+	//A callback that destroys its own subscription: the delivery in progress finishes, nothing deadlocks
+	std::unique_ptr<EventCallbackSubscription<NoteHit>> once;
+	int onceRuns = 0;
+	once = topic.subscribe([&](const NoteHit &) {
+		++onceRuns;
+		once.reset();
+	});
+	topic.publish({ 1, 1.0f });
+	topic.publish({ 2, 1.0f });
+	TEST_CHECK(onceRuns == 1);
+	TEST_CHECK(once == nullptr);
+
+	//A subscription destroyed by another subscriber on the same topic while publishing
+	int victimRuns = 0;
+	auto victim = topic.subscribe([&](const NoteHit &) { ++victimRuns; });
+	auto killer = topic.subscribe([&](const NoteHit &) { victim.reset(); });
+	topic.publish({ 3, 1.0f });
+	topic.publish({ 4, 1.0f });
+	TEST_CHECK(victimRuns <= 1);
+	TEST_CHECK(victim == nullptr);
+	killer.reset();
+
+	//Subscriptions destroyed on one thread while another keeps publishing
+	std::atomic<bool> publishing{ true };
+	std::thread publisher([&]() {
+		while (publishing.load()) {
+			topic.publish({ 5, 1.0f });
+		}
+	});
+	for (int i = 0; i < 2000; ++i) {
+		auto churn = topic.subscribe(16, BackpressurePolicy::Block);
+		auto churnDirect = topic.subscribe([](const NoteHit &) {});
+		std::this_thread::yield();
+	}
+	publishing.store(false);
+	publisher.join();
+
+	//Nothing retired is left behind once no publisher is running
+	HookReclaimer::global().collect();
+	HookReclaimer::global().collect();
+	TEST_CHECK(HookReclaimer::global().pendingCount() == 0);
+
+	return testResult("event_bus_bench");
+}
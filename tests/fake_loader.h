@@ -0,0 +1,392 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../il2cpp/il2cpp_context.h"
+#include "../il2cpp/il2cpp_binding.h"
+
+//In-process stand-in for the mod loader, so tests can bind hooks and dispatch calls without the game.
+//
+//	FakeLoader loader;
+//	loader.defineMethod("", "Target", "GetScore", &getScore);
+//	loader.bindClassFunction("", "Target", "GetScore", InvokeTime::Before, ...);
+//	float score = loader.callMember<float>("", "Target", "GetScore", target, 3);
+//
+//Follows the loader contract documented in il2cpp_binding.h: chains are ordered by descending priority and
+//linked through MethodHookNode::next, chainHead is kept on the routed HookCall, an empty chain calls the original,
+//and a single node chain is routed through invokeSingleFn (unless routeSingleHooks is off).
+
+//Fake managed object header, for `this` and plain objects
+struct FakeObject {
+	void *klass = nullptr;
+	void *monitor = nullptr;
+};
+
+//Fake managed object array, laid out the way the binding reads it: a 0x20 byte header with the length at 0x18,
+//followed by the elements
+template<typename T>
+class FakeArray {
+public:
+	explicit FakeArray(uint32_t length) : mStorage(HeaderSize + sizeof(T) * length) {
+		uint64_t len = length;
+		std::memcpy(mStorage.data() + 0x18, &len, sizeof(len));
+	}
+
+	T &operator[](uint32_t idx) {
+		return reinterpret_cast<T *>(mStorage.data() + HeaderSize)[idx];
+	}
+
+	void *ptr() {
+		return mStorage.data();
+	}
+
+private:
+	static const size_t HeaderSize = 0x20;
+
+	std::vector<uint8_t> mStorage;
+};
+
+class FakeContext : public il2cpp_context {
+public:
+	FakeContext() {
+		mGetBinding = []() -> il2cpp_binding & { return *instance()->mBinding; };
+		il2cpp_array_length = [](internal::Il2CppObject arr) -> uint32_t {
+			uint64_t length;
+			std::memcpy(&length, static_cast<const uint8_t *>(arr.ptr) + 0x18, sizeof(length));
+			return (uint32_t)length;
+		};
+		il2cpp_class_get_field_from_name = [](internal::Il2CppClass *klass, const char *name) -> internal::FieldInfo * {
+			return instance()->findField(klass, name);
+		};
+		il2cpp_field_get_offset = [](const internal::FieldInfo *field) -> size_t {
+			return reinterpret_cast<const Field *>(field)->offset;
+		};
+		il2cpp_field_get_value = [](internal::Il2CppObject obj, const internal::FieldInfo *field, void *value) {
+			const Field *f = reinterpret_cast<const Field *>(field);
+			std::memcpy(value, static_cast<const uint8_t *>(obj.ptr) + f->offset, f->size);
+		};
+		il2cpp_domain_get = []() -> internal::Il2CppDomain * {
+			static internal::Il2CppDomain domain;
+			return &domain;
+		};
+		il2cpp_thread_attach = [](internal::Il2CppDomain *) -> internal::Il2CppThread * {
+			instance()->attachedThreads.fetch_add(1);
+			isThreadAttached() = true;
+			return new internal::Il2CppThread();
+		};
+		il2cpp_thread_detach = [](internal::Il2CppThread *thread) {
+			instance()->attachedThreads.fetch_sub(1);
+			isThreadAttached() = false;
+			delete thread;
+		};
+	}
+
+	//Whether the calling thread went through il2cpp_thread_attach
+	static bool &isThreadAttached() {
+		thread_local bool attached = false;
+		return attached;
+	}
+
+	static FakeContext *&instance() {
+		static FakeContext *ctx = nullptr;
+		return ctx;
+	}
+
+	void addField(internal::Il2CppClass *klass, const char *name, size_t offset, size_t size) {
+		mFields.push_back(std::make_unique<Field>(Field{ {}, klass, name, offset, size }));
+	}
+
+	//Pretends to be a loader from before il2cpp_field_get_offset was added to the table
+	void dropFieldOffsetEntry() {
+		il2cpp_field_get_offset = nullptr;
+	}
+
+	il2cpp_binding *mBinding = nullptr;
+
+	//Threads currently attached through il2cpp_thread_attach
+	std::atomic<int> attachedThreads{ 0 };
+
+private:
+	struct Field {
+		internal::FieldInfo info;
+		internal::Il2CppClass *klass;
+		std::string name;
+		size_t offset;
+		size_t size;
+	};
+
+	internal::FieldInfo *findField(internal::Il2CppClass *klass, const char *name) {
+		for (auto &field : mFields) {
+			if (field->klass == klass && field->name == name) {
+				return &field->info;
+			}
+		}
+		return nullptr;
+	}
+
+	std::vector<std::unique_ptr<Field>> mFields;
+};
+
+class FakeLoader : public il2cpp_binding {
+public:
+	struct Method {
+		void *originalFn = nullptr;
+		std::vector<std::unique_ptr<HookCall>> chain;
+		uint64_t chainDispatches = 0;
+	};
+
+	FakeLoader() {
+		FakeContext::instance() = &mContext;
+		mContext.mBinding = this;
+
+		InvokeFunctionChain = &invokeChain;
+		GetIL2CPPContext = &loaderContext;
+		AddHookCall = &addHookCall;
+		RemoveHookCall = &removeHookCall;
+		GetSharedData = &sharedData;
+		GetActiveHookCall = &activeHookCall;
+	}
+
+	~FakeLoader() {
+		//The epoch lives in this loader's shared data, a loader created after this one attaches its own
+		auto epoch = mSharedData.find("HookEpochState");
+		if (epoch != mSharedData.end() && HookReclaimer::sharedState() == epoch->second) {
+			HookReclaimer::sharedState() = nullptr;
+			HookReclaimer::sharedRetired() = nullptr;
+		}
+
+		for (auto &data : mSharedData) {
+			::operator delete(data.second, std::align_val_t(64));
+		}
+	}
+
+	FakeContext &context() {
+		return mContext;
+	}
+
+	//Pretends to be a loader that leaves GetActiveHookCall empty
+	void dropActiveHookCallEntry() {
+		GetActiveHookCall = nullptr;
+	}
+
+	template<typename Fn>
+	void defineMethod(const char *namespaceName, const char *className, const char *methodName, Fn *originalFn) {
+		method(namespaceName, className, methodName).originalFn = reinterpret_cast<void *>(originalFn);
+	}
+
+	Method &method(const char *namespaceName, const char *className, const char *methodName) {
+		return mMethods[std::string(namespaceName) + "." + className + "::" + methodName];
+	}
+
+	//Calls the hooked method the way the game would, through whatever the loader currently routes it to
+	template<typename Ret, typename... Args>
+	Ret callMember(Method &m, void *ths, Args... args) {
+		ActiveScope scope(m.chain.empty() ? nullptr : m.chain.front().get());
+		return reinterpret_cast<Ret(__thiscall *)(void *, Args...)>(entry(m))(ths, args...);
+	}
+
+	template<typename Ret, typename... Args>
+	Ret callStatic(Method &m, Args... args) {
+		ActiveScope scope(m.chain.empty() ? nullptr : m.chain.front().get());
+		return reinterpret_cast<Ret(*)(Args...)>(entry(m))(args...);
+	}
+
+	template<typename Ret, typename... Args>
+	Ret callMember(const char *namespaceName, const char *className, const char *methodName, void *ths, Args... args) {
+		return callMember<Ret, Args...>(method(namespaceName, className, methodName), ths, args...);
+	}
+
+	template<typename Ret, typename... Args>
+	Ret callStatic(const char *namespaceName, const char *className, const char *methodName, Args... args) {
+		return callStatic<Ret, Args...>(method(namespaceName, className, methodName), args...);
+	}
+
+	//How often InvokeFunctionChain ran for the method, i.e. calls that paid for the full chain dispatch
+	uint64_t chainDispatches(const char *namespaceName, const char *className, const char *methodName) {
+		return method(namespaceName, className, methodName).chainDispatches;
+	}
+
+	//Calls into AddHookCall, RemoveHookCall or GetSharedData that started while another one was still running.
+	//The real loader's table isn't thread safe, so this must stay 0
+	uint64_t overlappingLoaderCalls() const {
+		return mOverlappingCalls.load();
+	}
+
+	//Whether GetIL2CPPContext, AddHookCall, RemoveHookCall and GetSharedData are the ones this loader installed,
+	//i.e. nothing that swapped them for a while left its own behind
+	bool ownsLoaderEntries() const {
+		return GetIL2CPPContext == &loaderContext && AddHookCall == &addHookCall && RemoveHookCall == &removeHookCall && GetSharedData == &sharedData;
+	}
+
+	bool ownsActiveHookCallEntry() const {
+		return GetActiveHookCall == &activeHookCall;
+	}
+
+	bool routeSingleHooks = true;
+
+private:
+	struct LoaderCallScope {
+		FakeLoader &loader;
+
+		explicit LoaderCallScope(FakeLoader &loader) : loader(loader) {
+			if (loader.mActiveCalls.fetch_add(1) != 0) {
+				loader.mOverlappingCalls.fetch_add(1);
+			}
+		}
+
+		~LoaderCallScope() {
+			loader.mActiveCalls.fetch_sub(1);
+		}
+	};
+
+	struct ActiveScope {
+		const HookCall *previous;
+
+		explicit ActiveScope(const HookCall *call) : previous(activeCall()) {
+			activeCall() = call;
+		}
+
+		~ActiveScope() {
+			activeCall() = previous;
+		}
+	};
+
+	static const HookCall *&activeCall() {
+		thread_local const HookCall *call = nullptr;
+		return call;
+	}
+
+	static FakeLoader &self(il2cpp_binding &bnd) {
+		return static_cast<FakeLoader &>(bnd);
+	}
+
+	void *entry(Method &m) {
+		if (m.chain.empty()) {
+			return m.originalFn;
+		}
+		if (m.chain.size() == 1 && routeSingleHooks) {
+			return m.chain.front()->invokeSingleFn;
+		}
+		return m.chain.front()->invokeFn;
+	}
+
+	Method *methodOf(const HookCall *call) {
+		for (auto &entry : mMethods) {
+			for (auto &chained : entry.second.chain) {
+				if (chained.get() == call) {
+					return &entry.second;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	static void relink(Method &m) {
+		std::stable_sort(m.chain.begin(), m.chain.end(), [](const std::unique_ptr<HookCall> &a, const std::unique_ptr<HookCall> &b) {
+			return a->node->priority > b->node->priority;
+		});
+
+		for (size_t i = 0; i < m.chain.size(); ++i) {
+			m.chain[i]->node->next = i + 1 < m.chain.size() ? m.chain[i + 1]->node : nullptr;
+			m.chain[i]->originalFn = m.originalFn;
+		}
+
+		MethodHookNode *head = m.chain.empty() ? nullptr : m.chain.front()->node;
+		for (auto &call : m.chain) {
+			reinterpret_cast<std::atomic<MethodHookNode *> *>(&call->chainHead)->store(head, std::memory_order_release);
+		}
+	}
+
+	static void addHookCall(il2cpp_binding &bnd, const char *namespaceName, const char *className, const char *methodName, size_t, HookCall &&call) {
+		FakeLoader &loader = self(bnd);
+		LoaderCallScope scope(loader);
+		Method &m = loader.method(namespaceName, className, methodName);
+
+		call.id = ++loader.mNextId;
+		call.originalFn = m.originalFn;
+		m.chain.push_back(std::make_unique<HookCall>(call));
+		relink(m);
+	}
+
+	static const il2cpp_context &loaderContext(const il2cpp_binding &) {
+		return *FakeContext::instance();
+	}
+
+	static const HookCall *activeHookCall(const il2cpp_binding &) {
+		return activeCall();
+	}
+
+	static void removeHookCall(il2cpp_binding &bnd, MethodHookNode *node) {
+		LoaderCallScope scope(self(bnd));
+		for (auto &entry : self(bnd).mMethods) {
+			Method &m = entry.second;
+			auto it = std::find_if(m.chain.begin(), m.chain.end(), [node](const std::unique_ptr<HookCall> &call) { return call->node == node; });
+			if (it != m.chain.end()) {
+				m.chain.erase(it);
+				relink(m);
+				return;
+			}
+		}
+	}
+
+	static void *sharedData(il2cpp_binding &bnd, const char *name, size_t size) {
+		LoaderCallScope scope(self(bnd));
+		auto &data = self(bnd).mSharedData[name];
+		if (data == nullptr) {
+			data = ::operator new(size, std::align_val_t(64));
+			std::memset(data, 0, size);
+		}
+		return data;
+	}
+
+	//Before nodes, the original unless one stopped execution, then After nodes
+	static void invokeChain(MethodInvocationContext &ctx, std::optional<void *> ths) {
+		const HookCall *active = activeCall();
+		Method *m = self(*FakeContext::instance()->mBinding).methodOf(active);
+		if (m == nullptr) {
+			return;
+		}
+		++m->chainDispatches;
+
+		std::optional<ThisPtr> thisPtr;
+		if (ths) {
+			thisPtr = ThisPtr(internal::Il2CppObject{ *ths }, nullptr);
+		}
+
+		std::vector<const HookCall *> calls;
+		for (auto &call : m->chain) {
+			calls.push_back(call.get());
+		}
+
+		for (const HookCall *call : calls) {
+			if (call->node->invokeTime == InvokeTime::Before) {
+				call->invokeNodeFunction(ctx, thisPtr, call->node->data);
+				if (ctx.didStopExecution()) {
+					return;
+				}
+			}
+		}
+
+		active->invokeOriginalFunction(ctx, ths.value_or(nullptr), active->originalFn);
+
+		for (const HookCall *call : calls) {
+			if (call->node->invokeTime == InvokeTime::After) {
+				call->invokeNodeFunction(ctx, thisPtr, call->node->data);
+			}
+		}
+	}
+
+	FakeContext mContext;
+	std::map<std::string, Method> mMethods;
+	std::map<std::string, void *> mSharedData;
+	uint64_t mNextId = 0;
+	std::atomic<int> mActiveCalls{ 0 };
+	std::atomic<uint64_t> mOverlappingCalls{ 0 };
+};
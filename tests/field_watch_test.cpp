@@ -0,0 +1,222 @@
+//FieldWatcher against a reference model under random watch/unwatch/compact, field name resolution, the update hook, and
+//the per frame cost at 10k and 100k watched fields
+//	cl /std:c++20 /EHsc /O2 field_watch_test.cpp ..\il2cpp\il2cpp_context.cpp
+#include <map>
+#include <random>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+#include "../il2cpp/il2cpp_field_watch.h"
+
+using namespace il2cppapi;
+
+static void __thiscall update(void *) {}
+
+//What the watcher should report, kept as plain copies of the bytes last seen per id
+struct ModelWatch {
+	uint8_t *object;
+	size_t offset;
+	uint32_t size;
+	std::vector<uint8_t> seen;
+};
+
+struct Reported {
+	void *object;
+	size_t fieldOffset;
+	std::vector<uint8_t> previous;
+	std::vector<uint8_t> current;
+};
+
+//Per frame cost of update() over `watched` int fields, 8 per object: nothing changed, then 1% of the fields changed
+static void benchmark(uint32_t watched) {
+	const uint32_t ObjectSize = 96, FieldsPerObject = 8;
+	std::vector<uint8_t> arena((size_t)(watched / FieldsPerObject) * ObjectSize, 0);
+	auto field = [&](uint32_t index) {
+		return &arena[(size_t)(index / FieldsPerObject) * ObjectSize + 16 + (index % FieldsPerObject) * sizeof(int32_t)];
+	};
+
+	FieldWatcher watcher;
+	uint32_t reports = 0;
+	for (uint32_t i = 0; i < watched; ++i) {
+		uint8_t *at = field(i);
+		uint8_t *object = at - (at - arena.data()) % ObjectSize;
+		watcher.watch(object, at - object, sizeof(int32_t), [&reports](const FieldChange &) { ++reports; });
+	}
+	TEST_CHECK(watcher.watchedCount() == watched);
+
+	const uint32_t frames = 200;
+	double quietNs = benchNs(frames, [&](uint32_t) { benchKeep(watcher.update()); });
+	TEST_CHECK(reports == 0);
+
+	//Every frame writes a value no earlier frame wrote to fields no other write that frame touches
+	const uint32_t changes = watched / 100;
+	int32_t frame = 0;
+	bool allReported = true;
+	double changingNs = benchNs(frames, [&](uint32_t) {
+		++frame;
+		for (uint32_t k = 0; k < changes; ++k) {
+			std::memcpy(field((uint32_t)(((uint64_t)frame * changes + k) % watched)), &frame, sizeof(frame));
+		}
+		allReported &= watcher.update() == changes;
+	});
+	TEST_CHECK(allReported);
+	TEST_CHECK(reports == (uint32_t)frame * changes);
+
+	printf("%u watched: %.1f us/frame unchanged (%.2f ns/field), %.1f us/frame with %u changed\n",
+		watched, quietNs / 1000.0, quietNs / watched, changingNs / 1000.0, changes);
+}
+
+int main() {
+	FakeLoader loader;
+	FakeContext &ctx = loader.context();
+	loader.defineMethod("", "ScoreKeeper", "Update", &update);
+
+	const uint32_t ObjectSize = 96;
+	const uint32_t sizes[] = { 1, 2, 4, 8, 3, 12, 16, 24, 40 };
+	std::vector<std::unique_ptr<uint8_t[]>> objects(64);
+	for (auto &object : objects) {
+		object = std::make_unique<uint8_t[]>(ObjectSize);
+		std::memset(object.get(), 0, ObjectSize);
+	}
+
+	std::mt19937 rng(37);
+	auto random = [&rng](uint32_t bound) {
+		return (uint32_t)(rng() % bound);
+	};
+
+	FieldWatcher watcher;
+	std::map<uint32_t, ModelWatch> model;
+	std::map<uint32_t, Reported> reported;
+	uint32_t duplicateReports = 0;
+
+	auto watchRandom = [&]() {
+		uint8_t *object = objects[random((uint32_t)objects.size())].get();
+		uint32_t size = sizes[random(sizeof(sizes) / sizeof(sizes[0]))];
+		size_t offset = 16 + random(ObjectSize - 16 - size + 1);
+		uint32_t id = watcher.watch(object, offset, size, [&](const FieldChange &change) {
+			if (reported.count(change.id) != 0) {
+				++duplicateReports;
+			}
+			const uint8_t *previous = static_cast<const uint8_t *>(change.previous);
+			const uint8_t *current = static_cast<const uint8_t *>(change.current);
+			reported[change.id] = { change.object, change.fieldOffset,
+				std::vector<uint8_t>(previous, previous + change.size), std::vector<uint8_t>(current, current + change.size) };
+		});
+		TEST_CHECK(id != FieldWatcher::InvalidId);
+		TEST_CHECK(model.count(id) == 0);
+		model[id] = { object, offset, size, std::vector<uint8_t>(object + offset, object + offset + size) };
+	};
+
+	for (int i = 0; i < 64; ++i) {
+		watchRandom();
+	}
+
+	for (int round = 0; round < 3000; ++round) {
+		//Phases that mostly unwatch drive the dead entries past half, so compaction runs many times
+		bool shrinking = (round / 200) % 2 == 1;
+		uint32_t operations = random(8);
+		for (uint32_t op = 0; op < operations; ++op) {
+			uint32_t kind = random(10);
+			if (kind < (shrinking ? 2u : 5u) || model.empty()) {
+				watchRandom();
+			}
+			else {
+				auto it = model.begin();
+				std::advance(it, random((uint32_t)model.size()));
+				watcher.unwatch(it->first);
+				model.erase(it);
+			}
+		}
+		TEST_CHECK(watcher.watchedCount() == model.size());
+
+		//Scribble over random bytes, sometimes writing back what was already there
+		uint32_t writes = random(24);
+		for (uint32_t w = 0; w < writes; ++w) {
+			uint8_t *object = objects[random((uint32_t)objects.size())].get();
+			uint32_t at = random(ObjectSize);
+			object[at] = random(4) == 0 ? object[at] : (uint8_t)random(256);
+		}
+
+		reported.clear();
+		uint32_t changed = watcher.update();
+		TEST_CHECK(changed == reported.size());
+
+		for (auto &[id, watch] : model) {
+			std::vector<uint8_t> now(watch.object + watch.offset, watch.object + watch.offset + watch.size);
+			auto it = reported.find(id);
+			if (now == watch.seen) {
+				TEST_CHECK(it == reported.end());
+				continue;
+			}
+
+			TEST_CHECK(it != reported.end());
+			if (it != reported.end()) {
+				TEST_CHECK(it->second.object == watch.object);
+				TEST_CHECK(it->second.fieldOffset == watch.offset);
+				TEST_CHECK(it->second.previous == watch.seen);
+				TEST_CHECK(it->second.current == now);
+			}
+			watch.seen = std::move(now);
+		}
+
+		//Nothing is reported for unwatched ids
+		for (auto &[id, report] : reported) {
+			TEST_CHECK(model.count(id) == 1);
+		}
+	}
+	TEST_CHECK(duplicateReports == 0);
+
+	//Unwatching everything leaves an empty watcher that still works
+	for (auto &[id, watch] : model) {
+		watcher.unwatch(id);
+	}
+	model.clear();
+	TEST_CHECK(watcher.watchedCount() == 0);
+	TEST_CHECK(watcher.update() == 0);
+	watchRandom();
+	TEST_CHECK(watcher.update() == 0);
+
+	//Field names resolve through the class, unresolved names are rejected instead of watching offset 0
+	internal::Il2CppClass scoreClass;
+	ctx.addField(&scoreClass, "hitCount", 0x18, sizeof(int32_t));
+	ctx.addField(&scoreClass, "unresolved", 0, sizeof(int32_t));
+	Class score(ctx, &scoreClass);
+	uint8_t *scoreObject = objects[0].get();
+	ThisPtr scorePtr(internal::Il2CppObject{ scoreObject }, &score);
+
+	FieldWatcher named;
+	int32_t lastHitCount = -1;
+	TEST_CHECK(named.watch<int32_t>(scorePtr, "hitCount", [&](const FieldChange &, int32_t, int32_t current) { lastHitCount = current; }) != FieldWatcher::InvalidId);
+	TEST_CHECK(named.watch(scorePtr, "missing", sizeof(int32_t), [](const FieldChange &) {}) == FieldWatcher::InvalidId);
+	TEST_CHECK(named.watch(scorePtr, "unresolved", sizeof(int32_t), [](const FieldChange &) {}) == FieldWatcher::InvalidId);
+	TEST_CHECK(named.watch(ThisPtr(internal::Il2CppObject{ scoreObject }, nullptr), "hitCount", sizeof(int32_t), [](const FieldChange &) {}) == FieldWatcher::InvalidId);
+	TEST_CHECK(named.watchedCount() == 1);
+
+	//The update hook runs the watcher after every Update, and goes away with the watcher
+	FakeLoader::Method &updateMethod = loader.method("", "ScoreKeeper", "Update");
+	FakeObject keeper;
+	TEST_CHECK(named.attach(loader, "", "ScoreKeeper", "Update"));
+	TEST_CHECK(named.attach(loader, "", "ScoreKeeper", "Update"));
+	TEST_CHECK(updateMethod.chain.size() == 1);
+
+	int32_t hitCount = 7;
+	std::memcpy(scoreObject + 0x18, &hitCount, sizeof(hitCount));
+	loader.callMember<void>(updateMethod, &keeper);
+	TEST_CHECK(lastHitCount == 7);
+
+	named.detach();
+	TEST_CHECK(updateMethod.chain.empty());
+
+	{
+		FieldWatcher scoped;
+		TEST_CHECK(scoped.attach(loader, "", "ScoreKeeper", "Update"));
+		TEST_CHECK(updateMethod.chain.size() == 1);
+	}
+	TEST_CHECK(updateMethod.chain.empty());
+	loader.callMember<void>(updateMethod, &keeper);
+
+	benchmark(10000);
+	benchmark(100000);
+
+	return testResult("field_watch_test");
+}
@@ -0,0 +1,132 @@
+//Bulk field gather against reading the field through il2cpp_field_get_value one object at a time
+//	cl /std:c++20 /EHsc /O2 gather_bench.cpp ..\il2cpp\il2cpp_context.cpp
+#include <algorithm>
+#include <random>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+#include "../il2cpp/il2cpp_gather.h"
+
+using namespace il2cppapi;
+
+static const size_t HealthOffset = 0x24;
+
+//Objects scattered over the heap in a random order, like a real managed array of references, with every 97th
+//reference null
+struct Scattered {
+	std::vector<std::unique_ptr<uint8_t[]>> objects;
+	FakeArray<void *> storage;
+
+	explicit Scattered(uint32_t count) : objects(count), storage(count) {
+		for (auto &object : objects) {
+			object = std::make_unique<uint8_t[]>(96);
+		}
+		std::shuffle(objects.begin(), objects.end(), std::mt19937(7));
+
+		for (uint32_t i = 0; i < count; ++i) {
+			float health = (float)i;
+			std::memcpy(objects[i].get() + HealthOffset, &health, sizeof(health));
+			storage[i] = i % 97 == 0 ? nullptr : objects[i].get();
+		}
+	}
+
+	//What any gather over `storage` has to produce
+	std::vector<float> expected() {
+		std::vector<float> values(objects.size());
+		for (uint32_t i = 0; i < values.size(); ++i) {
+			values[i] = storage[i] ? (float)i : 0.0f;
+		}
+		return values;
+	}
+};
+
+//The naive loop, the gather and the parallel gather over `count` objects, each checked against the expected values
+static void benchSize(FakeContext &ctx, internal::Il2CppClass *enemyClass, Class &enemy, uint32_t count) {
+	Scattered scattered(count);
+	FakeArray<void *> &storage = scattered.storage;
+	Array<internal::Il2CppObject> arr(storage.ptr());
+
+	//Roughly the same number of elements read for every size
+	uint32_t iterations = std::max<uint32_t>(5, (1u << 23) / count);
+
+	const internal::FieldInfo *field = ctx.getClassFieldInfo(enemyClass, "health");
+	std::vector<float> naive(count);
+	double naiveNs = benchNs(iterations, [&](uint32_t) {
+		for (uint32_t i = 0; i < count; ++i) {
+			void *obj = storage[i];
+			naive[i] = 0.0f;
+			if (obj) {
+				ctx.getValueFromField(internal::Il2CppObject{ obj }, field, &naive[i]);
+			}
+		}
+		benchKeep(naive[count - 1]);
+	});
+
+	std::vector<float> gathered;
+	double gatherNs = benchNs(iterations, [&](uint32_t) {
+		gatherField(ctx, arr, enemy.fieldOffset("health"), gathered);
+		benchKeep(gathered[count - 1]);
+	});
+
+	GatherOptions parallel;
+	parallel.maxThreads = 0;
+	std::vector<float> gatheredParallel;
+	double parallelNs = benchNs(iterations, [&](uint32_t) {
+		gatherField(ctx, arr, enemy.fieldOffset("health"), gatheredParallel, parallel);
+		benchKeep(gatheredParallel[count - 1]);
+	});
+
+	printf("%8u objects: field_get_value %9.3f ms (%5.2f ns/obj), gather %9.3f ms (%5.2f ns/obj), parallel gather %9.3f ms (%5.2f ns/obj)\n",
+		count, naiveNs / 1e6, naiveNs / count, gatherNs / 1e6, gatherNs / count, parallelNs / 1e6, parallelNs / count);
+	TEST_CHECK(naive == scattered.expected());
+	TEST_CHECK(gathered == naive);
+	TEST_CHECK(gatheredParallel == naive);
+}
+
+int main() {
+	FakeLoader loader;
+	FakeContext &ctx = loader.context();
+
+	internal::Il2CppClass enemyClass;
+	ctx.addField(&enemyClass, "health", HealthOffset, sizeof(float));
+	Class enemy(ctx, &enemyClass);
+
+	for (uint32_t count : { 1000u, 10000u, 100000u, 1000000u }) {
+		benchSize(ctx, &enemyClass, enemy, count);
+	}
+
+	//The remaining checks run on one mid-sized array
+	Scattered scattered(1 << 18);
+	Array<internal::Il2CppObject> arr(scattered.storage.ptr());
+	std::vector<float> naive = scattered.expected();
+
+	//Empty arrays and degenerate options
+	FakeArray<void *> emptyStorage(0);
+	Array<internal::Il2CppObject> empty(emptyStorage.ptr());
+	GatherOptions degenerate;
+	degenerate.parallelThreshold = 0;
+	degenerate.maxThreads = 0;
+	std::vector<float> none;
+	TEST_CHECK(gatherField(ctx, empty, HealthOffset, none, degenerate));
+	TEST_CHECK(none.empty());
+
+	degenerate.parallelThreshold = 1;
+	std::vector<float> all;
+	TEST_CHECK(gatherField(ctx, arr, HealthOffset, all, degenerate));
+	TEST_CHECK(all == naive);
+
+	//A missing field must fail instead of reading the object header
+	std::vector<float> missing = gatherField<float>(ctx, arr, enemy, "armor");
+	TEST_CHECK(missing.empty());
+	TEST_CHECK(enemy.fieldOffset("armor") == 0);
+	float raw = -1.0f;
+	TEST_CHECK(!gatherField(arr, 1, 0, &raw));
+	TEST_CHECK(raw == -1.0f);
+
+	//Loaders from before il2cpp_field_get_offset was appended
+	ctx.dropFieldOffsetEntry();
+	TEST_CHECK(enemy.fieldOffset("health") == 0);
+	TEST_CHECK(gatherField<float>(ctx, arr, enemy, "health").empty());
+
+	return testResult("gather_bench");
+}
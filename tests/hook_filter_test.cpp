@@ -0,0 +1,213 @@
+//Hook filters: clauses checked against the method's signature at bind time, evaluation on the raw arguments, and the
+//loader's chainHead contract the pre-dispatch walk depends on, and the per call cost with and without a filter
+//	cl /std:c++20 /EHsc /O2 hook_filter_test.cpp ..\il2cpp\il2cpp_context.cpp
+#include <limits>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+
+enum class HitKind : int32_t {
+	Miss = -1,
+	Good = 1,
+	Perfect = 2,
+};
+
+static int32_t __thiscall onHit(void *, int32_t cue, float, double, uint32_t, int64_t, HitKind) {
+	return cue;
+}
+
+using HitCallback = std::function<std::optional<int32_t>(const MethodInvocationContext &, ThisPtr, int32_t, float, double, uint32_t, int64_t, HitKind)>;
+
+static HookHandle bindFiltered(FakeLoader &loader, const HookFilter &filter, int *runs, int priority = 0) {
+	HookOptions options;
+	options.filter = filter;
+	HitCallback callback = [runs](const MethodInvocationContext &, ThisPtr, int32_t, float, double, uint32_t, int64_t, HitKind) -> std::optional<int32_t> {
+		++*runs;
+		return std::nullopt;
+	};
+	return loader.bindClassFunction("", "Target", "OnHit", InvokeTime::Before, priority, options, std::move(callback));
+}
+
+//Same size is not enough, the clause has to test the argument as what it is
+static void clausesMatchTheSignature() {
+	FakeLoader loader;
+	loader.defineMethod("", "Target", "OnHit", &onHit);
+	FakeLoader::Method &method = loader.method("", "Target", "OnHit");
+	int runs = 0;
+
+	auto binds = [&](const HookFilter &filter) {
+		HookHandle handle = bindFiltered(loader, filter, &runs);
+		bool valid = handle.isValid();
+		if (valid) {
+			TEST_CHECK(loader.unbind(handle));
+		}
+		return valid;
+	};
+
+	TEST_CHECK(binds(HookFilter().argEquals(0, 3)));
+	TEST_CHECK(binds(HookFilter().argEquals(1, 0.5f)));
+	TEST_CHECK(binds(HookFilter().argInRange(2, 0.0, 1.0)));
+	TEST_CHECK(binds(HookFilter().argInRange(3, 0u, 10u)));
+	TEST_CHECK(binds(HookFilter().argInRange(4, (int64_t)-10, (int64_t)10)));
+	TEST_CHECK(binds(HookFilter().argEquals(5, HitKind::Perfect)));
+	TEST_CHECK(binds(HookFilter().argInRange(5, HitKind::Good, HitKind::Perfect)));
+	TEST_CHECK(binds(HookFilter().thisIs(&loader)));
+
+	//Equality and masks compare integers bit for bit, so signedness doesn't matter there
+	TEST_CHECK(binds(HookFilter().argEquals(3, 5)));
+	TEST_CHECK(binds(HookFilter().argMaskAny(3, 4)));
+	TEST_CHECK(binds(HookFilter().argEquals(0, 3u)));
+
+	//4 byte float against int32 and back, 8 byte double against int64 and back, float against double
+	TEST_CHECK(!binds(HookFilter().argEquals(0, 3.0f)));
+	TEST_CHECK(!binds(HookFilter().argEquals(1, 1)));
+	TEST_CHECK(!binds(HookFilter().argInRange(1, 0, 1)));
+	TEST_CHECK(!binds(HookFilter().argEquals(2, (int64_t)1)));
+	TEST_CHECK(!binds(HookFilter().argEquals(4, 1.0)));
+	TEST_CHECK(!binds(HookFilter().argEquals(2, 1.0f)));
+
+	//A range's bounds mean something else with the other signedness
+	TEST_CHECK(!binds(HookFilter().argInRange(3, 0, 10)));
+	TEST_CHECK(!binds(HookFilter().argInRange(4, (uint64_t)0, (uint64_t)10)));
+
+	//Size, index, `this` on a static method and too many clauses are still rejected
+	TEST_CHECK(!binds(HookFilter().argEquals(4, 1)));
+	TEST_CHECK(!binds(HookFilter().argEquals(6, 1)));
+	TEST_CHECK(!binds(HookFilter().argEquals(0, 1).argEquals(0, 2).argEquals(0, 3).argEquals(0, 4).argEquals(0, 5)));
+	TEST_CHECK(!loader.bindStaticFunction("", "Target", "Reset", InvokeTime::Before, 0, [] {
+		HookOptions options;
+		options.filter = HookFilter().thisIs(nullptr);
+		return options;
+	}(), [](const MethodInvocationContext &) {}).isValid());
+
+	//Nothing rejected ever reached the loader
+	TEST_CHECK(method.chain.empty());
+	TEST_CHECK(runs == 0);
+}
+
+//Clauses evaluated on the native arguments, calls no node accepts never enter the chain
+static void clausesEvaluate() {
+	FakeLoader loader;
+	loader.routeSingleHooks = false;
+	loader.defineMethod("", "Target", "OnHit", &onHit);
+	FakeLoader::Method &method = loader.method("", "Target", "OnHit");
+	FakeObject target, other;
+
+	int rangeRuns = 0, signedRuns = 0, maskRuns = 0;
+	bindFiltered(loader, HookFilter().thisIs(&target).argInRange(1, 0.5f, 1.0f), &rangeRuns, 2);
+	bindFiltered(loader, HookFilter().argInRange(0, -5, 5).argNotEquals(5, HitKind::Miss), &signedRuns, 1);
+	bindFiltered(loader, HookFilter().argMaskEquals(3, 0x0Fu, 0x03u).argInRange(4, (int64_t)-1, (int64_t)1), &maskRuns, 0);
+
+	auto hit = [&](FakeObject *ths, int32_t cue, float accuracy, uint32_t flags, int64_t time, HitKind kind) {
+		return loader.callMember<int32_t>(method, ths, cue, accuracy, 0.0, flags, time, kind);
+	};
+
+	//Nothing matches: each call goes straight to the original
+	TEST_CHECK(hit(&other, 9, 0.75f, 0x10, 5, HitKind::Good) == 9);
+	TEST_CHECK(hit(&target, 9, 0.25f, 0x13, 5, HitKind::Good) == 9);
+	TEST_CHECK(hit(&target, 9, std::numeric_limits<float>::quiet_NaN(), 0x03, 2, HitKind::Good) == 9);
+	TEST_CHECK(hit(&target, -3, 0.0f, 0x03, 2, HitKind::Miss) == -3);
+	TEST_CHECK(method.chainDispatches == 0);
+
+	TEST_CHECK(hit(&target, 9, 0.75f, 0x00, 0, HitKind::Good) == 9);
+	TEST_CHECK(hit(&other, -5, 0.0f, 0x00, 0, HitKind::Good) == -5);
+	TEST_CHECK(hit(&other, 9, 0.0f, 0x23, -1, HitKind::Good) == 9);
+	TEST_CHECK(hit(&other, 9, 0.0f, 0x23, std::numeric_limits<int64_t>::min(), HitKind::Good) == 9);
+	TEST_CHECK(rangeRuns == 1);
+	TEST_CHECK(signedRuns == 1);
+	TEST_CHECK(maskRuns == 1);
+	TEST_CHECK(method.chainDispatches == 3);
+}
+
+//The walk needs the loader to keep chainHead current. Without it every call runs the chain and nodes decide for
+//themselves, with the same result
+static void chainHeadContract() {
+	FakeLoader loader;
+	loader.routeSingleHooks = false;
+	loader.defineMethod("", "Target", "OnHit", &onHit);
+	FakeLoader::Method &method = loader.method("", "Target", "OnHit");
+	FakeObject target;
+
+	auto hit = [&](int32_t cue) {
+		return loader.callMember<int32_t>(method, &target, cue, 1.0f, 0.0, 0u, (int64_t)0, HitKind::Good);
+	};
+
+	int firstRuns = 0, secondRuns = 0;
+	HookHandle first = bindFiltered(loader, HookFilter().argEquals(0, 1), &firstRuns, 1);
+	HookHandle second = bindFiltered(loader, HookFilter().argEquals(0, 2), &secondRuns, 0);
+	TEST_CHECK(method.chain.front()->loadChainHead() == method.chain.front()->node);
+	TEST_CHECK(method.chain.front()->node->next == method.chain.back()->node);
+
+	hit(1);
+	hit(2);
+	hit(3);
+	TEST_CHECK(firstRuns == 1 && secondRuns == 1);
+	TEST_CHECK(method.chainDispatches == 2);
+
+	//A loader that doesn't track the head
+	for (auto &call : method.chain) {
+		reinterpret_cast<std::atomic<MethodHookNode *> *>(&call->chainHead)->store(nullptr);
+	}
+	hit(1);
+	hit(2);
+	hit(3);
+	TEST_CHECK(firstRuns == 2 && secondRuns == 2);
+	TEST_CHECK(method.chainDispatches == 5);
+
+	//Unbinding republishes the head without the removed node, which is never walked again
+	TEST_CHECK(loader.unbind(first));
+	TEST_CHECK(method.chain.front()->loadChainHead() == method.chain.front()->node);
+	hit(1);
+	hit(3);
+	TEST_CHECK(firstRuns == 2);
+	TEST_CHECK(method.chainDispatches == 5);
+
+	TEST_CHECK(loader.unbind(second));
+	TEST_CHECK(method.chain.empty());
+	TEST_CHECK(hit(2) == 2);
+	TEST_CHECK(secondRuns == 2);
+}
+
+//Cost per call of a hook on a method called every note: without a filter, with a filter every call passes, and with
+//one that declines every call before the hook's storage is built
+static void filterOverhead() {
+	FakeLoader loader;
+	loader.defineMethod("", "Target", "OnHit", &onHit);
+	FakeLoader::Method &method = loader.method("", "Target", "OnHit");
+	FakeObject target;
+	const uint32_t iterations = 200000;
+	const uint32_t calls = iterations + iterations / 10 + 1;
+
+	auto hit = [&](uint32_t i, float accuracy) {
+		return loader.callMember<int32_t>(method, &target, (int32_t)(i & 63), accuracy, 1.0, 0x03u, (int64_t)i, HitKind::Good);
+	};
+
+	double plainNs = benchNs(iterations, [&](uint32_t i) { benchKeep(hit(i, 0.75f)); });
+
+	int runs = 0;
+	HookHandle unfiltered = bindFiltered(loader, HookFilter(), &runs);
+	double unfilteredNs = benchNs(iterations, [&](uint32_t i) { benchKeep(hit(i, 0.75f)); });
+	TEST_CHECK(runs == (int)calls);
+	TEST_CHECK(loader.unbind(unfiltered));
+
+	runs = 0;
+	HookHandle filtered = bindFiltered(loader, HookFilter().argInRange(1, 0.5f, 1.0f).argMaskEquals(3, 0x0Fu, 0x03u), &runs);
+	double matchingNs = benchNs(iterations, [&](uint32_t i) { benchKeep(hit(i, 0.75f)); });
+	TEST_CHECK(runs == (int)calls);
+
+	runs = 0;
+	double rejectingNs = benchNs(iterations, [&](uint32_t i) { benchKeep(hit(i, 0.25f)); });
+	TEST_CHECK(runs == 0);
+	TEST_CHECK(loader.unbind(filtered));
+
+	printf("no hooks %.1f ns/call, unfiltered hook %.1f ns/call, matching filter %.1f ns/call, rejecting filter %.1f ns/call\n",
+		plainNs, unfilteredNs, matchingNs, rejectingNs);
+}
+
+int main() {
+	clausesMatchTheSignature();
+	clausesEvaluate();
+	chainHeadContract();
+	filterOverhead();
+	return testResult("hook_filter_test");
+}
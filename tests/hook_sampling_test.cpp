@@ -0,0 +1,271 @@
+//Sampled and filtered hooks must be decided before the call's storage is built, so declined calls cost no chain dispatch
+//	cl /std:c++20 /EHsc /O2 hook_sampling_test.cpp ..\il2cpp\il2cpp_context.cpp
+#include "test_harness.h"
+#include "fake_loader.h"
+
+static int32_t __thiscall getScore(void *, int32_t value) {
+	return value * 2;
+}
+
+static int32_t getBonus(int32_t value) {
+	return value + 1;
+}
+
+//Clock the rate limit reads in the gate tests, stepped by hand
+static int64_t fakeNowNs = 0;
+
+static int64_t fakeClock() {
+	return fakeNowNs;
+}
+
+static HookOptions everyNth(uint32_t n) {
+	HookOptions options;
+	options.sampling.everyNth = n;
+	return options;
+}
+
+//9 calls to a sampled hook run it 3 times and pay for 3 chain dispatches, the rest go straight to the original
+static void sampledChainSkipsDispatch() {
+	FakeLoader loader;
+	loader.routeSingleHooks = false;
+	loader.defineMethod("", "Target", "GetScore", &getScore);
+
+	int runs = 0;
+	loader.bindClassFunction("", "Target", "GetScore", InvokeTime::Before, 0, everyNth(3), [&](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+		++runs;
+		return std::nullopt;
+	});
+
+	FakeObject target;
+	for (int32_t i = 0; i < 9; ++i) {
+		TEST_CHECK(loader.callMember<int32_t>("", "Target", "GetScore", &target, i) == i * 2);
+	}
+	TEST_CHECK(runs == 3);
+	TEST_CHECK(loader.chainDispatches("", "Target", "GetScore") == 3);
+}
+
+//Same through the single hook route, for a static method
+static void sampledSingleHook() {
+	FakeLoader loader;
+	loader.defineMethod("", "Target", "GetBonus", &getBonus);
+
+	int runs = 0;
+	loader.bindStaticFunction("", "Target", "GetBonus", InvokeTime::Before, 0, everyNth(3), [&](const MethodInvocationContext &ctx, int32_t) -> std::optional<int32_t> {
+		++runs;
+		ctx.stopExecution();
+		return -1;
+	});
+
+	int overridden = 0;
+	for (int32_t i = 0; i < 9; ++i) {
+		int32_t bonus = loader.callStatic<int32_t>("", "Target", "GetBonus", i);
+		if (bonus == -1) {
+			++overridden;
+		}
+		else {
+			TEST_CHECK(bonus == i + 1);
+		}
+	}
+	TEST_CHECK(runs == 3);
+	TEST_CHECK(overridden == 3);
+	TEST_CHECK(loader.chainDispatches("", "Target", "GetBonus") == 0);
+}
+
+//The walk stops at the first node that runs. Nodes it already decided keep their verdict, the rest decide once when
+//the chain reaches them, so every gate is consumed exactly once per call
+static void gatesConsumedOnce() {
+	FakeLoader loader;
+	loader.defineMethod("", "Target", "GetScore", &getScore);
+
+	HookOptions onlyFive;
+	onlyFive.filter = HookFilter().argEquals(0, (int32_t)5);
+
+	int firstRuns = 0, secondRuns = 0, thirdRuns = 0;
+	loader.bindClassFunction("", "Target", "GetScore", InvokeTime::Before, 30, everyNth(2), [&](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+		++firstRuns;
+		return std::nullopt;
+	});
+	loader.bindClassFunction("", "Target", "GetScore", InvokeTime::Before, 20, onlyFive, [&](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+		++secondRuns;
+		return std::nullopt;
+	});
+	loader.bindClassFunction("", "Target", "GetScore", InvokeTime::After, 10, everyNth(4), [&](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+		++thirdRuns;
+		return std::nullopt;
+	});
+
+	FakeObject target;
+	for (int32_t i = 0; i < 12; ++i) {
+		TEST_CHECK(loader.callMember<int32_t>("", "Target", "GetScore", &target, 5) == 10);
+	}
+	TEST_CHECK(firstRuns == 6);
+	TEST_CHECK(secondRuns == 12);
+	TEST_CHECK(thirdRuns == 3);
+	TEST_CHECK(loader.chainDispatches("", "Target", "GetScore") == 12);
+
+	//Nothing accepts 4 except every other call to the first node
+	firstRuns = secondRuns = thirdRuns = 0;
+	for (int32_t i = 0; i < 12; ++i) {
+		TEST_CHECK(loader.callMember<int32_t>("", "Target", "GetScore", &target, 4) == 8);
+	}
+	TEST_CHECK(firstRuns == 6);
+	TEST_CHECK(secondRuns == 0);
+	TEST_CHECK(thirdRuns == 3);
+	TEST_CHECK(loader.chainDispatches("", "Target", "GetScore") == 18);
+}
+
+//A node without a precheck runs for every call, so the chain always dispatches and sampled nodes decide themselves
+static void unconditionalNodeAlwaysDispatches() {
+	FakeLoader loader;
+	loader.defineMethod("", "Target", "GetScore", &getScore);
+
+	int sampledRuns = 0, plainRuns = 0;
+	loader.bindClassFunction("", "Target", "GetScore", InvokeTime::Before, 0, everyNth(3), [&](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+		++sampledRuns;
+		return std::nullopt;
+	});
+	loader.bindClassFunction("", "Target", "GetScore", InvokeTime::After, 0, [&](const MethodInvocationContext &ctx, ThisPtr, int32_t) -> std::optional<int32_t> {
+		++plainRuns;
+		return ctx.getReturn<int32_t>() + 1;
+	});
+
+	FakeObject target;
+	for (int32_t i = 0; i < 9; ++i) {
+		TEST_CHECK(loader.callMember<int32_t>("", "Target", "GetScore", &target, i) == i * 2 + 1);
+	}
+	TEST_CHECK(sampledRuns == 3);
+	TEST_CHECK(plainRuns == 9);
+	TEST_CHECK(loader.chainDispatches("", "Target", "GetScore") == 9);
+}
+
+//maxPerFrame counts runs per HookFrame and starts over when the frame advances, calls that everyNth declined don't count
+static void frameCap() {
+	HookSampling sampling;
+	sampling.maxPerFrame = 2;
+	HookGate gate(sampling);
+
+	HookFrame::advance();
+	int allowed = 0;
+	for (int i = 0; i < 5; ++i) {
+		allowed += gate.allow() ? 1 : 0;
+	}
+	TEST_CHECK(allowed == 2);
+
+	HookFrame::advance();
+	TEST_CHECK(gate.allow());
+	TEST_CHECK(gate.allow());
+	TEST_CHECK(!gate.allow());
+
+	//A frame without calls in between changes nothing
+	HookFrame::advance();
+	HookFrame::advance();
+	TEST_CHECK(gate.allow());
+
+	sampling.everyNth = 2;
+	HookGate sampled(sampling);
+	HookFrame::advance();
+	std::vector<bool> verdicts;
+	for (int i = 0; i < 8; ++i) {
+		verdicts.push_back(sampled.allow());
+	}
+	TEST_CHECK((verdicts == std::vector<bool>{ true, false, true, false, false, false, false, false }));
+
+	//Through the binding: 3 runs per frame, the rest go to the original without a dispatch
+	FakeLoader loader;
+	loader.routeSingleHooks = false;
+	loader.defineMethod("", "Target", "GetScore", &getScore);
+	HookOptions options;
+	options.sampling.maxPerFrame = 3;
+	int runs = 0;
+	loader.bindClassFunction("", "Target", "GetScore", InvokeTime::Before, 0, options, [&](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+		++runs;
+		return std::nullopt;
+	});
+
+	FakeObject target;
+	for (int frame = 0; frame < 4; ++frame) {
+		HookFrame::advance();
+		for (int32_t i = 0; i < 10; ++i) {
+			TEST_CHECK(loader.callMember<int32_t>("", "Target", "GetScore", &target, i) == i * 2);
+		}
+		TEST_CHECK(runs == (frame + 1) * 3);
+	}
+	TEST_CHECK(loader.chainDispatches("", "Target", "GetScore") == 12);
+}
+
+//maxPerSecond as GCRA: `burst` runs at once, then one per interval, and an idle bucket refills to `burst` but not past it
+static void rateLimit() {
+	HookSampling sampling;
+	sampling.maxPerSecond = 10.0;
+	sampling.burst = 3;
+	HookGate gate(sampling);
+	const int64_t ms = 1000000;
+
+	fakeNowNs = 1000000 * ms;
+	int allowed = 0;
+	for (int i = 0; i < 10; ++i) {
+		allowed += gate.allow(&fakeClock) ? 1 : 0;
+	}
+	TEST_CHECK(allowed == 3);
+
+	fakeNowNs += 50 * ms;
+	TEST_CHECK(!gate.allow(&fakeClock));
+	fakeNowNs += 50 * ms;
+	TEST_CHECK(gate.allow(&fakeClock));
+	TEST_CHECK(!gate.allow(&fakeClock));
+
+	//A steady 10 per second always passes
+	for (int i = 0; i < 20; ++i) {
+		fakeNowNs += 100 * ms;
+		TEST_CHECK(gate.allow(&fakeClock));
+	}
+
+	fakeNowNs += 10000 * ms;
+	allowed = 0;
+	for (int i = 0; i < 10; ++i) {
+		allowed += gate.allow(&fakeClock) ? 1 : 0;
+	}
+	TEST_CHECK(allowed == 3);
+
+	//Without a burst one run per interval, and a call just before the interval is up is declined
+	sampling.burst = 1;
+	HookGate single(sampling);
+	TEST_CHECK(single.allow(&fakeClock));
+	TEST_CHECK(!single.allow(&fakeClock));
+	fakeNowNs += 100 * ms - 1;
+	TEST_CHECK(!single.allow(&fakeClock));
+	fakeNowNs += 1;
+	TEST_CHECK(single.allow(&fakeClock));
+
+	//All limits combined: every 2nd call, at most 2 per frame, at most 10 per second. Over 3 frames 100 ms apart the rate
+	//is what limits
+	sampling.everyNth = 2;
+	sampling.maxPerFrame = 2;
+	HookGate combined(sampling);
+	allowed = 0;
+	for (int frame = 0; frame < 3; ++frame) {
+		HookFrame::advance();
+		fakeNowNs += 100 * ms;
+		for (int i = 0; i < 10; ++i) {
+			allowed += combined.allow(&fakeClock) ? 1 : 0;
+		}
+		TEST_CHECK(allowed == frame + 1);
+	}
+
+	//The real clock is only read when a rate is set
+	HookSampling frameOnly;
+	frameOnly.maxPerFrame = 1;
+	HookGate noClock(frameOnly);
+	HookFrame::advance();
+	TEST_CHECK(noClock.allow([]() -> int64_t { TEST_CHECK(false); return 0; }));
+}
+
+int main() {
+	sampledChainSkipsDispatch();
+	sampledSingleHook();
+	gatesConsumedOnce();
+	unconditionalNodeAlwaysDispatches();
+	frameCap();
+	rateLimit();
+	return testResult("hook_sampling_test");
+}
@@ -0,0 +1,75 @@
+//Simulates a mod being hot reloaded 10k times: every cycle binds its hooks, runs some frames and unbinds them again.
+//Pool slots must be recycled, so memory stays flat
+//	cl /std:c++20 /EHsc /O2 hot_reload_test.cpp ..\il2cpp\il2cpp_context.cpp
+#include "test_harness.h"
+#include "fake_loader.h"
+
+static int32_t __thiscall takeDamage(void *, int32_t amount) {
+	return amount;
+}
+
+static void __thiscall update(void *) {
+}
+
+int main() {
+	FakeLoader loader;
+	loader.defineMethod("", "Player", "TakeDamage", &takeDamage);
+	loader.defineMethod("", "Player", "Update", &update);
+	FakeObject player;
+
+	const uint32_t cycles = 10000;
+	size_t baselineLive = HookNodePool::global().liveCount();
+	size_t peakCapacity = 0;
+	int runs = 0;
+
+	for (uint32_t cycle = 0; cycle < cycles; ++cycle) {
+		HookOptions sampled;
+		sampled.sampling.everyNth = 2;
+
+		HookHandle damage = loader.bindClassFunction("", "Player", "TakeDamage", InvokeTime::Before, 0, sampled, [&runs](const MethodInvocationContext &ctx, ThisPtr, int32_t amount) -> std::optional<int32_t> {
+			++runs;
+			ctx.stopExecution();
+			return amount / 2;
+		});
+		HookHandle tick = loader.bindClassFunction("", "Player", "Update", InvokeTime::After, 0, [&runs](const MethodInvocationContext &, ThisPtr) {
+			++runs;
+		});
+
+		//Every few reloads the mod unbinds from inside its own hook, while the chain is dispatching it
+		HookHandle selfUnbind;
+		if (cycle % 16 == 0) {
+			selfUnbind = loader.bindClassFunction("", "Player", "Update", InvokeTime::Before, 0, [&loader, &selfUnbind](const MethodInvocationContext &, ThisPtr) {
+				loader.unbind(selfUnbind);
+			});
+		}
+
+		TEST_CHECK(damage.isValid() && tick.isValid());
+		for (int frame = 0; frame < 2; ++frame) {
+			loader.callMember<void>("", "Player", "Update", &player);
+			int32_t taken = loader.callMember<int32_t>("", "Player", "TakeDamage", &player, 10);
+			TEST_CHECK(taken == (frame == 0 ? 5 : 10));
+		}
+
+		TEST_CHECK(loader.unbind(damage));
+		TEST_CHECK(loader.unbind(tick));
+		TEST_CHECK(!loader.unbind(tick));
+		peakCapacity = std::max(peakCapacity, HookNodePool::global().capacity());
+	}
+
+	TEST_CHECK(runs == (int)cycles * 3);
+	TEST_CHECK(loader.method("", "Player", "TakeDamage").chain.empty());
+	TEST_CHECK(loader.method("", "Player", "Update").chain.empty());
+
+	//Retired slots are released once no dispatch can still see them
+	HookReclaimer::global().collect();
+	HookReclaimer::global().collect();
+	HookReclaimer::global().collect();
+	TEST_CHECK(HookReclaimer::global().pendingCount() == 0);
+	TEST_CHECK(HookNodePool::global().liveCount() == baselineLive);
+
+	//A handful of nodes are live at once, so one slab covers every cycle
+	printf("%u reload cycles, peak pool capacity %zu slots\n", cycles, peakCapacity);
+	TEST_CHECK(peakCapacity <= HookNodePool::SlabSize);
+
+	return testResult("hot_reload_test");
+}
@@ -0,0 +1,238 @@
+//Parallel mod initialization: dependency order, skipping, exceptions, thread attach and loader serialization
+//	cl /std:c++20 /EHsc /O2 mod_scheduler_test.cpp ..\il2cpp\il2cpp_context.cpp
+#include <array>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+#include "../il2cpp/il2cpp_mod_scheduler.h"
+
+static std::mutex orderMutex;
+static std::vector<std::string> order;
+static std::atomic<int> initializeCalls{ 0 };
+static std::atomic<int> unattachedCalls{ 0 };
+static std::thread::id mainThread;
+
+static void record(const char *name) {
+	std::lock_guard<std::mutex> lock(orderMutex);
+	order.push_back(name);
+}
+
+static size_t positionOf(const char *name) {
+	std::lock_guard<std::mutex> lock(orderMutex);
+	return std::find(order.begin(), order.end(), name) - order.begin();
+}
+
+static void __thiscall update(void *) {}
+
+//Every mod hooks methods and asks for shared data, the way a real initialize sets itself up
+template<int Id>
+static void initializeMod(il2cpp_binding &binding) {
+	++initializeCalls;
+	//The thread calling run() belongs to the loader and is already attached
+	if (std::this_thread::get_id() != mainThread && !FakeContext::isThreadAttached()) {
+		++unattachedCalls;
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "Mod%d", Id);
+	for (int i = 0; i < 20; ++i) {
+		binding.getSharedData(name, 64);
+		HookHandle handle = binding.bindClassFunction("", "Game", "Update", InvokeTime::After, Id, [](const MethodInvocationContext &, ThisPtr) {});
+		binding.unbind(handle);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	record(name);
+}
+
+static void initializeThrowing(il2cpp_binding &) {
+	++initializeCalls;
+	throw std::runtime_error("no config file");
+}
+
+//Synthetic mods for the thread sweep: a couple of hooks and a stand-in for loading assets
+static void initializeSynthetic(il2cpp_binding &binding) {
+	for (int i = 0; i < 4; ++i) {
+		HookHandle handle = binding.bindClassFunction("", "Game", "Update", InvokeTime::After, i, [](const MethodInvocationContext &, ThisPtr) {});
+		binding.unbind(handle);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+static std::atomic<int> wrappedActiveHookCall{ 0 };
+static ModDeclaration *nestedMods = nullptr;
+static uint32_t numNestedMods = 0;
+static std::atomic<uint32_t> nestedInitialized{ 0 };
+
+//Starts a scheduler of its own from inside initialize, the way a mod that loads plugins would
+static void initializeNesting(il2cpp_binding &binding) {
+	if (!static_cast<FakeLoader &>(binding).ownsActiveHookCallEntry()) {
+		++wrappedActiveHookCall;
+	}
+
+	ModInitScheduler plugins;
+	for (uint32_t i = 0; i < numNestedMods; ++i) {
+		plugins.addMod(nestedMods[i]);
+	}
+	nestedInitialized += plugins.run(binding, 2).initialized;
+
+	//The outer run still serializes the loader once the nested one is done
+	HookHandle handle = binding.bindClassFunction("", "Game", "Update", InvokeTime::After, 0, [](const MethodInvocationContext &, ThisPtr) {});
+	binding.unbind(handle);
+}
+
+static void initializeOld(il2cpp_binding &) {
+	++initializeCalls;
+	TEST_CHECK(!"initialize of a pre 2.5 declaration must not be read");
+}
+
+int main() {
+	FakeLoader loader;
+	loader.defineMethod("", "Game", "Update", &update);
+	mainThread = std::this_thread::get_id();
+
+	//A diamond plus an independent mod: Core first, UI and Audio in parallel, Menu last
+	const char *const coreDeps[] = { "Core" };
+	const char *const menuDeps[] = { "UI", "Audio" };
+	ModDeclaration core{ BindingVersion, "Core", nullptr, 0, &initializeMod<1> };
+	ModDeclaration ui{ BindingVersion, "UI", coreDeps, 1, &initializeMod<2> };
+	ModDeclaration audio{ BindingVersion, "Audio", coreDeps, 1, &initializeMod<3> };
+	ModDeclaration menu{ BindingVersion, "Menu", menuDeps, 2, &initializeMod<4> };
+	ModDeclaration lone{ BindingVersion, "Lone", nullptr, 0, &initializeMod<5> };
+
+	ModInitScheduler scheduler;
+	scheduler.addMod(menu);
+	scheduler.addMod(audio);
+	scheduler.addMod(ui);
+	scheduler.addMod(core);
+	scheduler.addMod(lone);
+
+	ModInitScheduler::Result result = scheduler.run(loader, 4);
+	TEST_CHECK(result.initialized == 5);
+	TEST_CHECK(result.skipped == 0);
+	TEST_CHECK(result.errors.empty());
+	TEST_CHECK(initializeCalls.load() == 5);
+	TEST_CHECK(positionOf("Mod1") < positionOf("Mod2"));
+	TEST_CHECK(positionOf("Mod1") < positionOf("Mod3"));
+	TEST_CHECK(positionOf("Mod2") < positionOf("Mod4"));
+	TEST_CHECK(positionOf("Mod3") < positionOf("Mod4"));
+	TEST_CHECK(positionOf("Mod5") < order.size());
+
+	//Worker threads were attached to the runtime while they ran mods, and detached again
+	TEST_CHECK(unattachedCalls.load() == 0);
+	TEST_CHECK(FakeContext::instance()->attachedThreads.load() == 0);
+
+	//Concurrent mods never entered the loader at the same time
+	TEST_CHECK(loader.overlappingLoaderCalls() == 0);
+
+	//A throwing mod is reported and skipped along with its dependents, the rest still initializes
+	const char *const brokenDeps[] = { "Broken" };
+	const char *const missingDeps[] = { "Nowhere" };
+	const char *const cycleADeps[] = { "CycleB" };
+	const char *const cycleBDeps[] = { "CycleA" };
+	ModDeclaration broken{ BindingVersion, "Broken", nullptr, 0, &initializeThrowing };
+	ModDeclaration afterBroken{ BindingVersion, "AfterBroken", brokenDeps, 1, &initializeMod<6> };
+	ModDeclaration missing{ BindingVersion, "Missing", missingDeps, 1, &initializeMod<7> };
+	ModDeclaration cycleA{ BindingVersion, "CycleA", cycleADeps, 1, &initializeMod<8> };
+	ModDeclaration cycleB{ BindingVersion, "CycleB", cycleBDeps, 1, &initializeMod<9> };
+	ModDeclaration duplicate{ BindingVersion, "Core", nullptr, 0, &initializeMod<10> };
+
+	//Older declarations end at modName, their dependencies and initialize must not be read
+	ModDeclaration old{ semver{ 2, 4, 0 }, "Old", menuDeps, 2, &initializeOld };
+
+	ModInitScheduler failing;
+	failing.addMod(core);
+	failing.addMod(broken);
+	failing.addMod(afterBroken);
+	failing.addMod(missing);
+	failing.addMod(cycleA);
+	failing.addMod(cycleB);
+	failing.addMod(duplicate);
+	failing.addMod(old);
+
+	initializeCalls = 0;
+	for (int run = 0; run < 2; ++run) {
+		result = failing.run(loader, 3);
+		TEST_CHECK(result.initialized == 2);
+		TEST_CHECK(result.skipped == 6);
+
+		//Errors belong to a single run
+		TEST_CHECK(result.errors.size() == 6);
+	}
+	TEST_CHECK(initializeCalls.load() == 4);
+	TEST_CHECK(positionOf("Mod6") == order.size());
+	TEST_CHECK(positionOf("Mod8") == order.size());
+	TEST_CHECK(loader.overlappingLoaderCalls() == 0);
+
+	//A scheduler started from a mod's initialize, and two schedulers running at once on the same binding, share the
+	//serialized table; the loader's own entries are back once the last one finishes
+	TEST_CHECK(loader.ownsLoaderEntries());
+	const uint32_t layers = 4, perLayer = 8;
+	std::vector<std::string> names;
+	for (uint32_t i = 0; i < layers * perLayer; ++i) {
+		names.push_back("Synthetic" + std::to_string(i));
+	}
+	//Each mod past the first layer depends on two mods of the layer before
+	std::vector<std::array<const char *, 2>> syntheticDeps(layers * perLayer);
+	std::vector<ModDeclaration> synthetic;
+	for (uint32_t i = 0; i < layers * perLayer; ++i) {
+		uint32_t layer = i / perLayer, slot = i % perLayer;
+		if (layer != 0) {
+			syntheticDeps[i] = { names[(layer - 1) * perLayer + slot].c_str(), names[(layer - 1) * perLayer + (slot + 1) % perLayer].c_str() };
+		}
+		synthetic.push_back(ModDeclaration{ BindingVersion, names[i].c_str(), layer != 0 ? syntheticDeps[i].data() : nullptr, layer != 0 ? 2u : 0u, &initializeSynthetic });
+	}
+
+	nestedMods = synthetic.data();
+	numNestedMods = perLayer;
+	ModDeclaration nesting{ BindingVersion, "Nesting", nullptr, 0, &initializeNesting };
+	ModInitScheduler outer;
+	outer.addMod(nesting);
+	outer.addMod(lone);
+	ModInitScheduler beside;
+	for (uint32_t i = 0; i < perLayer; ++i) {
+		beside.addMod(synthetic[i]);
+	}
+
+	ModInitScheduler::Result besideResult;
+	std::thread besideThread([&]() {
+		internal::Il2CppThread *thread = FakeContext::instance()->attachThread();
+		besideResult = beside.run(loader, 2);
+		FakeContext::instance()->detachThread(thread);
+	});
+	result = outer.run(loader, 2);
+	besideThread.join();
+	TEST_CHECK(result.initialized == 2);
+	TEST_CHECK(besideResult.initialized == perLayer);
+	TEST_CHECK(nestedInitialized.load() == perLayer);
+	TEST_CHECK(wrappedActiveHookCall.load() == 0);
+	TEST_CHECK(loader.overlappingLoaderCalls() == 0);
+	TEST_CHECK(loader.ownsLoaderEntries());
+	TEST_CHECK(loader.ownsActiveHookCallEntry());
+
+	//The whole graph on 1 to 8 workers. Each mod mostly waits, so more workers than cores still pays off
+	double singleMs = 0.0, fourMs = 0.0;
+	for (uint32_t threads : { 1u, 2u, 4u, 8u }) {
+		ModInitScheduler sweep;
+		for (auto &mod : synthetic) {
+			sweep.addMod(mod);
+		}
+		result = sweep.run(loader, threads);
+		TEST_CHECK(result.initialized == layers * perLayer);
+		TEST_CHECK(result.errors.empty());
+
+		double ms = result.elapsed.count() / 1000.0;
+		singleMs = threads == 1 ? ms : singleMs;
+		fourMs = threads == 4 ? ms : fourMs;
+		printf("%u worker(s): %u mods in %.1f ms\n", threads, result.initialized, ms);
+	}
+	TEST_CHECK(fourMs < singleMs);
+	TEST_CHECK(loader.overlappingLoaderCalls() == 0);
+
+	//Every hook the mods bound during initialization was unbound again
+	TEST_CHECK(loader.method("", "Game", "Update").chain.empty());
+
+	return testResult("mod_scheduler_test");
+}
@@ -0,0 +1,188 @@
+//Batched observers: recording on the invoker's direct route, and delivery of partial batches on frame flush, unbind
+//and thread exit
+//	cl /std:c++20 /EHsc /O2 observe_batch_test.cpp ..\il2cpp\il2cpp_context.cpp
+#include <thread>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+#include "../il2cpp/il2cpp_observe_batch.h"
+
+static float __thiscall getScore(void *, int32_t cue, float accuracy) {
+	return (float)cue * accuracy;
+}
+
+static void __thiscall update(void *) {}
+
+struct Delivered {
+	std::mutex mutex;
+	size_t calls = 0;
+	size_t batches = 0;
+	float lastReturn = 0.0f;
+	int32_t lastCue = 0;
+	void *lastInstance = nullptr;
+	std::vector<std::thread::id> threads;
+
+	auto callback() {
+		return [this](const ObservedBatch<float, int32_t, float> &batch) {
+			std::lock_guard<std::mutex> lock(mutex);
+			TEST_CHECK(batch.instances().size() == batch.size());
+			TEST_CHECK(batch.arg<0>().size() == batch.size());
+			TEST_CHECK(batch.returns().size() == batch.size());
+			calls += batch.size();
+			++batches;
+			lastReturn = batch.returns().back();
+			lastCue = batch.arg<0>().back();
+			lastInstance = batch.instances().back();
+			threads.push_back(std::this_thread::get_id());
+		};
+	}
+};
+
+int main() {
+	FakeLoader loader;
+	loader.defineMethod("", "Target", "GetScore", &getScore);
+	loader.defineMethod("", "Song", "Update", &update);
+	FakeLoader::Method &getScoreMethod = loader.method("", "Target", "GetScore");
+	FakeObject target;
+	const uint32_t iterations = 200000;
+
+	auto call = [&](int32_t cue) {
+		return loader.callMember<float>(getScoreMethod, &target, cue, 0.5f);
+	};
+
+	double plainNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call((int32_t)(i & 7))); });
+
+	//A lone observer: the single route calls the original directly and records the raw values
+	Delivered delivered;
+	ObserveBatchOptions options;
+	options.maxBatchSize = 64;
+	HookHandle observer = ObserveBatch::bindClass<float, int32_t, float>(loader, "", "Target", "GetScore", delivered.callback(), options);
+	TEST_CHECK(observer.isValid());
+	double observedNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call((int32_t)(i & 7))); });
+	TEST_CHECK(delivered.calls == (iterations + iterations / 10 + 1) / 64 * 64);
+	TEST_CHECK(delivered.lastReturn == (float)delivered.lastCue * 0.5f);
+	TEST_CHECK(delivered.lastInstance == &target);
+
+	//Two observers on the chain route still never dispatch the loader's chain
+	loader.routeSingleHooks = false;
+	Delivered second;
+	HookHandle secondObserver = ObserveBatch::bindClass<float, int32_t, float>(loader, "", "Target", "GetScore", second.callback(), options);
+	double chainObservedNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call((int32_t)(i & 7))); });
+	TEST_CHECK(getScoreMethod.chainDispatches == 0);
+	TEST_CHECK(second.calls == (iterations + iterations / 10 + 1) / 64 * 64);
+
+	//Compared to the same recording done from an After hook, which needs the chain and its storage
+	int afterRuns = 0;
+	HookHandle afterHook = loader.bindClassFunction("", "Target", "GetScore", InvokeTime::After, 10, [&afterRuns](const MethodInvocationContext &ctx, ThisPtr, int32_t, float) -> std::optional<float> {
+		++afterRuns;
+		return ctx.getReturn<float>() + 1.0f;
+	});
+	double afterHookNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call((int32_t)(i & 7))); });
+	TEST_CHECK(getScoreMethod.chainDispatches == iterations + iterations / 10 + 1);
+
+	printf("no hooks %.1f ns/call, observed %.1f ns/call, 2 observers %.1f ns/call, 2 observers + After hook %.1f ns/call\n",
+		plainNs, observedNs, chainObservedNs, afterHookNs);
+
+	//Observers on a chain that runs anyway see the result the chain produced
+	ObserveBatch::flushAll();
+	call(4);
+	ObserveBatch::flushAll();
+	TEST_CHECK(delivered.lastReturn == 3.0f);
+	TEST_CHECK(loader.unbind(afterHook));
+	TEST_CHECK(ObserveBatch::unbind(loader, secondObserver));
+
+	//A partial batch left behind by a frame advance is delivered by the per-frame flush, even if the method isn't called again
+	ObserveBatch::bindFrameFlush(loader, "", "Song", "Update");
+	size_t before = delivered.calls;
+	call(1);
+	call(2);
+	HookFrame::advance();
+	TEST_CHECK(delivered.calls == before);
+	loader.callMember<void>("", "Song", "Update", &target);
+	TEST_CHECK(delivered.calls == before + 2);
+
+	//A thread's partial batch is delivered on that thread when it exits
+	before = delivered.calls;
+	std::thread::id workerId;
+	std::thread worker([&]() {
+		workerId = std::this_thread::get_id();
+		for (int i = 0; i < 5; ++i) {
+			call(i);
+		}
+	});
+	worker.join();
+	TEST_CHECK(delivered.calls == before + 5);
+	TEST_CHECK(delivered.threads.back() == workerId);
+
+	//Flushing from another thread while a worker keeps recording for two observers: every record is delivered once and
+	//intact, and the worker's buffers are all delivered at exit
+	{
+		size_t mismatched = 0;
+		HookHandle checker = ObserveBatch::bindClass<float, int32_t, float>(loader, "", "Target", "GetScore", [&mismatched](const ObservedBatch<float, int32_t, float> &batch) {
+			for (size_t i = 0; i < batch.size(); ++i) {
+				mismatched += batch.returns()[i] != (float)batch.arg<0>()[i] * batch.arg<1>()[i] ? 1 : 0;
+			}
+		}, options);
+
+		std::atomic<bool> recording{ true };
+		std::atomic<size_t> recorded{ 0 };
+		before = delivered.calls;
+		std::thread recorder([&]() {
+			for (int32_t i = 0; recording.load(std::memory_order_relaxed); ++i) {
+				call(i & 1023);
+				recorded.fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+		for (int i = 0; i < 2000; ++i) {
+			ObserveBatch::flushAll();
+			std::this_thread::yield();
+		}
+		recording.store(false);
+		recorder.join();
+		TEST_CHECK(delivered.calls - before == recorded.load());
+		TEST_CHECK(ObserveBatch::unbind(loader, checker));
+		TEST_CHECK(mismatched == 0);
+	}
+
+	//A callback that calls the observed method itself, more often than the buffer holds: nothing is lost
+	{
+		size_t reentrantCalls = 0;
+		bool nested = false;
+		ObserveBatchOptions small;
+		small.maxBatchSize = 4;
+		HookHandle reentrant = ObserveBatch::bindClass<float, int32_t, float>(loader, "", "Target", "GetScore", [&](const ObservedBatch<float, int32_t, float> &batch) {
+			reentrantCalls += batch.size();
+			if (!nested) {
+				nested = true;
+				for (int32_t i = 0; i < 20; ++i) {
+					call(i);
+				}
+			}
+		}, small);
+		for (int32_t i = 0; i < 4; ++i) {
+			call(i);
+		}
+		TEST_CHECK(ObserveBatch::unbind(loader, reentrant));
+		TEST_CHECK(reentrantCalls == 24);
+	}
+
+	//Unbinding delivers what is still buffered, and a thread that recorded doesn't keep the observer alive
+	auto token = std::make_shared<int>(0);
+	Delivered third;
+	HookHandle thirdObserver = ObserveBatch::bindClass<float, int32_t, float>(loader, "", "Target", "GetScore", [&third, token](const ObservedBatch<float, int32_t, float> &batch) {
+		third.calls += batch.size();
+	}, options);
+	call(1);
+	call(2);
+	call(3);
+	TEST_CHECK(third.calls == 0);
+	TEST_CHECK(ObserveBatch::unbind(loader, thirdObserver));
+	TEST_CHECK(third.calls == 3);
+	call(1);
+	HookReclaimer::global().collect();
+	HookReclaimer::global().collect();
+	TEST_CHECK(token.use_count() == 1);
+
+	TEST_CHECK(ObserveBatch::unbind(loader, observer));
+	return testResult("observe_batch_test");
+}
@@ -0,0 +1,121 @@
+//Memoized pure methods against running the original on every call, plus the per-method purity rules
+//	cl /std:c++20 /EHsc /O2 pure_cache_bench.cpp ..\il2cpp\il2cpp_context.cpp
+#include "test_harness.h"
+#include "fake_loader.h"
+
+static int originalCalls = 0;
+
+//Stands in for an expensive lookup the game recomputes every frame
+static double pathCost(int32_t from, int32_t to) {
+	++originalCalls;
+	double cost = 0.0;
+	for (int32_t i = from; i < from + 2000; ++i) {
+		cost += (double)((i * 2654435761u) % 97) / (double)(to + 1);
+	}
+	return cost;
+}
+
+static double plainCost(int32_t from, int32_t to) {
+	return pathCost(from, to);
+}
+
+//The same computation as a member, where `this` could be a collected object's address reused
+static double __thiscall memberCost(void *, int32_t from, int32_t to) {
+	return pathCost(from, to);
+}
+
+struct NoDefault {
+	explicit NoDefault(int value) : value(value) {}
+	int value;
+};
+
+static_assert(PureCallCache::canCache<double, int32_t, float>());
+static_assert(!PureCallCache::canCache<void, int32_t>());
+static_assert(!PureCallCache::canCache<NoDefault, int32_t>(), "Return values are default constructed before the lookup");
+static_assert(!PureCallCache::canCache<double, const int32_t *>(), "Pointer arguments identify memory, not a value");
+static_assert(!PureCallCache::canCache<double, const int32_t &>(), "Reference arguments identify memory, not a value");
+static_assert(!PureCallCache::canCache<double, internal::Il2CppObject>(), "Managed objects can change or be collected");
+static_assert(!PureCallCache::canCache<double, il2cppapi::Array<int32_t>>(), "Managed arrays can change or be collected");
+static_assert(!PureCallCache::canCache<internal::Il2CppString, int32_t>(), "Managed return values can be collected");
+static_assert(!PureCallCache::canCache<int32_t *, int32_t>());
+
+static auto noop() {
+	return [](const MethodInvocationContext &, int32_t, int32_t) -> std::optional<double> {
+		return std::nullopt;
+	};
+}
+
+int main() {
+	FakeLoader loader;
+	loader.defineMethod("", "Pathing", "Cost", &pathCost);
+	loader.defineMethod("", "Pathing", "PlainCost", &plainCost);
+	loader.defineMethod("", "Pathing", "MemberCost", &memberCost);
+
+	HookOptions pure;
+	pure.pure = true;
+	HookHandle pureHook = loader.bindStaticFunction("", "Pathing", "Cost", InvokeTime::Before, 0, pure, noop());
+	HookHandle plainHook = loader.bindStaticFunction("", "Pathing", "PlainCost", InvokeTime::Before, 0, noop());
+	TEST_CHECK(pureHook.isValid());
+	TEST_CHECK(plainHook.isValid());
+
+	//A frame's worth of repeated queries over a small working set
+	const uint32_t queries = 20000;
+	double plainNs = benchNs(queries, [&](uint32_t i) {
+		benchKeep(loader.callStatic<double>("", "Pathing", "PlainCost", (int32_t)(i % 64), (int32_t)(i % 7)));
+	});
+	double pureNs = benchNs(queries, [&](uint32_t i) {
+		benchKeep(loader.callStatic<double>("", "Pathing", "Cost", (int32_t)(i % 64), (int32_t)(i % 7)));
+	});
+	printf("hooked original %.0f ns/call, pure %.0f ns/call (%.1fx)\n", plainNs, pureNs, plainNs / pureNs);
+
+	PureCallCache::Stats stats = PureCallCache::global().stats();
+	printf("hits %llu, misses %llu, evictions %llu\n", (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+	TEST_CHECK(stats.hits > stats.misses);
+
+	//Memoized results match the original
+	for (int32_t i = 0; i < 64; ++i) {
+		TEST_CHECK(loader.callStatic<double>("", "Pathing", "Cost", i, 3) == plainCost(i, 3));
+	}
+
+	//Invalidating through the hook's handle drops the method's results
+	originalCalls = 0;
+	loader.callStatic<double>("", "Pathing", "Cost", 1, 2);
+	TEST_CHECK(originalCalls == 0);
+	PureCallCache::global().invalidate(pureHook);
+	loader.callStatic<double>("", "Pathing", "Cost", 1, 2);
+	TEST_CHECK(originalCalls == 1);
+	loader.callStatic<double>("", "Pathing", "Cost", 1, 2);
+	TEST_CHECK(originalCalls == 1);
+
+	//Every hook on a method has to agree on purity
+	HookHandle conflicting = loader.bindStaticFunction("", "Pathing", "Cost", InvokeTime::After, 0, noop());
+	TEST_CHECK(!conflicting.isValid());
+	TEST_CHECK(loader.method("", "Pathing", "Cost").chain.size() == 1);
+	HookHandle agreeing = loader.bindStaticFunction("", "Pathing", "Cost", InvokeTime::After, 0, pure, noop());
+	TEST_CHECK(agreeing.isValid());
+	TEST_CHECK(!loader.bindStaticFunction("", "Pathing", "PlainCost", InvokeTime::After, 0, pure, noop()).isValid());
+
+	//Member methods are never memoized, pure or not
+	HookHandle member = loader.bindClassFunction("", "Pathing", "MemberCost", InvokeTime::Before, 0, pure, [](const MethodInvocationContext &, ThisPtr, int32_t, int32_t) -> std::optional<double> {
+		return std::nullopt;
+	});
+	TEST_CHECK(member.isValid());
+	FakeObject grid;
+	originalCalls = 0;
+	loader.callMember<double>("", "Pathing", "MemberCost", &grid, 1, 2);
+	loader.callMember<double>("", "Pathing", "MemberCost", &grid, 1, 2);
+	TEST_CHECK(originalCalls == 2);
+	TEST_CHECK(loader.unbind(member));
+
+	//Once the pure hooks are gone, the method can be hooked without memoization
+	TEST_CHECK(loader.unbind(pureHook));
+	TEST_CHECK(loader.unbind(agreeing));
+	HookHandle replaced = loader.bindStaticFunction("", "Pathing", "Cost", InvokeTime::Before, 0, noop());
+	TEST_CHECK(replaced.isValid());
+	originalCalls = 0;
+	loader.callStatic<double>("", "Pathing", "Cost", 1, 2);
+	loader.callStatic<double>("", "Pathing", "Cost", 1, 2);
+	TEST_CHECK(originalCalls == 2);
+
+	return testResult("pure_cache_bench");
+}
@@ -0,0 +1,89 @@
+//Call cost of each route the loader can pick for a hooked method: no hooks, a single hook and the generic chain
+//	cl /std:c++20 /EHsc /O2 single_hook_bench.cpp ..\il2cpp\il2cpp_context.cpp
+#include "test_harness.h"
+#include "fake_loader.h"
+
+static uint64_t originalCalls = 0;
+
+static float __thiscall getSpeed(void *, float base, int32_t boost) {
+	++originalCalls;
+	return base + (float)boost;
+}
+
+static auto scaleAfter(int &runs) {
+	return [&runs](const MethodInvocationContext &ctx, ThisPtr, float, int32_t) -> std::optional<float> {
+		++runs;
+		return ctx.getReturn<float>() * 2.0f;
+	};
+}
+
+int main() {
+	FakeLoader loader;
+	loader.defineMethod("", "Car", "GetSpeed", &getSpeed);
+	FakeObject car;
+	const uint32_t iterations = 200000;
+
+	FakeLoader::Method &getSpeedMethod = loader.method("", "Car", "GetSpeed");
+	auto call = [&](uint32_t i) {
+		return loader.callMember<float>(getSpeedMethod, &car, 1.0f, (int32_t)(i & 7));
+	};
+
+	//No hooks: the loader calls the original directly
+	double emptyNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call(i)); });
+	TEST_CHECK(call(2) == 3.0f);
+
+	//One hook, routed through invokeSingleFn
+	int runs = 0;
+	HookHandle first = loader.bindClassFunction("", "Car", "GetSpeed", InvokeTime::After, 0, scaleAfter(runs));
+	double singleNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call(i)); });
+	TEST_CHECK(loader.chainDispatches("", "Car", "GetSpeed") == 0);
+	TEST_CHECK(call(2) == 6.0f);
+
+	//The same hook through the generic chain, as a loader without single routing would call it
+	loader.routeSingleHooks = false;
+	double genericNs = benchNs(iterations, [&](uint32_t i) { benchKeep(call(i)); });
+	TEST_CHECK(loader.chainDispatches("", "Car", "GetSpeed") == iterations + iterations / 10 + 1);
+	TEST_CHECK(call(2) == 6.0f);
+	loader.routeSingleHooks = true;
+
+	printf("no hooks %.1f ns/call, single hook %.1f ns/call, generic chain %.1f ns/call\n", emptyNs, singleNs, genericNs);
+
+	//A second hook moves the method onto the chain, both hooks run in priority order
+	int secondRuns = 0;
+	HookHandle second = loader.bindClassFunction("", "Car", "GetSpeed", InvokeTime::After, -1, scaleAfter(secondRuns));
+	uint64_t dispatches = loader.chainDispatches("", "Car", "GetSpeed");
+	TEST_CHECK(call(2) == 12.0f);
+	TEST_CHECK(loader.chainDispatches("", "Car", "GetSpeed") == dispatches + 1);
+
+	//Unbinding back down to one hook returns to the single route, and to none calls the original again
+	TEST_CHECK(loader.unbind(first));
+	TEST_CHECK(call(2) == 6.0f);
+	TEST_CHECK(loader.chainDispatches("", "Car", "GetSpeed") == dispatches + 1);
+	TEST_CHECK(loader.unbind(second));
+	uint64_t originals = originalCalls;
+	int secondBefore = secondRuns;
+	TEST_CHECK(call(2) == 3.0f);
+	TEST_CHECK(originalCalls == originals + 1);
+	TEST_CHECK(secondRuns == secondBefore);
+
+	//A loader that leaves GetActiveHookCall empty still dispatches through its chain
+	loader.dropActiveHookCallEntry();
+	loader.routeSingleHooks = false;
+	HookOptions sampled;
+	sampled.sampling.everyNth = 2;
+	int sampledRuns = 0;
+	loader.bindClassFunction("", "Car", "GetSpeed", InvokeTime::After, 0, sampled, scaleAfter(sampledRuns));
+	TEST_CHECK(call(2) == 6.0f);
+	TEST_CHECK(call(2) == 3.0f);
+	TEST_CHECK(sampledRuns == 1);
+
+	//Even when it routes a single hook directly, the call falls back to the chain instead of reading a missing node
+	loader.routeSingleHooks = true;
+	dispatches = loader.chainDispatches("", "Car", "GetSpeed");
+	TEST_CHECK(call(2) == 6.0f);
+	TEST_CHECK(call(2) == 3.0f);
+	TEST_CHECK(sampledRuns == 2);
+	TEST_CHECK(loader.chainDispatches("", "Car", "GetSpeed") == dispatches + 2);
+
+	return testResult("single_hook_bench");
+}
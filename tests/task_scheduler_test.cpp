@@ -0,0 +1,142 @@
+//Drives TaskScheduler from a simulated game loop through a hooked Update
+//	cl /std:c++20 /EHsc /O2 task_scheduler_test.cpp ..\il2cpp\il2cpp_context.cpp
+#include "test_harness.h"
+#include "fake_loader.h"
+#include "../il2cpp/il2cpp_tasks.h"
+
+static int updateCalls = 0;
+
+static void __thiscall update(void *) {
+	++updateCalls;
+}
+
+static Task countFrames(int frames, int &progress) {
+	for (int i = 0; i < frames; ++i) {
+		++progress;
+		co_await nextFrame();
+	}
+	++progress;
+}
+
+static Task hopToWorker(std::thread::id gameThread, bool &ranOnWorker, bool &cameBack) {
+	co_await onWorkerThread();
+	ranOnWorker = std::this_thread::get_id() != gameThread;
+	co_await nextFrame();
+	cameBack = std::this_thread::get_id() == gameThread;
+}
+
+//Busy for `work` on each of `resumes` resumes, the way a mod chews through a table a slice per frame
+static Task sliceOfWork(int resumes, std::chrono::microseconds work, int &done) {
+	for (int i = 0; i < resumes; ++i) {
+		auto until = std::chrono::steady_clock::now() + work;
+		while (std::chrono::steady_clock::now() < until) {
+		}
+		if (i + 1 < resumes) {
+			co_await nextFrame();
+		}
+	}
+	++done;
+}
+
+static void runFrame(FakeLoader &loader, FakeObject &player) {
+	loader.callMember<void>("", "Player", "Update", &player);
+	HookFrame::advance();
+}
+
+int main() {
+	FakeLoader loader;
+	loader.defineMethod("", "Player", "Update", &update);
+	FakeObject player;
+
+	{
+		TaskScheduler scheduler(std::chrono::microseconds(2000), 1);
+		TEST_CHECK(scheduler.attach(loader, "", "Player", "Update"));
+
+		//Each frame resumes every queued task once, so a task awaiting 5 frames finishes on the 6th
+		int progressA = 0, progressB = 0;
+		scheduler.spawn(countFrames(5, progressA));
+		scheduler.spawn(countFrames(2, progressB));
+		for (int frame = 1; frame <= 6; ++frame) {
+			runFrame(loader, player);
+			TEST_CHECK(progressA == frame);
+			TEST_CHECK(progressB == std::min(frame, 3));
+		}
+		TEST_CHECK(scheduler.pendingTasks() == 0);
+
+		//Worker hops come back on the thread that ticks
+		bool ranOnWorker = false, cameBack = false;
+		scheduler.spawn(hopToWorker(std::this_thread::get_id(), ranOnWorker, cameBack));
+		for (int frame = 0; frame < 1000 && !cameBack; ++frame) {
+			runFrame(loader, player);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		TEST_CHECK(ranOnWorker);
+		TEST_CHECK(cameBack);
+
+		//A zero budget still resumes one task per frame, so nothing starves
+		scheduler.setFrameBudget(std::chrono::microseconds(0));
+		int progress[4] = {};
+		for (int &p : progress) {
+			scheduler.spawn(countFrames(1, p));
+		}
+		runFrame(loader, player);
+		TEST_CHECK(scheduler.lastResumedCount() == 1);
+		for (int frame = 0; frame < 16 && scheduler.pendingTasks() != 0; ++frame) {
+			runFrame(loader, player);
+			TEST_CHECK(scheduler.lastResumedCount() == 1);
+		}
+		for (int p : progress) {
+			TEST_CHECK(p == 2);
+		}
+
+		//Under load a frame resumes only what fits in its budget: with 100 us slices and a 1 ms budget that is at most
+		//10, and the queue drains over the following frames instead of in one spike
+		const int taskCount = 200, resumesPerTask = 3;
+		const auto slice = std::chrono::microseconds(100);
+		scheduler.setFrameBudget(std::chrono::microseconds(1000));
+		int done = 0;
+		for (int i = 0; i < taskCount; ++i) {
+			scheduler.spawn(sliceOfWork(resumesPerTask, slice, done));
+		}
+
+		int frames = 0, totalResumed = 0;
+		uint32_t mostResumed = 0;
+		double longestFrameMs = 0.0;
+		for (; frames < 10000 && scheduler.pendingTasks() != 0; ++frames) {
+			auto start = std::chrono::steady_clock::now();
+			runFrame(loader, player);
+			longestFrameMs = std::max(longestFrameMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+			uint32_t resumed = scheduler.lastResumedCount();
+			TEST_CHECK(resumed >= 1 && resumed <= 10);
+			mostResumed = std::max(mostResumed, resumed);
+			totalResumed += resumed;
+		}
+		printf("%d slices of 100 us over %d frames, at most %u per frame, longest frame %.2f ms\n", totalResumed, frames, mostResumed, longestFrameMs);
+		TEST_CHECK(done == taskCount);
+		TEST_CHECK(totalResumed == taskCount * resumesPerTask);
+		TEST_CHECK(frames >= taskCount * resumesPerTask / 10);
+
+		//Re-attaching moves the tick instead of adding a second one
+		TEST_CHECK(scheduler.attach(loader, "", "Player", "Update", 5));
+		TEST_CHECK(loader.method("", "Player", "Update").chain.size() == 1);
+
+		//Detached schedulers stop ticking
+		scheduler.detach();
+		int detachedProgress = 0;
+		scheduler.spawn(countFrames(1, detachedProgress));
+		runFrame(loader, player);
+		TEST_CHECK(detachedProgress == 0);
+		TEST_CHECK(scheduler.attach(loader, "", "Player", "Update"));
+		runFrame(loader, player);
+		TEST_CHECK(detachedProgress == 1);
+	}
+
+	//The scheduler unbinds its tick when destroyed, so the game keeps calling Update without it
+	TEST_CHECK(loader.method("", "Player", "Update").chain.empty());
+	int before = updateCalls;
+	runFrame(loader, player);
+	TEST_CHECK(updateCalls == before + 1);
+
+	return testResult("task_scheduler_test");
+}
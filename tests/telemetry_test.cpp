@@ -0,0 +1,120 @@
+//Hook telemetry: per hook and per mod counters, and a segment left behind by an earlier game run
+//	cl /std:c++20 /EHsc /O2 telemetry_test.cpp ..\il2cpp\il2cpp_context.cpp
+#include <cstdlib>
+#include <fstream>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+
+static void __thiscall update(void *) {
+}
+
+static int32_t __thiscall getHealth(void *, int32_t base) {
+	return base;
+}
+
+static const TelemetrySlot *findSlot(TelemetryHeader *header, TelemetrySlotKind kind, const char *name) {
+	TelemetrySlot *slots = TelemetrySegment::slots(header);
+	for (uint32_t i = 0; i < header->usedSlots.load(); ++i) {
+		if (slots[i].kind == kind && strcmp(slots[i].name, name) == 0) {
+			return &slots[i];
+		}
+	}
+	return nullptr;
+}
+
+int main() {
+	const char *file = "telemetry_test.shm";
+#ifdef _WIN32
+	_putenv_s("AUDICA_TELEMETRY_FILE", file);
+#else
+	setenv("AUDICA_TELEMETRY_FILE", file, 1);
+#endif
+
+	//A segment from an earlier run, whose process died holding the createLock
+	{
+		std::vector<uint8_t> stale(TelemetrySegment::byteSize(), 0);
+		TelemetryHeader *header = reinterpret_cast<TelemetryHeader *>(stale.data());
+		header->magic = TelemetryMagic;
+		header->version = TelemetryVersion;
+		header->slotCount = TelemetrySlotCount;
+		header->slotSize = sizeof(TelemetrySlot);
+		header->usedSlots.store(1);
+		header->createLock.store(1);
+		header->ownerProcessId.store(0xFFFFFFF0);
+		header->readyProcessId.store(0xFFFFFFF0);
+		TelemetrySlot *slot = TelemetrySegment::slots(header);
+		slot->kind = TelemetrySlotKind::Hook;
+		slot->rename("Player::Stale");
+		slot->calls.store(1234);
+
+		std::ofstream(file, std::ios::binary).write(reinterpret_cast<const char *>(stale.data()), stale.size());
+	}
+
+	FakeLoader loader;
+	loader.defineMethod("", "Player", "Update", &update);
+	loader.defineMethod("", "Player", "GetHealth", &getHealth);
+	FakeObject player;
+
+	TEST_CHECK(Telemetry::open("TelemetryTestMod"));
+	TelemetryHeader *header = TelemetrySegment::map(false);
+	TEST_CHECK(header != nullptr);
+	if (header == nullptr) {
+		return testResult("telemetry_test");
+	}
+	TEST_CHECK(findSlot(header, TelemetrySlotKind::Hook, "Player::Stale") == nullptr);
+	TEST_CHECK(header->createLock.load() == 0);
+
+	HookOptions sampled;
+	sampled.sampling.everyNth = 4;
+	loader.bindClassFunction("", "Player", "Update", InvokeTime::After, 0, [](const MethodInvocationContext &, ThisPtr) {
+	});
+	loader.bindClassFunction("", "Player", "GetHealth", InvokeTime::Before, 0, sampled, [](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+		return std::nullopt;
+	});
+	loader.bindClassFunction("", "Player", "GetHealth", InvokeTime::After, 0, [](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+		throw std::runtime_error("hook failed");
+	});
+
+	for (int i = 0; i < 8; ++i) {
+		loader.callMember<void>("", "Player", "Update", &player);
+		try {
+			loader.callMember<int32_t>("", "Player", "GetHealth", &player, 100);
+		}
+		catch (const std::runtime_error &) {
+		}
+	}
+
+	//Hook slots count the hook's own runs, the mod slot every run of the mod's hooks
+	const TelemetrySlot *updateSlot = findSlot(header, TelemetrySlotKind::Hook, "Player::Update");
+	const TelemetrySlot *modSlot = findSlot(header, TelemetrySlotKind::Mod, "TelemetryTestMod");
+	TEST_CHECK(updateSlot != nullptr && updateSlot->read().calls == 8);
+	TEST_CHECK(modSlot != nullptr && modSlot->read().calls == 8 + 2 + 8);
+	TEST_CHECK(modSlot != nullptr && modSlot->read().errors == 8);
+
+	uint64_t healthCalls = 0, healthErrors = 0;
+	TelemetrySlot *slots = TelemetrySegment::slots(header);
+	for (uint32_t i = 0; i < header->usedSlots.load(); ++i) {
+		if (strcmp(slots[i].name, "Player::GetHealth") == 0) {
+			healthCalls += slots[i].read().calls;
+			healthErrors += slots[i].read().errors;
+		}
+	}
+	TEST_CHECK(healthCalls == 2 + 8);
+	TEST_CHECK(healthErrors == 8);
+
+	//Names longer than a slot's are cut to fit it, the zone keeps the whole name
+	const char *longClass = "PlayerInventoryEquipmentController";
+	const char *longMethod = "RecalculateEquipmentBonuses";
+	std::string longName = std::string(longClass) + "::" + longMethod;
+	loader.defineMethod("", longClass, longMethod, &update);
+	loader.bindClassFunction("", longClass, longMethod, InvokeTime::After, 0, [](const MethodInvocationContext &, ThisPtr) {
+	});
+	loader.callMember<void>("", longClass, longMethod, &player);
+	const TelemetrySlot *longSlot = findSlot(header, TelemetrySlotKind::Hook, longName.substr(0, sizeof(longSlot->name) - 1).c_str());
+	TEST_CHECK(longSlot != nullptr && longSlot->read().calls == 1);
+	TEST_CHECK(std::string(loader.method("", longClass, longMethod).chain.front()->node->zoneName) == longName);
+
+	std::remove(file);
+	return testResult("telemetry_test");
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+//Shared helpers for the tests and benchmarks in this directory. Every .cpp here is a standalone program built
+//together with il2cpp_context.cpp, e.g.
+//
+//	cl /std:c++20 /EHsc /O2 gather_bench.cpp ..\il2cpp\il2cpp_context.cpp
+//
+//Tests return a non-zero exit code when a check fails. Benchmarks print their timings and check their results too,
+//so they double as tests. fake_loader.h stands in for the mod loader.
+
+inline int &testFailures() {
+	static int failures = 0;
+	return failures;
+}
+
+#define TEST_CHECK(_Cond) do { if (!(_Cond)) { printf("FAILED: %s:%d: %s\n", __FILE__, __LINE__, #_Cond); ++testFailures(); } } while (0)
+
+inline int testResult(const char *name) {
+	if (testFailures() != 0) {
+		printf("%s: %d check(s) failed\n", name, testFailures());
+		return 1;
+	}
+
+	printf("%s: passed\n", name);
+	return 0;
+}
+
+//Average nanoseconds per call of `fn` over `iterations` calls, after a short warm up
+template<typename Fn>
+double benchNs(uint32_t iterations, Fn &&fn) {
+	for (uint32_t i = 0; i < iterations / 10 + 1; ++i) {
+		fn(i);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		fn(i);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+//Keeps the optimizer from dropping a benchmarked result
+template<typename T>
+void benchKeep(const T &value) {
+	static volatile T sink;
+	sink = value;
+	(void)sink;
+}
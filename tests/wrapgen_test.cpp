@@ -0,0 +1,242 @@
+//il2cpp_wrapgen on a synthetic dump of several thousand classes: generation time, generated offsets and slots, names
+//that collide with namespaces, \u escapes in the dump, and the generated header compiling
+//	cl /std:c++20 /EHsc /O2 wrapgen_test.cpp ..\il2cpp\il2cpp_context.cpp
+//
+//Run from tests/ with the compiler on the PATH. WRAPGEN_TEST_CXX replaces the compile command, it gets the include
+//directories and the source file appended, e.g. WRAPGEN_TEST_CXX="clang++ -std=c++20 -fsyntax-only"
+#define IL2CPP_WRAPGEN_NO_MAIN
+#include "../tools/il2cpp_wrapgen/il2cpp_wrapgen.cpp"
+
+#include <filesystem>
+
+#include "test_harness.h"
+
+static bool contains(const std::string &text, const std::string &part) {
+	return text.find(part) != std::string::npos;
+}
+
+static bool parseJson(const std::string &text, JsonValue &value) {
+	JsonParser parser(text.data(), text.data() + text.size());
+	return parser.parse(value);
+}
+
+static std::string parseJsonString(const std::string &literal) {
+	JsonValue value;
+	if (!parseJson(literal, value) || value.type != JsonValue::Type::String) {
+		return "<invalid>";
+	}
+	return value.string;
+}
+
+//Namespaces Game.System0 to Game.System15, classes in chains of 8 deriving from each other. Every class has a few
+//primitive fields, a reference to the previous class, and methods with and without overloads
+static std::string syntheticDump(uint32_t classCount) {
+	std::string json = "{ \"classes\": [\n";
+	json += "{ \"namespace\": \"Game\", \"name\": \"Mode\", \"enumType\": \"System.Int32\" },\n";
+	json += "{ \"namespace\": \"Game\", \"name\": \"Vector\", \"valueType\": true },\n";
+
+	for (uint32_t i = 0; i < classCount; ++i) {
+		std::string ns = "Game.System" + std::to_string(i % 16);
+		std::string name = "Class" + std::to_string(i);
+		json += "{ \"namespace\": \"" + ns + "\", \"name\": \"" + name + "\"";
+		if (i >= 16 && (i / 16) % 8 != 0) {
+			json += ", \"parent\": \"" + ns + ".Class" + std::to_string(i - 16) + "\"";
+		}
+
+		size_t base = 0x10 + ((i / 16) % 8) * 0x20;
+		json += ", \"fields\": [ ";
+		json += "{ \"name\": \"mCount\", \"type\": \"System.Int32\", \"offset\": " + std::to_string(base) + " }, ";
+		json += "{ \"name\": \"mSpeed\", \"type\": \"System.Single\", \"offset\": " + std::to_string(base + 4) + " }, ";
+		json += "{ \"name\": \"mMode\", \"type\": \"Game.Mode\", \"offset\": " + std::to_string(base + 8) + " }, ";
+		json += "{ \"name\": \"<Owner>k__BackingField\", \"type\": \"Game.System0.Class0\", \"offset\": " + std::to_string(base + 16) + " }, ";
+		json += "{ \"name\": \"mPosition\", \"type\": \"Game.Vector\", \"offset\": " + std::to_string(base + 24) + ", \"valueType\": true }, ";
+		json += "{ \"name\": \"sInstances\", \"type\": \"System.Int32\", \"offset\": 0, \"static\": true } ";
+		json += "], \"methods\": [ ";
+		json += "{ \"name\": \"Update\", \"returnType\": \"System.Void\" }, ";
+		json += "{ \"name\": \"Add" + std::to_string(i) + "\", \"returnType\": \"System.Int32\", \"parameters\": [ { \"name\": \"amount\", \"type\": \"System.Int32\" } ] }, ";
+		json += "{ \"name\": \"Add" + std::to_string(i) + "\", \"returnType\": \"System.Int32\", \"parameters\": [ { \"name\": \"a\", \"type\": \"System.Int32\" }, { \"name\": \"b\", \"type\": \"System.Single\" } ] }, ";
+		json += "{ \"name\": \"Add" + std::to_string(i) + "\", \"returnType\": \"System.Int32\", \"parameters\": [ { \"name\": \"c\", \"type\": \"System.Int64\" } ] }, ";
+		json += "{ \"name\": \"Create\", \"returnType\": \"" + ns + "." + name + "\", \"static\": true, \"parameters\": [ { \"name\": \"seed\", \"type\": \"System.UInt32\" } ] } ";
+		json += "] },\n";
+	}
+
+	//Class names that are also namespaces, or a prefix of one
+	json += "{ \"namespace\": \"\", \"name\": \"Game\", \"fields\": [ { \"name\": \"mLevel\", \"type\": \"System.Int32\", \"offset\": 16 } ] },\n";
+	json += "{ \"namespace\": \"Game\", \"name\": \"System3\" },\n";
+	json += "{ \"namespace\": \"\", \"name\": \"il2cpp_gen\" },\n";
+	json += "{ \"namespace\": \"Game.System3\", \"name\": \"Game\", \"parent\": \"Game\" },\n";
+
+	//Names outside the BMP are written as surrogate pairs by most dumpers
+	json += "{ \"namespace\": \"\", \"name\": \"Note\\ud83c\\udfb5\", \"fields\": [ { \"name\": \"caf\\u00e9\", \"type\": \"System.Int32\", \"offset\": 20 } ] }\n";
+	json += "] }\n";
+	return json;
+}
+
+//Uses accessors, setters, slots and bind() of a few generated classes, including the renamed ones
+static const char *const CompileCheckSource = R"(#include "il2cpp_generated.h"
+
+int32_t useGenerated(const il2cpp_context &ctx, void *ptr) {
+	bool ok = il2cpp_gen::bindAll(ctx);
+	ok &= il2cpp_gen::Game::System1::Class17::bind(ctx);
+
+	il2cpp_gen::Game::System1::Class17 object(ptr);
+	object.set_mCount(object.mCount() + 1);
+	object.set_mSpeed(object.mSpeed() * 2.0f);
+	il2cpp_gen::Game::System0::Class0 owner = object._Owner_k__BackingField();
+	object.set__Owner_k__BackingField(owner);
+	object.Update();
+	int32_t total = object.Add17(1) + object.Add17(2, object.mSpeed()) + object.mMode();
+
+	//Inherited accessors and methods
+	il2cpp_gen::Game::System1::Class33 derived(ptr);
+	total += derived.mCount() + derived.Add33(3) + derived.Add17(4);
+	il2cpp_gen::Game::System1::Class1 base = derived;
+	total += base.mCount();
+
+	il2cpp_gen::Game::System9::Class4761 created = il2cpp_gen::Game::System9::Class4761::Create(7u);
+	total += created.Add4761(5);
+	ok &= il2cpp_gen::Game::System1::Class17::Slot_Add17_1.fn != nullptr;
+	ok &= il2cpp_gen::Game::System9::Class4761::Slot_Create_1.fn != nullptr;
+	static_assert(il2cpp_gen::Game::System1::Class17::Offset_mCount == 0x30);
+
+	il2cpp_gen::Game_ game(ptr);
+	il2cpp_gen::Game::System3::Game nested(ptr);
+	total += game.mLevel() + nested.mLevel();
+	il2cpp_gen::Note____ note(ptr);
+	note.set_caf__(note.caf__() + 1);
+	return ok ? total : -1;
+}
+)";
+
+//Writes the header and a translation unit using it to a temp directory and compiles the unit. Returns false if the
+//compiler rejects it
+static bool compileGenerated(const std::string &header) {
+	std::filesystem::path il2cppDir = std::filesystem::absolute(__FILE__).parent_path().parent_path() / "il2cpp";
+	if (!std::filesystem::exists(il2cppDir / "il2cpp_wrappers.h")) {
+		printf("ERROR: wrapgen_test: il2cpp_wrappers.h not found in %s, run the test from tests/\n", il2cppDir.string().c_str());
+		return false;
+	}
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path() / "wrapgen_test";
+	std::filesystem::create_directories(dir);
+	std::ofstream(dir / "il2cpp_generated.h", std::ios::binary) << header;
+	std::ofstream(dir / "wrapgen_compile.cpp", std::ios::binary) << CompileCheckSource;
+
+	const char *custom = std::getenv("WRAPGEN_TEST_CXX");
+#ifdef _MSC_VER
+	std::string command = custom != nullptr ? custom : "cl /nologo /std:c++20 /EHsc /Zs";
+#else
+	std::string command = custom != nullptr ? custom : "c++ -std=c++20 -fsyntax-only";
+#endif
+	command += " -I\"" + il2cppDir.string() + "\" -I\"" + dir.string() + "\" \"" + (dir / "wrapgen_compile.cpp").string() + "\"";
+
+	auto start = std::chrono::steady_clock::now();
+	int status = std::system(command.c_str());
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (status != 0) {
+		printf("ERROR: wrapgen_test: the generated header doesn't compile (%d): %s\n", status, command.c_str());
+		return false;
+	}
+
+	printf("generated header compiled in %.1f s\n", seconds);
+	std::filesystem::remove_all(dir);
+	return true;
+}
+
+int main() {
+	//\u escapes: BMP characters, surrogate pairs, unpaired surrogates and broken escapes
+	TEST_CHECK(parseJsonString("\"caf\\u00e9\"") == "caf\xC3\xA9");
+	TEST_CHECK(parseJsonString("\"\\u20AC\"") == "\xE2\x82\xAC");
+	TEST_CHECK(parseJsonString("\"\\ud83c\\udfb5\"") == "\xF0\x9F\x8E\xB5");
+	TEST_CHECK(parseJsonString("\"\\uD83D\\uDE00!\"") == "\xF0\x9F\x98\x80!");
+	TEST_CHECK(parseJsonString("\"\\ud83c\"") == "\xEF\xBF\xBD");
+	TEST_CHECK(parseJsonString("\"\\udfb5x\"") == "\xEF\xBF\xBDx");
+	TEST_CHECK(parseJsonString("\"\\ud83c\\u0041\"") == "\xEF\xBF\xBD" "A");
+	TEST_CHECK(parseJsonString("\"\\u12\"") == "<invalid>");
+	TEST_CHECK(parseJsonString("\"\\u12g4\"") == "<invalid>");
+	TEST_CHECK(parseJsonString("\"\\ud83c\\uzzzz\"") == "<invalid>");
+
+	const uint32_t classCount = 5000;
+	std::string json = syntheticDump(classCount);
+
+	auto start = std::chrono::steady_clock::now();
+	JsonValue dump;
+	TEST_CHECK(parseJson(json, dump));
+	WrapperGenerator generator("il2cpp_gen", "il2cpp_wrappers.h");
+	TEST_CHECK(generator.load(dump));
+	std::string header = generator.generate("synthetic.json");
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("%u classes (%zu KB of JSON) generated %zu KB in %.1f ms\n", classCount, json.size() / 1024, header.size() / 1024, ms);
+
+	//Generation is meant to be rerun on every game update, so it has to stay well under a second
+	TEST_CHECK(ms < 2000.0);
+
+	//Every reference type is wrapped, the enum and the value type struct are not
+	TEST_CHECK(generator.wrappedClasses() == classCount + 5);
+	TEST_CHECK(!contains(header, "struct Mode "));
+	TEST_CHECK(!contains(header, "struct Vector "));
+
+	//Offsets are baked in as constants, accessors are direct loads
+	TEST_CHECK(contains(header, "\tstruct Class17 : ::il2cpp_gen::Game::System1::Class1 {\n"));
+	TEST_CHECK(contains(header, "\tstruct Class128 : ::il2cppapi::TypedObject {\n"));
+	TEST_CHECK(contains(header, "\t\tstatic constexpr size_t Offset_mCount = 0x30;\n"));
+	TEST_CHECK(contains(header, "\t\treturn load<int32_t, Offset_mCount>();\n"));
+	TEST_CHECK(contains(header, "\t\t::il2cpp_gen::Game::System0::Class0 _Owner_k__BackingField() const;\n"));
+	TEST_CHECK(contains(header, "\t\tint32_t mMode() const;\n"));
+	TEST_CHECK(contains(header, "ok &= ::il2cppapi::verifyFieldOffset(*klass, Name, \"mSpeed\", Offset_mSpeed);\n"));
+
+	//Methods get a slot each, overloads only when the argument count tells them apart
+	TEST_CHECK(contains(header, "\t\tstatic inline ::il2cppapi::MethodSlot<int32_t(int32_t)> Slot_Add42_1;\n"));
+	TEST_CHECK(contains(header, "\t\tstatic inline ::il2cppapi::MethodSlot<int32_t(int32_t, float)> Slot_Add42_2;\n"));
+	TEST_CHECK(contains(header, "\t//Skipped method Add42/1: ambiguous overload\n"));
+	TEST_CHECK(contains(header, "\t//Skipped field mPosition: unsupported type Game.Vector\n"));
+	TEST_CHECK(contains(header, "\t//Skipped field sInstances: static\n"));
+	TEST_CHECK(contains(header, "\t\tstatic inline ::il2cppapi::StaticMethodSlot<void *(uint32_t)> Slot_Create_1;\n"));
+	TEST_CHECK(contains(header, "\t\tstatic ::il2cpp_gen::Game::System9::Class9 Create(uint32_t a0_seed);\n"));
+
+	//A class can't be declared with the name of a namespace the output also opens, it is renamed instead
+	TEST_CHECK(contains(header, "namespace il2cpp_gen { struct Game_; }\n"));
+	TEST_CHECK(contains(header, "namespace il2cpp_gen::Game { struct System3_; }\n"));
+	TEST_CHECK(contains(header, "namespace il2cpp_gen { struct il2cpp_gen; }\n"));
+	TEST_CHECK(contains(header, "namespace il2cpp_gen::Game::System3 { struct Game; }\n"));
+	TEST_CHECK(contains(header, "\tstruct Game : ::il2cpp_gen::Game_ {\n"));
+	TEST_CHECK(contains(header, "\t\tstatic constexpr const char *Name = \"Game\";\n"));
+	TEST_CHECK(contains(header, "\t\tok &= ::il2cpp_gen::Game_::bind(ctx);\n"));
+	TEST_CHECK(contains(header, "\t\tok &= ::il2cpp_gen::il2cpp_gen::bind(ctx);\n"));
+
+	//No forward declared struct shares its qualified name with an opened namespace
+	std::set<std::string> namespaces;
+	std::vector<std::string> structs;
+	std::istringstream lines(header);
+	for (std::string line; std::getline(lines, line);) {
+		if (line.rfind("namespace ", 0) != 0) {
+			continue;
+		}
+		size_t open = line.find(" {");
+		std::string ns = line.substr(10, open - 10);
+		for (size_t at = ns.find("::"); at != std::string::npos; at = ns.find("::", at + 2)) {
+			namespaces.insert(ns.substr(0, at));
+		}
+		namespaces.insert(ns);
+
+		size_t declared = line.find("{ struct ");
+		if (declared != std::string::npos) {
+			structs.push_back(ns + "::" + line.substr(declared + 9, line.find(';') - declared - 9));
+		}
+	}
+	TEST_CHECK(structs.size() == classCount + 5);
+	size_t clashes = 0;
+	for (const std::string &name : structs) {
+		clashes += namespaces.count(name);
+	}
+	TEST_CHECK(clashes == 0);
+
+	//Decoded names end up as UTF-8 in the strings bind() looks up, and as identifiers only after sanitizing
+	TEST_CHECK(contains(header, "\t\tstatic constexpr const char *Name = \"Note\xF0\x9F\x8E\xB5\";\n"));
+	TEST_CHECK(contains(header, "struct Note____ : ::il2cppapi::TypedObject {\n"));
+	TEST_CHECK(contains(header, "ok &= ::il2cppapi::verifyFieldOffset(*klass, Name, \"caf\xC3\xA9\", Offset_caf__);\n"));
+
+	TEST_CHECK(compileGenerated(header));
+
+	return testResult("wrapgen_test");
+}
@@ -0,0 +1,128 @@
+//Cost of a ZONE with tracing off and on, and of the dispatch zone around hooks when calls alternate between methods
+//	cl /std:c++20 /EHsc /O2 zones_bench.cpp ..\il2cpp\il2cpp_context.cpp
+#include <fstream>
+#include <sstream>
+
+#include "test_harness.h"
+#include "fake_loader.h"
+
+static __declspec(noinline) int32_t work(int32_t value) {
+	return value * 3 + 1;
+}
+
+static __declspec(noinline) int32_t zonedWork(int32_t value) {
+	ZONE("zonedWork");
+	return value * 3 + 1;
+}
+
+static int32_t __thiscall getScore(void *, int32_t base) {
+	return base * 10;
+}
+
+static int32_t __thiscall getBonus(void *, int32_t base) {
+	return base + 5;
+}
+
+static size_t countZones(const std::string &trace, const std::string &name) {
+	std::string key = "{\"name\":\"" + name + "\"";
+	size_t count = 0;
+	for (size_t at = trace.find(key); at != std::string::npos; at = trace.find(key, at + 1)) {
+		++count;
+	}
+	return count;
+}
+
+static std::string readFile(const char *path) {
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream text;
+	text << file.rdbuf();
+	return text.str();
+}
+
+int main() {
+	FakeLoader loader;
+	loader.defineMethod("", "Target", "GetScore", &getScore);
+	loader.defineMethod("", "Target", "GetBonus", &getBonus);
+	FakeLoader::Method &getScoreMethod = loader.method("", "Target", "GetScore");
+	FakeLoader::Method &getBonusMethod = loader.method("", "Target", "GetBonus");
+	FakeObject target;
+	const uint32_t iterations = 2000000;
+	const uint32_t hookIterations = 200000;
+	const char *tracePath = "zones_bench.json";
+
+	int hookRuns = 0;
+	auto bind = [&](const char *methodName, int priority) {
+		return loader.bindClassFunction("", "Target", methodName, InvokeTime::Before, priority, [&hookRuns](const MethodInvocationContext &, ThisPtr, int32_t) -> std::optional<int32_t> {
+			++hookRuns;
+			return std::nullopt;
+		});
+	};
+	HookHandle scoreHook = bind("GetScore", 0);
+	HookHandle bonusHook = bind("GetBonus", 0);
+
+	//Every call switches method, which defeated the old per-thread name cache
+	uint32_t scoreCalls = 0;
+	uint32_t bonusCalls = 0;
+	auto alternate = [&](uint32_t i) {
+		if (i & 1) {
+			++scoreCalls;
+			benchKeep(loader.callMember<int32_t>(getScoreMethod, &target, (int32_t)i));
+		}
+		else {
+			++bonusCalls;
+			benchKeep(loader.callMember<int32_t>(getBonusMethod, &target, (int32_t)i));
+		}
+	};
+
+	double plainNs = benchNs(iterations, [&](uint32_t i) { benchKeep(work((int32_t)i)); });
+	double offNs = benchNs(iterations, [&](uint32_t i) { benchKeep(zonedWork((int32_t)i)); });
+	double singleOffNs = benchNs(hookIterations, alternate);
+
+	//A second hook on each method moves them from the single node route to the chain route
+	loader.routeSingleHooks = false;
+	HookHandle scoreHook2 = bind("GetScore", 1);
+	HookHandle bonusHook2 = bind("GetBonus", 1);
+	double chainOffNs = benchNs(hookIterations, alternate);
+	loader.routeSingleHooks = true;
+	TEST_CHECK(loader.unbind(scoreHook2));
+	TEST_CHECK(loader.unbind(bonusHook2));
+
+	//The names were resolved once at bind time, hooks on the same method share one copy
+	TEST_CHECK(getScoreMethod.chain.size() == 1 && getBonusMethod.chain.size() == 1);
+	const char *scoreName = getScoreMethod.chain.front()->node->zoneName;
+	TEST_CHECK(scoreName != nullptr && std::string(scoreName) == "Target::GetScore");
+	TEST_CHECK(std::string(getBonusMethod.chain.front()->node->zoneName) == "Target::GetBonus");
+	TEST_CHECK(Zones::intern("Target::GetScore") == scoreName);
+
+	TEST_CHECK(Zones::start(tracePath));
+	scoreCalls = 0;
+	bonusCalls = 0;
+	double onNs = benchNs(iterations, [&](uint32_t i) { benchKeep(zonedWork((int32_t)i)); });
+	double singleOnNs = benchNs(hookIterations, alternate);
+
+	loader.routeSingleHooks = false;
+	scoreHook2 = bind("GetScore", 1);
+	bonusHook2 = bind("GetBonus", 1);
+	double chainOnNs = benchNs(hookIterations, alternate);
+	Zones::stop();
+
+	printf("plain call %.1f ns, zone off %.1f ns, zone on %.1f ns\n", plainNs, offNs, onNs);
+	printf("alternating hooks, single route: off %.1f ns/call, on %.1f ns/call; chain route: off %.1f ns/call, on %.1f ns/call\n",
+		singleOffNs, singleOnNs, chainOffNs, chainOnNs);
+
+	//One zone per dispatch, named after the method it dispatched, in both routes
+	std::string trace = readFile(tracePath);
+	TEST_CHECK(countZones(trace, "zonedWork") == iterations + iterations / 10 + 1);
+	TEST_CHECK(countZones(trace, "Target::GetScore") == scoreCalls);
+	TEST_CHECK(countZones(trace, "Target::GetBonus") == bonusCalls);
+	TEST_CHECK(countZones(trace, "Hook dispatch") == 0);
+	TEST_CHECK(trace.size() > 2 && trace[0] == '[' && trace[trace.size() - 2] == ']');
+	TEST_CHECK(hookRuns > 0);
+
+	TEST_CHECK(loader.unbind(scoreHook));
+	TEST_CHECK(loader.unbind(bonusHook));
+	TEST_CHECK(loader.unbind(scoreHook2));
+	TEST_CHECK(loader.unbind(bonusHook2));
+	std::remove(tracePath);
+	return testResult("zones_bench");
+}
@@ -0,0 +1,925 @@
+//Generates typed C++ wrappers from an il2cpp metadata dump, for use with il2cpp/il2cpp_wrappers.h
+//
+//	g++ -std=c++17 -O2 -o il2cpp_wrapgen il2cpp_wrapgen.cpp
+//
+//tests/wrapgen_test.cpp includes this file with IL2CPP_WRAPGEN_NO_MAIN defined to run the generator in process.
+//	./il2cpp_wrapgen dump.json il2cpp_generated.h [--namespace il2cpp_gen] [--include il2cpp_wrappers.h]
+//
+//The dump is a JSON document listing every class to wrap:
+//
+//	{ "classes": [ {
+//		"namespace": "", "name": "ScoreKeeper", "parent": "UnityEngine.MonoBehaviour",
+//		"valueType": false, "enumType": "System.Int32",				//enumType only for enums
+//		"fields": [ { "name": "mScore", "type": "System.Int32", "offset": 16, "static": false, "valueType": true } ],
+//		"methods": [ { "name": "AddScore", "returnType": "System.Void", "static": false,
+//			"parameters": [ { "name": "amount", "type": "System.Int32" } ] } ]
+//	} ] }
+//
+//Primitive fields and parameters become their C++ types and enums their underlying type. Reference types become the
+//generated wrapper when the class is in the dump, il2cppapi::TypedObject otherwise. Value type structs, static fields
+//and methods that can't be told apart by name and argument count are skipped with a comment in the output.
+//A class whose name is also a namespace path (`Game` next to `Game.UI`) gets a trailing `_` on its C++ name.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct JsonValue {
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	const JsonValue *get(const char *key) const {
+		for (auto &member : object) {
+			if (member.first == key) {
+				return &member.second;
+			}
+		}
+		return nullptr;
+	}
+
+	std::string getString(const char *key, const char *fallback = "") const {
+		const JsonValue *value = get(key);
+		return value && value->type == Type::String ? value->string : fallback;
+	}
+
+	bool getBool(const char *key, bool fallback = false) const {
+		const JsonValue *value = get(key);
+		return value && value->type == Type::Bool ? value->boolean : fallback;
+	}
+
+	double getNumber(const char *key, double fallback = 0.0) const {
+		const JsonValue *value = get(key);
+		return value && value->type == Type::Number ? value->number : fallback;
+	}
+
+	const std::vector<JsonValue> &getArray(const char *key) const {
+		static const std::vector<JsonValue> empty;
+		const JsonValue *value = get(key);
+		return value && value->type == Type::Array ? value->array : empty;
+	}
+};
+
+class JsonParser {
+public:
+	JsonParser(const char *begin, const char *end) : mBegin(begin), mPos(begin), mEnd(end) {}
+
+	bool parse(JsonValue &value) {
+		if (!parseValue(value)) {
+			return false;
+		}
+		skipWhitespace();
+		return mPos == mEnd || fail("trailing characters");
+	}
+
+	const std::string &error() const {
+		return mError;
+	}
+
+private:
+	bool fail(const char *message) {
+		if (mError.empty()) {
+			mError = std::string(message) + " at byte " + std::to_string(mPos - mBegin);
+		}
+		return false;
+	}
+
+	void skipWhitespace() {
+		while (mPos < mEnd && (*mPos == ' ' || *mPos == '\t' || *mPos == '\n' || *mPos == '\r')) {
+			++mPos;
+		}
+	}
+
+	bool consume(const char *literal) {
+		size_t length = strlen(literal);
+		if ((size_t)(mEnd - mPos) < length || strncmp(mPos, literal, length) != 0) {
+			return false;
+		}
+		mPos += length;
+		return true;
+	}
+
+	bool parseValue(JsonValue &value) {
+		skipWhitespace();
+		if (mPos == mEnd) {
+			return fail("unexpected end of input");
+		}
+
+		switch (*mPos) {
+		case '{': return parseObject(value);
+		case '[': return parseArray(value);
+		case '"':
+			value.type = JsonValue::Type::String;
+			return parseString(value.string);
+		case 't':
+		case 'f':
+			value.type = JsonValue::Type::Bool;
+			value.boolean = *mPos == 't';
+			return consume(value.boolean ? "true" : "false") || fail("invalid literal");
+		case 'n':
+			value.type = JsonValue::Type::Null;
+			return consume("null") || fail("invalid literal");
+		default:
+			return parseNumber(value);
+		}
+	}
+
+	bool parseNumber(JsonValue &value) {
+		char *end = nullptr;
+		std::string text(mPos, std::min<size_t>(mEnd - mPos, 64));
+		value.type = JsonValue::Type::Number;
+		value.number = strtod(text.c_str(), &end);
+		if (end == text.c_str()) {
+			return fail("invalid value");
+		}
+		mPos += end - text.c_str();
+		return true;
+	}
+
+	static void appendUtf8(std::string &out, uint32_t codepoint) {
+		if (codepoint < 0x80) {
+			out += (char)codepoint;
+		}
+		else if (codepoint < 0x800) {
+			out += (char)(0xC0 | (codepoint >> 6));
+			out += (char)(0x80 | (codepoint & 0x3F));
+		}
+		else if (codepoint < 0x10000) {
+			out += (char)(0xE0 | (codepoint >> 12));
+			out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codepoint & 0x3F));
+		}
+		else {
+			out += (char)(0xF0 | (codepoint >> 18));
+			out += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+			out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codepoint & 0x3F));
+		}
+	}
+
+	//Reads the 4 hex digits after a \u
+	bool parseHex4(uint32_t &value) {
+		if (mEnd - mPos < 4) {
+			return fail("invalid unicode escape");
+		}
+
+		value = 0;
+		for (int i = 0; i < 4; ++i) {
+			char c = *mPos++;
+			uint32_t digit;
+			if (c >= '0' && c <= '9') {
+				digit = c - '0';
+			}
+			else if (c >= 'a' && c <= 'f') {
+				digit = c - 'a' + 10;
+			}
+			else if (c >= 'A' && c <= 'F') {
+				digit = c - 'A' + 10;
+			}
+			else {
+				--mPos;
+				return fail("invalid unicode escape");
+			}
+			value = (value << 4) | digit;
+		}
+		return true;
+	}
+
+	//Characters outside the BMP are escaped as a UTF-16 surrogate pair. An unpaired surrogate becomes U+FFFD
+	bool parseUnicodeEscape(std::string &out) {
+		uint32_t codepoint = 0;
+		if (!parseHex4(codepoint)) {
+			return false;
+		}
+
+		if (codepoint >= 0xD800 && codepoint <= 0xDBFF && mEnd - mPos >= 6 && mPos[0] == '\\' && mPos[1] == 'u') {
+			const char *pairStart = mPos;
+			mPos += 2;
+			uint32_t low = 0;
+			if (!parseHex4(low)) {
+				return false;
+			}
+			if (low >= 0xDC00 && low <= 0xDFFF) {
+				appendUtf8(out, 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00));
+				return true;
+			}
+
+			//Not a low surrogate, so it is decoded on its own by the next iteration
+			mPos = pairStart;
+		}
+
+		if (codepoint >= 0xD800 && codepoint <= 0xDFFF) {
+			codepoint = 0xFFFD;
+		}
+		appendUtf8(out, codepoint);
+		return true;
+	}
+
+	bool parseString(std::string &out) {
+		++mPos;
+		while (mPos < mEnd && *mPos != '"') {
+			char c = *mPos++;
+			if (c != '\\') {
+				out += c;
+				continue;
+			}
+
+			if (mPos == mEnd) {
+				return fail("unterminated escape");
+			}
+			switch (char escaped = *mPos++) {
+			case 'n': out += '\n'; break;
+			case 't': out += '\t'; break;
+			case 'r': out += '\r'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'u':
+				if (!parseUnicodeEscape(out)) {
+					return false;
+				}
+				break;
+			default: out += escaped; break;
+			}
+		}
+
+		if (mPos == mEnd) {
+			return fail("unterminated string");
+		}
+		++mPos;
+		return true;
+	}
+
+	bool parseArray(JsonValue &value) {
+		value.type = JsonValue::Type::Array;
+		++mPos;
+		skipWhitespace();
+		if (mPos < mEnd && *mPos == ']') {
+			++mPos;
+			return true;
+		}
+
+		for (;;) {
+			value.array.emplace_back();
+			if (!parseValue(value.array.back())) {
+				return false;
+			}
+			skipWhitespace();
+			if (mPos < mEnd && *mPos == ',') {
+				++mPos;
+				continue;
+			}
+			if (mPos < mEnd && *mPos == ']') {
+				++mPos;
+				return true;
+			}
+			return fail("expected , or ]");
+		}
+	}
+
+	bool parseObject(JsonValue &value) {
+		value.type = JsonValue::Type::Object;
+		++mPos;
+		skipWhitespace();
+		if (mPos < mEnd && *mPos == '}') {
+			++mPos;
+			return true;
+		}
+
+		for (;;) {
+			skipWhitespace();
+			if (mPos == mEnd || *mPos != '"') {
+				return fail("expected member name");
+			}
+
+			value.object.emplace_back();
+			if (!parseString(value.object.back().first)) {
+				return false;
+			}
+			skipWhitespace();
+			if (mPos == mEnd || *mPos != ':') {
+				return fail("expected :");
+			}
+			++mPos;
+			if (!parseValue(value.object.back().second)) {
+				return false;
+			}
+
+			skipWhitespace();
+			if (mPos < mEnd && *mPos == ',') {
+				++mPos;
+				continue;
+			}
+			if (mPos < mEnd && *mPos == '}') {
+				++mPos;
+				return true;
+			}
+			return fail("expected , or }");
+		}
+	}
+
+	const char *mBegin;
+	const char *mPos;
+	const char *mEnd;
+	std::string mError;
+};
+
+struct FieldInfo {
+	std::string name;
+	std::string type;
+	size_t offset = 0;
+	bool isStatic = false;
+	bool valueType = false;
+};
+
+struct ParameterInfo {
+	std::string name;
+	std::string type;
+	bool valueType = false;
+};
+
+struct MethodInfo {
+	std::string name;
+	std::string returnType;
+	bool returnValueType = false;
+	bool isStatic = false;
+	std::vector<ParameterInfo> parameters;
+};
+
+struct ClassInfo {
+	std::string namespaceName;
+	std::string name;
+	std::string parent;
+	std::string enumType;
+	bool valueType = false;
+	std::vector<FieldInfo> fields;
+	std::vector<MethodInfo> methods;
+
+	//Filled in by the generator
+	std::string cppName;
+	std::string cppNamespace;
+	std::string qualifiedName;
+	int parentIndex = -1;
+};
+
+//How a dumped type shows up in C++. `abi` is what the native method pointer takes or returns
+struct TypeMapping {
+	bool supported = false;
+	bool isWrapper = false;
+	std::string cpp;
+	std::string abi;
+};
+
+class WrapperGenerator {
+public:
+	WrapperGenerator(std::string rootNamespace, std::string include) : mRootNamespace(std::move(rootNamespace)), mInclude(std::move(include)) {}
+
+	bool load(const JsonValue &dump) {
+		const JsonValue *classes = dump.get("classes");
+		if (classes == nullptr || classes->type != JsonValue::Type::Array) {
+			fprintf(stderr, "ERROR: The dump has no \"classes\" array\n");
+			return false;
+		}
+
+		mClasses.reserve(classes->array.size());
+		for (const JsonValue &klass : classes->array) {
+			ClassInfo info;
+			info.namespaceName = klass.getString("namespace");
+			info.name = klass.getString("name");
+			info.parent = klass.getString("parent");
+			info.enumType = klass.getString("enumType");
+			info.valueType = klass.getBool("valueType") || !info.enumType.empty();
+
+			for (const JsonValue &field : klass.getArray("fields")) {
+				FieldInfo fieldInfo;
+				fieldInfo.name = field.getString("name");
+				fieldInfo.type = field.getString("type");
+				fieldInfo.offset = (size_t)field.getNumber("offset");
+				fieldInfo.isStatic = field.getBool("static");
+				fieldInfo.valueType = field.getBool("valueType");
+				info.fields.push_back(std::move(fieldInfo));
+			}
+
+			for (const JsonValue &method : klass.getArray("methods")) {
+				MethodInfo methodInfo;
+				methodInfo.name = method.getString("name");
+				methodInfo.returnType = method.getString("returnType", "System.Void");
+				methodInfo.returnValueType = method.getBool("returnValueType");
+				methodInfo.isStatic = method.getBool("static");
+				for (const JsonValue &parameter : method.getArray("parameters")) {
+					methodInfo.parameters.push_back({ parameter.getString("name"), parameter.getString("type"), parameter.getBool("valueType") });
+				}
+				info.methods.push_back(std::move(methodInfo));
+			}
+
+			if (info.name.empty()) {
+				fprintf(stderr, "WARNING: Skipping a class without a name\n");
+				continue;
+			}
+			mClasses.push_back(std::move(info));
+		}
+
+		resolveNames();
+		return true;
+	}
+
+	std::string generate(const std::string &source) {
+		std::ostringstream out;
+		out << "#pragma once\n";
+		out << "//Generated by il2cpp_wrapgen from " << source << ", do not edit.\n";
+		out << "//Regenerate whenever the game updates, bind() reports any offset that no longer matches\n";
+		out << "#include \"" << mInclude << "\"\n\n";
+
+		std::vector<size_t> order = emitOrder();
+
+		for (size_t index : order) {
+			const ClassInfo &klass = mClasses[index];
+			out << "namespace " << klass.cppNamespace << " { struct " << klass.cppName << "; }\n";
+		}
+		out << "\n";
+
+		for (size_t index : order) {
+			emitDeclaration(out, mClasses[index]);
+		}
+		for (size_t index : order) {
+			emitDefinitions(out, mClasses[index]);
+		}
+
+		out << "namespace " << mRootNamespace << " {\n";
+		out << "\t//Binds every generated wrapper, returns false if any class, offset or method didn't match\n";
+		out << "\tinline bool bindAll(const ::il2cpp_context &ctx) {\n";
+		out << "\t\tbool ok = true;\n";
+		for (size_t index : order) {
+			out << "\t\tok &= ::" << mClasses[index].qualifiedName << "::bind(ctx);\n";
+		}
+		out << "\t\treturn ok;\n";
+		out << "\t}\n";
+		out << "}\n";
+		return out.str();
+	}
+
+	size_t wrappedClasses() const {
+		return emitOrder().size();
+	}
+
+private:
+	static bool isKeyword(const std::string &name) {
+		static const std::set<std::string> keywords = {
+			"alignas", "alignof", "and", "asm", "auto", "bool", "break", "case", "catch", "char", "class", "const", "constexpr",
+			"const_cast", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit",
+			"export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace",
+			"new", "noexcept", "not", "nullptr", "operator", "or", "private", "protected", "public", "register", "reinterpret_cast",
+			"return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template", "this",
+			"throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+			"wchar_t", "while", "xor", "size_t", "int8_t", "int16_t", "int32_t", "int64_t", "uint8_t", "uint16_t", "uint32_t", "uint64_t"
+		};
+		return keywords.count(name) != 0;
+	}
+
+	//C# names can contain <>, `, / and friends (backing fields, generics, nested classes)
+	static std::string sanitize(const std::string &name) {
+		std::string out;
+		for (char c : name) {
+			out += (isalnum((unsigned char)c) || c == '_') ? c : '_';
+		}
+		if (out.empty() || isdigit((unsigned char)out[0])) {
+			out = "_" + out;
+		}
+		if (isKeyword(out) || out.rfind("__", 0) == 0) {
+			out += "_";
+		}
+		return out;
+	}
+
+	static std::string fullName(const std::string &namespaceName, const std::string &name) {
+		return namespaceName.empty() ? name : namespaceName + "." + name;
+	}
+
+	void resolveNames() {
+		//Every namespace the output opens, including the enclosing ones. A struct can't share a name with any of them
+		std::set<std::string> namespaces;
+		for (ClassInfo &klass : mClasses) {
+			klass.cppNamespace = mRootNamespace;
+			namespaces.insert(klass.cppNamespace);
+
+			std::string part;
+			for (char c : klass.namespaceName + ".") {
+				if (c == '.') {
+					if (!part.empty()) {
+						klass.cppNamespace += "::" + sanitize(part);
+						namespaces.insert(klass.cppNamespace);
+					}
+					part.clear();
+				}
+				else {
+					part += c;
+				}
+			}
+		}
+
+		std::set<std::string> used;
+		for (size_t i = 0; i < mClasses.size(); ++i) {
+			ClassInfo &klass = mClasses[i];
+			klass.cppName = sanitize(klass.name);
+			while (namespaces.count(klass.cppNamespace + "::" + klass.cppName) != 0 || !used.insert(klass.cppNamespace + "::" + klass.cppName).second) {
+				klass.cppName += "_";
+			}
+			klass.qualifiedName = klass.cppNamespace + "::" + klass.cppName;
+
+			//The first class wins if the dump lists one twice
+			mByName.emplace(fullName(klass.namespaceName, klass.name), i);
+		}
+
+		for (ClassInfo &klass : mClasses) {
+			auto parent = mByName.find(klass.parent);
+			if (parent != mByName.end() && !mClasses[parent->second].valueType) {
+				klass.parentIndex = (int)parent->second;
+			}
+		}
+	}
+
+	//Reference type classes only, parents before children
+	std::vector<size_t> emitOrder() const {
+		std::vector<size_t> order;
+		std::vector<uint8_t> state(mClasses.size(), 0);
+		for (size_t i = 0; i < mClasses.size(); ++i) {
+			std::vector<size_t> chain;
+			for (int index = (int)i; index >= 0 && state[index] == 0; index = mClasses[index].parentIndex) {
+				state[index] = 1;
+				chain.push_back(index);
+			}
+			for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+				if (!mClasses[*it].valueType) {
+					order.push_back(*it);
+				}
+			}
+		}
+		return order;
+	}
+
+	TypeMapping mapType(const std::string &type, bool valueType) const {
+		static const std::unordered_map<std::string, std::string> primitives = {
+			{ "System.Boolean", "bool" }, { "bool", "bool" },
+			{ "System.Byte", "uint8_t" }, { "byte", "uint8_t" },
+			{ "System.SByte", "int8_t" }, { "sbyte", "int8_t" },
+			{ "System.Int16", "int16_t" }, { "short", "int16_t" },
+			{ "System.UInt16", "uint16_t" }, { "ushort", "uint16_t" },
+			{ "System.Int32", "int32_t" }, { "int", "int32_t" },
+			{ "System.UInt32", "uint32_t" }, { "uint", "uint32_t" },
+			{ "System.Int64", "int64_t" }, { "long", "int64_t" },
+			{ "System.UInt64", "uint64_t" }, { "ulong", "uint64_t" },
+			{ "System.Single", "float" }, { "float", "float" },
+			{ "System.Double", "double" }, { "double", "double" },
+			{ "System.Char", "::internal::Il2CppChar" }, { "char", "::internal::Il2CppChar" },
+			{ "System.IntPtr", "void *" }, { "System.UIntPtr", "void *" },
+			{ "System.Void", "void" }, { "void", "void" }
+		};
+
+		TypeMapping mapping;
+		auto primitive = primitives.find(type);
+		if (primitive != primitives.end()) {
+			mapping.supported = true;
+			mapping.cpp = mapping.abi = primitive->second;
+			return mapping;
+		}
+
+		auto known = mByName.find(type);
+		if (known != mByName.end()) {
+			const ClassInfo &klass = mClasses[known->second];
+			if (!klass.enumType.empty()) {
+				return mapType(klass.enumType, true);
+			}
+			if (klass.valueType) {
+				return mapping;
+			}
+
+			mapping.supported = true;
+			mapping.isWrapper = true;
+			mapping.cpp = "::" + klass.qualifiedName;
+			mapping.abi = "void *";
+			return mapping;
+		}
+
+		//Arrays, strings, generics and classes outside the dump are still plain object pointers
+		bool isArray = type.size() > 2 && type.compare(type.size() - 2, 2, "[]") == 0;
+		if (valueType && !isArray) {
+			return mapping;
+		}
+		mapping.supported = true;
+		mapping.isWrapper = true;
+		mapping.cpp = "::il2cppapi::TypedObject";
+		mapping.abi = "void *";
+		return mapping;
+	}
+
+	struct MemberNames {
+		std::set<std::string> used;
+
+		MemberNames(const std::string &className) {
+			used = { className, "ptr", "bind", "load", "store", "loadObject", "Namespace", "Name" };
+		}
+
+		std::string claim(const std::string &name) {
+			std::string unique = name;
+			while (!used.insert(unique).second) {
+				unique += "_";
+			}
+			return unique;
+		}
+	};
+
+	struct EmittedField {
+		const FieldInfo *field;
+		TypeMapping type;
+		std::string accessor;
+		std::string setter;
+		std::string offsetName;
+	};
+
+	struct EmittedMethod {
+		const MethodInfo *method;
+		TypeMapping returnType;
+		std::vector<TypeMapping> parameterTypes;
+		std::string cppName;
+		std::string slotName;
+	};
+
+	struct ClassMembers {
+		std::vector<EmittedField> fields;
+		std::vector<EmittedMethod> methods;
+		std::vector<std::string> skipped;
+	};
+
+	ClassMembers collectMembers(const ClassInfo &klass) const {
+		ClassMembers members;
+		MemberNames names(klass.cppName);
+
+		for (const FieldInfo &field : klass.fields) {
+			if (field.isStatic) {
+				members.skipped.push_back("field " + field.name + ": static");
+				continue;
+			}
+
+			EmittedField emitted{ &field, mapType(field.type, field.valueType), {}, {}, {} };
+			if (!emitted.type.supported || emitted.type.cpp == "void") {
+				members.skipped.push_back("field " + field.name + ": unsupported type " + field.type);
+				continue;
+			}
+
+			std::string name = sanitize(field.name);
+			emitted.accessor = names.claim(name);
+			emitted.setter = names.claim("set_" + name);
+			emitted.offsetName = names.claim("Offset_" + name);
+			members.fields.push_back(std::move(emitted));
+		}
+
+		//Methods are resolved by name and argument count, so overloads are only usable when those differ
+		std::map<std::string, std::string> methodNames;
+		std::set<std::pair<std::string, size_t>> seen;
+		for (const MethodInfo &method : klass.methods) {
+			if (!seen.insert({ method.name, method.parameters.size() }).second) {
+				members.skipped.push_back("method " + method.name + "/" + std::to_string(method.parameters.size()) + ": ambiguous overload");
+				continue;
+			}
+
+			EmittedMethod emitted{ &method, mapType(method.returnType, method.returnValueType), {}, {}, {} };
+			bool supported = emitted.returnType.supported;
+			for (const ParameterInfo &parameter : method.parameters) {
+				emitted.parameterTypes.push_back(mapType(parameter.type, parameter.valueType));
+				supported &= emitted.parameterTypes.back().supported && emitted.parameterTypes.back().cpp != "void";
+			}
+			if (!supported) {
+				members.skipped.push_back("method " + method.name + ": unsupported signature");
+				continue;
+			}
+
+			auto existing = methodNames.find(method.name);
+			if (existing == methodNames.end()) {
+				existing = methodNames.emplace(method.name, names.claim(sanitize(method.name))).first;
+			}
+			emitted.cppName = existing->second;
+			emitted.slotName = names.claim("Slot_" + emitted.cppName + "_" + std::to_string(method.parameters.size()));
+			members.methods.push_back(std::move(emitted));
+		}
+
+		return members;
+	}
+
+	static std::string escape(const std::string &text) {
+		std::string out;
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				out += '\\';
+			}
+			out += c;
+		}
+		return out;
+	}
+
+	std::string signature(const EmittedMethod &method, bool abi) const {
+		std::string out = (abi ? method.returnType.abi : method.returnType.cpp) + "(";
+		for (size_t i = 0; i < method.parameterTypes.size(); ++i) {
+			out += (i ? ", " : "") + (abi ? method.parameterTypes[i].abi : method.parameterTypes[i].cpp);
+		}
+		return out + ")";
+	}
+
+	std::string parameterList(const EmittedMethod &method) const {
+		std::string out;
+		for (size_t i = 0; i < method.parameterTypes.size(); ++i) {
+			out += (i ? ", " : "") + method.parameterTypes[i].cpp + " " + parameterName(method, i);
+		}
+		return out;
+	}
+
+	static std::string parameterName(const EmittedMethod &method, size_t index) {
+		return "a" + std::to_string(index) + "_" + sanitize(method.method->parameters[index].name);
+	}
+
+	void emitDeclaration(std::ostringstream &out, const ClassInfo &klass) {
+		ClassMembers &members = mMembers[&klass] = collectMembers(klass);
+		std::string base = klass.parentIndex >= 0 ? "::" + mClasses[klass.parentIndex].qualifiedName : "::il2cppapi::TypedObject";
+
+		out << "namespace " << klass.cppNamespace << " {\n";
+		out << "\t//" << fullName(klass.namespaceName, klass.name) << "\n";
+		for (const std::string &skipped : members.skipped) {
+			out << "\t//Skipped " << skipped << "\n";
+		}
+		out << "\tstruct " << klass.cppName << " : " << base << " {\n";
+		out << "\t\tstatic constexpr const char *Namespace = \"" << escape(klass.namespaceName) << "\";\n";
+		out << "\t\tstatic constexpr const char *Name = \"" << escape(klass.name) << "\";\n\n";
+		out << "\t\t" << klass.cppName << "(void *ptr = nullptr) : " << base << "(ptr) {}\n";
+		out << "\t\t" << klass.cppName << "(::internal::Il2CppObject obj) : " << base << "(obj.ptr) {}\n";
+		out << "\t\t" << klass.cppName << "(const ::il2cppapi::Object &obj) : " << base << "(obj.ptr) {}\n";
+
+		if (!members.fields.empty()) {
+			out << "\n";
+		}
+		for (const EmittedField &field : members.fields) {
+			out << "\t\tstatic constexpr size_t " << field.offsetName << " = 0x" << std::hex << field.field->offset << std::dec << ";\n";
+			out << "\t\t" << field.type.cpp << " " << field.accessor << "() const;\n";
+			out << "\t\tvoid " << field.setter << "(" << field.type.cpp << " value) const;\n";
+		}
+
+		if (!members.methods.empty()) {
+			out << "\n";
+		}
+		for (const EmittedMethod &method : members.methods) {
+			const char *slot = method.method->isStatic ? "::il2cppapi::StaticMethodSlot" : "::il2cppapi::MethodSlot";
+			out << "\t\tstatic inline " << slot << "<" << signature(method, true) << "> " << method.slotName << ";\n";
+			out << "\t\t" << (method.method->isStatic ? "static " : "") << method.returnType.cpp << " " << method.cppName
+				<< "(" << parameterList(method) << ")" << (method.method->isStatic ? "" : " const") << ";\n";
+		}
+
+		out << "\n\t\tstatic bool bind(const ::il2cpp_context &ctx);\n";
+		out << "\t};\n";
+		out << "}\n\n";
+	}
+
+	void emitDefinitions(std::ostringstream &out, const ClassInfo &klass) {
+		const ClassMembers &members = mMembers[&klass];
+		const std::string &name = klass.cppName;
+
+		out << "namespace " << klass.cppNamespace << " {\n";
+		for (const EmittedField &field : members.fields) {
+			out << "\tinline " << field.type.cpp << " " << name << "::" << field.accessor << "() const {\n";
+			if (field.type.isWrapper) {
+				out << "\t\treturn loadObject<" << field.type.cpp << ", " << field.offsetName << ">();\n";
+			}
+			else {
+				out << "\t\treturn load<" << field.type.cpp << ", " << field.offsetName << ">();\n";
+			}
+			out << "\t}\n";
+
+			out << "\tinline void " << name << "::" << field.setter << "(" << field.type.cpp << " value) const {\n";
+			if (field.type.isWrapper) {
+				out << "\t\tstore<void *, " << field.offsetName << ">(value.ptr);\n";
+			}
+			else {
+				out << "\t\tstore<" << field.type.cpp << ", " << field.offsetName << ">(value);\n";
+			}
+			out << "\t}\n";
+		}
+
+		for (const EmittedMethod &method : members.methods) {
+			std::string call = method.slotName + ".fn(";
+			if (!method.method->isStatic) {
+				call += "*this";
+			}
+			for (size_t i = 0; i < method.parameterTypes.size(); ++i) {
+				call += (i || !method.method->isStatic) ? ", " : "";
+				call += parameterName(method, i) + (method.parameterTypes[i].isWrapper ? ".ptr" : "");
+			}
+			call += ")";
+
+			out << "\tinline " << method.returnType.cpp << " " << name << "::" << method.cppName << "(" << parameterList(method) << ")"
+				<< (method.method->isStatic ? "" : " const") << " {\n";
+			if (method.returnType.cpp == "void") {
+				out << "\t\t" << call << ";\n";
+			}
+			else if (method.returnType.isWrapper) {
+				out << "\t\treturn " << method.returnType.cpp << "(" << call << ");\n";
+			}
+			else {
+				out << "\t\treturn " << call << ";\n";
+			}
+			out << "\t}\n";
+		}
+
+		out << "\tinline bool " << name << "::bind(const ::il2cpp_context &ctx) {\n";
+		out << "\t\t::il2cppapi::Class *klass = ctx.getClass(Namespace, Name);\n";
+		out << "\t\tif (klass == nullptr) {\n";
+		out << "\t\t\t::printf(\"ERROR: il2cpp_wrapgen: Class %s.%s not found!\\n\", Namespace, Name);\n";
+		out << "\t\t\treturn false;\n";
+		out << "\t\t}\n\n";
+		out << "\t\tbool ok = true;\n";
+		for (const EmittedField &field : members.fields) {
+			out << "\t\tok &= ::il2cppapi::verifyFieldOffset(*klass, Name, \"" << escape(field.field->name) << "\", " << field.offsetName << ");\n";
+		}
+		for (const EmittedMethod &method : members.methods) {
+			out << "\t\tok &= " << method.slotName << ".bind(*klass, \"" << escape(method.method->name) << "\");\n";
+		}
+		out << "\t\treturn ok;\n";
+		out << "\t}\n";
+		out << "}\n\n";
+	}
+
+	std::string mRootNamespace;
+	std::string mInclude;
+	std::vector<ClassInfo> mClasses;
+	std::unordered_map<std::string, size_t> mByName;
+	std::unordered_map<const ClassInfo *, ClassMembers> mMembers;
+};
+
+#ifndef IL2CPP_WRAPGEN_NO_MAIN
+static void printUsage() {
+	fprintf(stderr, "Usage: il2cpp_wrapgen <dump.json> <output.h> [--namespace il2cpp_gen] [--include il2cpp_wrappers.h]\n");
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		printUsage();
+		return 1;
+	}
+
+	std::string rootNamespace = "il2cpp_gen";
+	std::string include = "il2cpp_wrappers.h";
+	for (int i = 3; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "--namespace") == 0) {
+			rootNamespace = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "--include") == 0) {
+			include = argv[i + 1];
+		}
+		else {
+			printUsage();
+			return 1;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::ifstream input(argv[1], std::ios::binary);
+	if (!input) {
+		fprintf(stderr, "ERROR: Could not open %s\n", argv[1]);
+		return 1;
+	}
+	std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	JsonValue dump;
+	JsonParser parser(text.data(), text.data() + text.size());
+	if (!parser.parse(dump)) {
+		fprintf(stderr, "ERROR: %s: %s\n", argv[1], parser.error().c_str());
+		return 1;
+	}
+
+	WrapperGenerator generator(rootNamespace, include);
+	if (!generator.load(dump)) {
+		return 1;
+	}
+	std::string header = generator.generate(argv[1]);
+
+	std::ofstream output(argv[2], std::ios::binary);
+	output << header;
+	if (!output) {
+		fprintf(stderr, "ERROR: Could not write %s\n", argv[2]);
+		return 1;
+	}
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	printf("Wrapped %zu classes into %s (%zu bytes) in %lld ms\n", generator.wrappedClasses(), argv[2], header.size(), (long long)elapsed.count());
+	return 0;
+}
+#endif
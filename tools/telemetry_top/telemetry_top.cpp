@@ -0,0 +1,91 @@
+//top-like viewer for the hook telemetry segment published by il2cpp_telemetry.h
+//
+//	g++ -std=c++17 -O2 -o telemetry_top telemetry_top.cpp -lrt
+//	AUDICA_TELEMETRY_FILE=/dev/shm/audica_telemetry ./telemetry_top [refresh ms]
+//
+//Rows are sorted by calls per second over the last refresh interval.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../il2cpp/il2cpp_telemetry.h"
+
+struct Row {
+	TelemetrySlot::Snapshot snapshot;
+	double callsPerSecond;
+};
+
+static const char *kindName(TelemetrySlotKind kind) {
+	switch (kind) {
+	case TelemetrySlotKind::Hook: return "hook";
+	case TelemetrySlotKind::Mod: return "mod";
+	default: return "?";
+	}
+}
+
+int main(int argc, char **argv) {
+	int refreshMs = argc > 1 ? atoi(argv[1]) : 1000;
+	if (refreshMs <= 0) {
+		refreshMs = 1000;
+	}
+
+	TelemetryHeader *header = nullptr;
+	while ((header = TelemetrySegment::map(false)) == nullptr || header->magic != TelemetryMagic) {
+		printf("Waiting for the telemetry segment...\n");
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+
+	if (header->version != TelemetryVersion || header->slotSize != sizeof(TelemetrySlot)) {
+		printf("ERROR: Telemetry segment is version %u (slot size %u), this reader understands version %u (slot size %zu)\n",
+			header->version, header->slotSize, TelemetryVersion, sizeof(TelemetrySlot));
+		return 1;
+	}
+
+	TelemetrySlot *slots = TelemetrySegment::slots(header);
+	std::unordered_map<uint32_t, uint64_t> previousCalls;
+	uint64_t createdUnixNs = header->createdUnixNs;
+
+	for (;;) {
+		//The game restarted and a new process reinitialized the segment, so the old slots are gone
+		if (header->createdUnixNs != createdUnixNs) {
+			createdUnixNs = header->createdUnixNs;
+			previousCalls.clear();
+		}
+
+		uint32_t used = std::min(header->usedSlots.load(std::memory_order_acquire), header->slotCount);
+
+		std::vector<Row> rows;
+		rows.reserve(used);
+		for (uint32_t i = 0; i < used; ++i) {
+			Row row;
+			row.snapshot = slots[i].read();
+
+			uint64_t previous = previousCalls.count(i) ? previousCalls[i] : row.snapshot.calls;
+			row.callsPerSecond = (double)(row.snapshot.calls - previous) * 1000.0 / refreshMs;
+			previousCalls[i] = row.snapshot.calls;
+			rows.push_back(row);
+		}
+
+		std::sort(rows.begin(), rows.end(), [](const Row &lhs, const Row &rhs) {
+			return lhs.callsPerSecond > rhs.callsPerSecond;
+		});
+
+		printf("\x1b[2J\x1b[H");
+		printf("Audica mod telemetry - process %u, %u slots, refresh %d ms\n\n", header->ownerProcessId.load(std::memory_order_relaxed), used, refreshMs);
+		printf("%-5s %-40s %12s %14s %10s %10s %8s\n", "KIND", "NAME", "CALLS/S", "CALLS", "AVG us", "MAX us", "ERRORS");
+		for (const Row &row : rows) {
+			const auto &s = row.snapshot;
+			double avgUs = s.calls ? (double)s.totalNs / s.calls / 1000.0 : 0.0;
+			printf("%-5s %-40.40s %12.1f %14llu %10.2f %10.2f %8llu\n",
+				kindName(s.kind), s.name, row.callsPerSecond, (unsigned long long)s.calls,
+				avgUs, s.maxNs / 1000.0, (unsigned long long)s.errors);
+		}
+		fflush(stdout);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(refreshMs));
+	}
+}